@@ -2,6 +2,9 @@
 
 
 
+#ifndef CONFIG_H
+#define CONFIG_H
+
 #define F_CPU        16000000    // Set clock frequency in Hertz
 // use date -u +%Y%m%d%H%M%S utc
 #define BUILD_DATE 20230611
@@ -19,6 +22,9 @@
 // Serial
 #define SERIAL_RX_BUFFER_SIZE     64
 #define SERIAL_TX_BUFFER_SIZE     64
+// Worst baud rate error accepted, tenths of a percent.  The datasheet
+// recommends 2% for 8 bit words; 115200 at 16 MHz is 2.1% with U2X.
+#define SERIAL_BAUD_TOLERANCE     25
 
 
 // SoftSPI
@@ -39,19 +45,45 @@
 // Define the interfaces
 // see softspi_t struct in softspi.c
 
-// bps  ss_pin  delay_ticks  mode  bits
+// bps  ss_pin  mode  bits  backend
 // bps:  Maximum bit rate of spi interface. 0 for fast as possible
 // ss_pin:  GPIO pin for slave select, GPIO_PIN_NONE if not used
 //   
 // bits:  How many bits to transfer per cycle
 
-// bps       ss_pin            mode                bits
-// u32       gpio pin          mode_t              u8
+// One SOFTSPI_INTERFACE() per interface.  The _SLOW mode delay for the
+// bps is worked out at compile time.  Use SOFTSPI_check_rates() to
+// find rows that run faster than their bps, such as a non-_SLOW mode
+// asked for less than SOFTSPI_MAX_BPS.
+// backend:  SOFTSPI_BACKEND_AUTO moves interfaces on the hardware SPI
+//   pins with whole-byte words to the SPI peripheral.  _SOFT forces
+//   bit-banging.  _USART runs the interface on the USART in master SPI
+//   mode (XCK/TXD/RXD, ATmega48/88/168/328 only) as a second bus.
+//
+//                      bps   ss_pin       mode                  bits  backend
+//                      u32   gpio pin     mode_t                u8    backend_t
 
 #define SOFTSPI_INTERFACES   \
-   0,        GPIO_PIN_C5, 0,  SPI_MODE_2_MSB_FIRST,   16,  \
-   0,     GPIO_PIN_C4, 0, SPI_MODE_2_MSB_FIRST, 8
+  SOFTSPI_INTERFACE(    0,    GPIO_PIN_C5, SPI_MODE_2_MSB_FIRST, 16,   SOFTSPI_BACKEND_AUTO),  \
+  SOFTSPI_INTERFACE(    0,    GPIO_PIN_C4, SPI_MODE_2_MSB_FIRST,  8,   SOFTSPI_BACKEND_AUTO)
+
+
+// Bit-bang kernels to build, one per mode.  Each costs flash, so list
+// only the modes used above.  All sixteen are listed in
+// libavr_config_template.h.
+#define SOFTSPI_ENABLE_MODE_2_MSB_FIRST    1
 
+// Multi-lane writes:  up to 8 more MOSI pins, all on one port, that
+// share SOFTSPI_CLK and each feed their own chain.  SOFTSPI_lanes_write
+// sends to all of them with one port write per clock.
+//#define SOFTSPI_LANE_PINS   GPIO_PIN_C0, GPIO_PIN_C1, GPIO_PIN_C2, GPIO_PIN_C3
+
+// Daisy chains:  SOFTSPI_CHAIN(interface, devices, bytes per device).
+// The whole chain is shifted in one SS window and latches when SS goes
+// high.  A RAM shadow of every device lets SOFTSPI_chain_write skip
+// the transfer when nothing changed.  One chain per interface; the
+// interface's bits setting is not used.
+//#define SOFTSPI_CHAINS   SOFTSPI_CHAIN(1, 4, 1)
 
 //{ 100000,   GPIO_PIN_C4,   SPI_MODE_2_MSB_FIRST,    8 }
 
@@ -60,7 +92,22 @@
 
 
 // SPI
+// The hardware SPI needs no setup here:  softspi picks it for any
+// interface whose pins and bit rate it can serve.  See spi.h.
+
+// SPI queue
+// Ring of queued transactions, holds SIZE - 1.  Must be a power of two.
+#define SPI_QUEUE_SIZE            8
+// Bytes the systick pump clocks per tick on bit-banged interfaces
+#define SPI_QUEUE_SOFT_BYTES      4
+
+// TWI
+// Hardware TWI is used where the part has it (SDA PC4, SCL PC5 on the
+// ATmega8).  Define both of these to bit-bang the bus instead.
+//#define TWI_SOFT_SDA        GPIO_PIN_C4
+//#define TWI_SOFT_SCL        GPIO_PIN_C5
 
 // Systick
 #define SYSTICK_COUNT    4
 
+#endif
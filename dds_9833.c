@@ -30,10 +30,8 @@ extern "C"
 //////////////////////////////////////////////////////////////////////////////
 void DDS_9833_init(void)
 {
-  SOFTSPI_init(GPIO_PIN_B5, GPIO_PIN_B3, -1);
-  // ss on pb2
-  SOFTSPI_set_interface(0, GPIO_PIN_C5, 16, SPI_MODE_2_MSB_FIRST, 0);
-  DDRB |= 0x08;  // b3 output
+  // Bus pins and the interface come from config.h
+  SOFTSPI_init2();
         
   DDS_write_word(0x2100);  // Set B28 and RESET bits in control reg.
   DDS_write_frequency(0L);  // Set output to 0 hz at startup
@@ -49,7 +47,7 @@ void DDS_9833_init(void)
 //////////////////////////////////////////////////////////////////////////////
 static void write_word(uint16_t wd)
 {
-  SOFTSPI_write(0,wd);
+  SOFTSPI_write(DDS_9833_SPI, wd);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -19,7 +19,9 @@
 
 
 // dds_9833
-
+// Which SOFTSPI_INTERFACES entry in config.h the AD9833 is on.  It wants
+// 16 bit words in SPI_MODE_2_MSB_FIRST.
+#define DDS_9833_SPI      0
 
 
 //////////////////////////////////////////////////////////////////////////
@@ -60,11 +62,51 @@
 
 #define LCD_44780_RS            GPIO_PIN_B1
 #define LCD_44780_EN            GPIO_PIN_B0
+// Several displays on the same RS, RW and data lines:  list each one's
+// EN pin, and LCD_44780_EN is not used.  LCD_44780_select picks the
+// one the other calls work on.  All have the size below.  Keep the
+// enables off B2 (SPI SS, which SPI_init makes an output) and B3 to B5
+// (the SPI pins in config.h).  Every other pin is already taken by the
+// examples here and in config.h, so the extra enables are left to fill.
+//#define LCD_44780_PANELS        GPIO_PIN_B0, GPIO_PIN_xx, GPIO_PIN_xx
+// RW is optional.  With it the driver polls the busy flag, without it
+// (tied low) it waits the datasheet time for each command.  Against the
+// host model, which takes the whole datasheet time, a 16x2 screen goes
+// at 17700 chars/s polling and 20800 waiting:  polling only wins on a
+// controller that finishes early, as most do on clear and home.
+//#define LCD_44780_RW            GPIO_PIN_xx
+// Define to queue commands and data and send them from a systick timer
+// instead of waiting on each one.  Power of two, up to 128 entries.
+// SYSTICK_init must run before LCD_44780_init2, and interrupts must be
+// on for the queue to drain.  Other pins on the LCD's ports must only
+// be changed with interrupts off.
+//#define LCD_44780_QUEUE_SIZE    64
+// PCF8574 I2C backpack:  define its 7 bit address to drive the LCD
+// through it over TWI (see config.h) instead of the pins above.  Each
+// byte goes out as one I2C write.  4 bit, write only, and not with
+// LCD_44780_QUEUE_SIZE:  a queued byte's write would block the systick
+// interrupt for about 540 uS at 100 kHz.
+//#define LCD_44780_PCF8574       0x27
+//#define LCD_44780_PCF8574_BPS   400000
 #define LCD_44780_D7            GPIO_PIN_D7
 #define LCD_44780_D6            GPIO_PIN_D6
 #define LCD_44780_D5            GPIO_PIN_D5
 #define LCD_44780_D4            GPIO_PIN_D4
+// Define D3..D0 too for the 8 bit interface.  It halves the strobes,
+// but every byte still waits out the controller's 37 uS, so a whole
+// 16x2 or 20x4 screen is only about 5% quicker:  make host-test prints
+// the times for both.
+//#define LCD_44780_D3            GPIO_PIN_xx
+//#define LCD_44780_D2            GPIO_PIN_xx
+//#define LCD_44780_D1            GPIO_PIN_xx
+//#define LCD_44780_D0            GPIO_PIN_xx
+// 8x1, 16x1, 16x2, 16x4, 20x2, 20x4 or 40x4.  A 40x4 is two
+// controllers:  LCD_44780_EN drives the top two rows, LCD_44780_EN2 the
+// bottom two.  16x1 panels wired as two 8 character lines set
+// LCD_44780_SPLIT to 8.
 #define LCD_44780_COLUMNS       16
 #define LCD_44780_ROWS          2
+//#define LCD_44780_EN2           GPIO_PIN_xx
+//#define LCD_44780_SPLIT         8
 
 #endif 
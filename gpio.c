@@ -13,10 +13,14 @@ void GPIO_init( int modeb, int pinb, int modec, int pinc, int moded, int pind)
 {
   DDRB = modeb;
   PORTB = pinb;
+#ifdef PORTC
   DDRC = modec;
   PORTC = pinc;
+#endif
+#ifdef PORTD
   DDRD = moded;
   PORTD = pind;
+#endif
 }
 
 void GPIO_pin_mode(int pin, int mode)
@@ -29,17 +33,27 @@ void GPIO_pin_mode(int pin, int mode)
     {
       switch(port)
 	{
+#ifdef PORTA
+	case GPIO_PORT_A:
+	  DDRA |= mask;
+	  break;
+#endif
+	  
 	case GPIO_PORT_B:
 	  DDRB |= mask;
 	  break;
 	  
+#ifdef PORTC
 	case GPIO_PORT_C:
 	  DDRC |= mask;
 	  break;
+#endif
 	  
+#ifdef PORTD
 	case GPIO_PORT_D:
 	  DDRD |= mask;
 	  break;
+#endif
 
 	default:
 	  break;
@@ -50,17 +64,27 @@ void GPIO_pin_mode(int pin, int mode)
       uint8_t dirmask = ~mask;   // invert the bits to set read mode
       switch(port)
 	{
+#ifdef PORTA
+	case GPIO_PORT_A:
+	  DDRA &= dirmask;
+	  break;
+#endif
+
 	case GPIO_PORT_B:
 	  DDRB &= dirmask;
 	  break;
 
+#ifdef PORTC
 	case GPIO_PORT_C:
 	  DDRC &= dirmask;
 	  break;
+#endif
 
+#ifdef PORTD
 	case GPIO_PORT_D:
 	  DDRD &= dirmask;
 	  break;
+#endif
 
 	default:
 	  break;
@@ -71,20 +95,31 @@ void GPIO_pin_mode(int pin, int mode)
       uint8_t dirmask = ~mask;   // invert bits to set read mode
       switch(port)
 	{
+#ifdef PORTA
+	case GPIO_PORT_A:
+	  DDRA &= dirmask;
+	  PORTA |= mask;
+	  break;
+#endif
+
 	case GPIO_PORT_B:
 	  DDRB &= dirmask;
 	  PORTB |= mask;
 	  break;
 
+#ifdef PORTC
 	case GPIO_PORT_C:
 	  DDRC &= dirmask;
 	  PORTC |= mask;
 	  break;
+#endif
 
+#ifdef PORTD
 	case GPIO_PORT_D:
 	  DDRD &= dirmask;
 	  PORTD |= mask;
 	  break;
+#endif
 
 	default:
 	  break;
@@ -105,17 +140,27 @@ void GPIO_write_pin(int pin, int val)
       mask = ~mask;
       switch(port)
 	{
+#ifdef PORTA
+	case GPIO_PORT_A:
+	  PORTA &= mask;
+	  break;
+#endif
+
 	case GPIO_PORT_B:
 	  PORTB &= mask;
 	  break;
 
+#ifdef PORTC
 	case GPIO_PORT_C:
 	  PORTC &= mask;
 	  break;
+#endif
 
+#ifdef PORTD
 	case GPIO_PORT_D:
 	  PORTD &= mask;
 	  break;
+#endif
 
 	default:
 	  break;
@@ -125,17 +170,27 @@ void GPIO_write_pin(int pin, int val)
     {
       switch(port)
 	{
+#ifdef PORTA
+	case GPIO_PORT_A:
+	  PORTA |= mask;
+	  break;
+#endif
+
 	case GPIO_PORT_B:
 	  PORTB |= mask;
 	  break;
 
+#ifdef PORTC
 	case GPIO_PORT_C:
 	  PORTC |= mask;
 	  break;
+#endif
 
+#ifdef PORTD
 	case GPIO_PORT_D:
 	  PORTD |= mask;
 	  break;
+#endif
 
 	default:
 	  break;
@@ -151,17 +206,27 @@ void GPIO_toggle_pin(int pin)
   mask = ~mask;
   switch(port)
   {
+#ifdef PORTA
+    case GPIO_PORT_A:
+      PORTA &= mask;
+      break;
+#endif
+
     case GPIO_PORT_B:
       PORTB &= mask;
       break;
 
+#ifdef PORTC
     case GPIO_PORT_C:
       PORTC &= mask;
       break;
+#endif
 
+#ifdef PORTD
     case GPIO_PORT_D:
       PORTD &= mask;
       break;
+#endif
 
     default:
       break;
@@ -176,17 +241,27 @@ int GPIO_read_pin(int pin)
 
   switch(port)
     {
+#ifdef PORTA
+    case GPIO_PORT_A:
+      rtn = PINA;
+      break;
+#endif
+
     case GPIO_PORT_B:
       rtn = PINB;
       break;
 
+#ifdef PORTC
     case GPIO_PORT_C:
       rtn = PINC;
       break;
+#endif
 
+#ifdef PORTD
     case GPIO_PORT_D:
       rtn = PIND;
       break;
+#endif
 
     default:
       break;
@@ -204,17 +279,27 @@ int GPIO_read_output_pin(int pin)
 
   switch(port)
     {
+#ifdef PORTA
+    case GPIO_PORT_A:
+      rtn = PORTA;
+      break;
+#endif
+
     case GPIO_PORT_B:
       rtn = PORTB;
       break;
 
+#ifdef PORTC
     case GPIO_PORT_C:
       rtn = PORTC;
       break;
+#endif
 
+#ifdef PORTD
     case GPIO_PORT_D:
       rtn = PORTD;
       break;
+#endif
 
     default:
       break;
@@ -227,3 +312,75 @@ int GPIO_read_output_pin(int pin)
   
 
   
+
+volatile uint8_t *GPIO_output_register(int pin)
+{
+  volatile uint8_t *rtn = 0;
+  uint8_t port = (uint8_t)(pin >> 3);
+
+  switch(port)
+    {
+#ifdef PORTA
+    case GPIO_PORT_A:
+      rtn = &PORTA;
+      break;
+#endif
+
+    case GPIO_PORT_B:
+      rtn = &PORTB;
+      break;
+
+#ifdef PORTC
+    case GPIO_PORT_C:
+      rtn = &PORTC;
+      break;
+#endif
+
+#ifdef PORTD
+    case GPIO_PORT_D:
+      rtn = &PORTD;
+      break;
+#endif
+
+    default:
+      break;
+    }
+
+  return rtn;
+}
+
+volatile uint8_t *GPIO_input_register(int pin)
+{
+  volatile uint8_t *rtn = 0;
+  uint8_t port = (uint8_t)(pin >> 3);
+
+  switch(port)
+    {
+#ifdef PORTA
+    case GPIO_PORT_A:
+      rtn = &PINA;
+      break;
+#endif
+
+    case GPIO_PORT_B:
+      rtn = &PINB;
+      break;
+
+#ifdef PORTC
+    case GPIO_PORT_C:
+      rtn = &PINC;
+      break;
+#endif
+
+#ifdef PORTD
+    case GPIO_PORT_D:
+      rtn = &PIND;
+      break;
+#endif
+
+    default:
+      break;
+    }
+
+  return rtn;
+}
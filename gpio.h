@@ -15,6 +15,15 @@
 
 typedef enum GPIO_Pin
   {
+    GPIO_PIN_A0         = 0,    // Port A is on the ATtiny24/44/84
+    GPIO_PIN_A1         = 1,
+    GPIO_PIN_A2         = 2,
+    GPIO_PIN_A3         = 3,
+    GPIO_PIN_A4         = 4,
+    GPIO_PIN_A5         = 5,
+    GPIO_PIN_A6         = 6,
+    GPIO_PIN_A7         = 7,
+
     GPIO_PIN_B0         = 8,
     GPIO_PIN_B1         = 9,
     GPIO_PIN_B2         = 10,
@@ -47,10 +56,11 @@ typedef enum GPIO_Pin
 //////////////////////////////////////////////////////////////////////////////
 /// @enum GPIO_Port_t
 /// @brief Defines names for gpio ports
-/// @remark Currently defined for ATMega8, revisit for others
+/// @remark Ports the part doesn't have are ignored by the functions.
 /////////////////////////////////////////////////////////////////////////////
 typedef enum GPIO_Port
   {
+    GPIO_PORT_A         = 0,
     GPIO_PORT_B         = 1,
     GPIO_PORT_C         = 2,
     GPIO_PORT_D         = 3
@@ -68,6 +78,35 @@ typedef enum GPIO_Mode
     GPIO_PIN_MODE_INPUT_PULLUP = 2
   } GPIO_Mode_t;
 
+
+// Bit mask of a pin within its port
+#define GPIO_PIN_MASK(pin)   ((uint8_t)(1 << ((pin) & 0x07)))
+
+// PORTx of a pin as a constant expression, for tables built at compile
+// time.  NULL for GPIO_PIN_NONE or a port the part doesn't have.
+#ifdef PORTA
+#define GPIO_PORTA_REG   (&PORTA)
+#else
+#define GPIO_PORTA_REG   ((volatile uint8_t *)0)
+#endif
+#ifdef PORTC
+#define GPIO_PORTC_REG   (&PORTC)
+#else
+#define GPIO_PORTC_REG   ((volatile uint8_t *)0)
+#endif
+#ifdef PORTD
+#define GPIO_PORTD_REG   (&PORTD)
+#else
+#define GPIO_PORTD_REG   ((volatile uint8_t *)0)
+#endif
+#define GPIO_OUTPUT_REGISTER(pin)                                        \
+  ((volatile uint8_t *)                                                  \
+   (((pin) >> 3) == GPIO_PORT_A ? GPIO_PORTA_REG :                       \
+    ((pin) >> 3) == GPIO_PORT_B ? &PORTB :                               \
+    ((pin) >> 3) == GPIO_PORT_C ? GPIO_PORTC_REG :                       \
+    ((pin) >> 3) == GPIO_PORT_D ? GPIO_PORTD_REG :                       \
+    (volatile uint8_t *)0))
+
     
 void GPIO_init( int modeb, int pinb, int modec, int pinc, int moded, int pind);
 void GPIO_pin_mode(int pin, int mode);
@@ -76,4 +115,20 @@ void GPIO_toggle_pin(int pin);
 int GPIO_read_pin(int pin);
 int GPIO_read_output_pin(int pin);
 
+//////////////////////////////////////////////////////////////////////////////
+/// @fn GPIO_output_register
+/// @brief Finds the PORTx register of a pin for direct port access.
+/// @param[in] pin  GPIO pin name
+/// @return Pointer to PORTx, NULL if pin is GPIO_PIN_NONE or unknown.
+//////////////////////////////////////////////////////////////////////////////
+volatile uint8_t *GPIO_output_register(int pin);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn GPIO_input_register
+/// @brief Finds the PINx register of a pin for direct port access.
+/// @param[in] pin  GPIO pin name
+/// @return Pointer to PINx, NULL if pin is GPIO_PIN_NONE or unknown.
+//////////////////////////////////////////////////////////////////////////////
+volatile uint8_t *GPIO_input_register(int pin);
+
 #endif
@@ -0,0 +1,16 @@
+//////////////////////////////////////////////////////////////////////////////
+///  @file host/avr/interrupt.h
+///  @brief Host build:  an ISR is a plain function named after its vector,
+///         which the test program calls when the interrupt would fire.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector, ...)   void vector(void); void vector(void)
+#define sei()              (SREG |= 0x80)
+#define cli()              (SREG &= (uint8_t)~0x80)
+
+#endif  // HOST_AVR_INTERRUPT_H
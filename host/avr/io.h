@@ -0,0 +1,185 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file host/avr/io.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief ATmega8 registers for building the drivers on the PC.
+///
+///  Only for the host tests, see host_avr.h.  The registers are an array
+///  in RAM at their data space addresses, so &PORTB is still a constant
+///  and the flash tables build.  Nothing happens behind the driver's back:
+///  flags only change when the test program changes them.
+///
+///  With HOST_IO_HOOK defined every access goes through host_io() instead,
+///  which charges a cycle and lets the test watch the pins change.  &PORTB
+///  is then not a constant, so files with register tables (softspi.c)
+///  can't build that way.  Without it PINx reads back PORTx, so an output
+///  pin looped to an input reads what was driven.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+
+#define __AVR_ATmega8__ 1
+
+extern volatile uint8_t host_regs[0x60];
+volatile uint8_t *host_io(uint8_t addr);
+
+#define __SFR_OFFSET    0x20
+#ifdef HOST_IO_HOOK
+#define _SFR_MEM8(a)    (*host_io(a))
+#define _SFR_MEM16(a)   (*(volatile uint16_t *)host_io(a))
+#else
+#define _SFR_MEM8(a)    (host_regs[a])
+#define _SFR_MEM16(a)   (*(volatile uint16_t *)&host_regs[a])
+#endif
+#define _SFR_IO8(a)     _SFR_MEM8((a) + __SFR_OFFSET)
+#define _SFR_IO16(a)    _SFR_MEM16((a) + __SFR_OFFSET)
+#define _BV(b)          (1 << (b))
+
+#define SREG    _SFR_IO8(0x3F)
+#define SPH     _SFR_IO8(0x3E)
+#define SPL     _SFR_IO8(0x3D)
+#define GICR    _SFR_IO8(0x3B)
+#define GIFR    _SFR_IO8(0x3A)
+#define TIMSK   _SFR_IO8(0x39)
+#define TIFR    _SFR_IO8(0x38)
+#define TWCR    _SFR_IO8(0x36)
+#define MCUCR   _SFR_IO8(0x35)
+#define MCUCSR  _SFR_IO8(0x34)
+#define TCCR0   _SFR_IO8(0x33)
+#define TCNT0   _SFR_IO8(0x32)
+#define SFIOR   _SFR_IO8(0x30)
+#define TCCR1A  _SFR_IO8(0x2F)
+#define TCCR1B  _SFR_IO8(0x2E)
+#define TCNT1   _SFR_IO16(0x2C)
+#define OCR1A   _SFR_IO16(0x2A)
+#define OCR1B   _SFR_IO16(0x28)
+#define ICR1    _SFR_IO16(0x26)
+#define TCCR2   _SFR_IO8(0x25)
+#define TCNT2   _SFR_IO8(0x24)
+#define OCR2    _SFR_IO8(0x23)
+#define ASSR    _SFR_IO8(0x22)
+#define UBRRH   _SFR_IO8(0x20)
+#define UCSRC   _SFR_IO8(0x20)
+#define PORTB   _SFR_IO8(0x18)
+#define DDRB    _SFR_IO8(0x17)
+#define PORTC   _SFR_IO8(0x15)
+#define DDRC    _SFR_IO8(0x14)
+#define PORTD   _SFR_IO8(0x12)
+#define DDRD    _SFR_IO8(0x11)
+#ifdef HOST_IO_HOOK
+#define PINB    _SFR_IO8(0x16)
+#define PINC    _SFR_IO8(0x13)
+#define PIND    _SFR_IO8(0x10)
+#else
+#define PINB    PORTB
+#define PINC    PORTC
+#define PIND    PORTD
+#endif
+#define SPDR    _SFR_IO8(0x0F)
+#define SPSR    _SFR_IO8(0x0E)
+#define SPCR    _SFR_IO8(0x0D)
+#define UDR     _SFR_IO8(0x0C)
+#define UCSRA   _SFR_IO8(0x0B)
+#define UCSRB   _SFR_IO8(0x0A)
+#define UBRRL   _SFR_IO8(0x09)
+#define ADMUX   _SFR_IO8(0x07)
+#define ADCSRA  _SFR_IO8(0x06)
+#define ADCW    _SFR_IO16(0x04)
+#define TWDR    _SFR_IO8(0x03)
+#define TWAR    _SFR_IO8(0x02)
+#define TWSR    _SFR_IO8(0x01)
+#define TWBR    _SFR_IO8(0x00)
+
+// TIMSK, TIFR
+#define OCIE2   7
+#define TOIE2   6
+#define TICIE1  5
+#define OCIE1A  4
+#define OCIE1B  3
+#define TOIE1   2
+#define TOIE0   0
+#define OCF2    7
+#define TOV2    6
+#define ICF1    5
+#define OCF1A   4
+#define OCF1B   3
+#define TOV1    2
+#define TOV0    0
+
+// Timers
+#define CS00    0
+#define CS01    1
+#define CS02    2
+#define WGM10   0
+#define WGM11   1
+#define WGM12   3
+#define WGM13   4
+#define CS10    0
+#define CS11    1
+#define CS12    2
+#define FOC2    7
+#define WGM20   6
+#define COM21   5
+#define COM20   4
+#define WGM21   3
+#define CS22    2
+#define CS21    1
+#define CS20    0
+
+// SPI
+#define SPIE    7
+#define SPE     6
+#define DORD    5
+#define MSTR    4
+#define CPOL    3
+#define CPHA    2
+#define SPR1    1
+#define SPR0    0
+#define SPIF    7
+#define WCOL    6
+#define SPI2X   0
+
+// USART
+#define RXC     7
+#define TXC     6
+#define UDRE    5
+#define FE      4
+#define DOR     3
+#define PE      2
+#define U2X     1
+#define MPCM    0
+#define RXCIE   7
+#define TXCIE   6
+#define UDRIE   5
+#define RXEN    4
+#define TXEN    3
+#define UCSZ2   2
+#define RXB8    1
+#define TXB8    0
+#define URSEL   7
+#define UMSEL   6
+#define UPM1    5
+#define UPM0    4
+#define USBS    3
+#define UCSZ1   2
+#define UCSZ0   1
+#define UCPOL   0
+
+// TWI
+#define TWINT   7
+#define TWEA    6
+#define TWSTA   5
+#define TWSTO   4
+#define TWWC    3
+#define TWEN    2
+#define TWIE    0
+#define TWPS1   1
+#define TWPS0   0
+
+#endif  // HOST_AVR_IO_H
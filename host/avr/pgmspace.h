@@ -0,0 +1,22 @@
+//////////////////////////////////////////////////////////////////////////////
+///  @file host/avr/pgmspace.h
+///  @brief Host build:  flash is ordinary memory.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_AVR_PGMSPACE_H
+#define HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s)              (s)
+#define PGM_P                const char *
+#define pgm_read_byte(a)     (*(const uint8_t *)(a))
+#define pgm_read_word(a)     (*(const uint16_t *)(a))
+#define pgm_read_dword(a)    (*(const uint32_t *)(a))
+#define pgm_read_ptr(a)      (*(void * const *)(a))
+#define memcpy_P             memcpy
+#define strlen_P             strlen
+
+#endif  // HOST_AVR_PGMSPACE_H
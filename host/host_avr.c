@@ -0,0 +1,43 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file host_avr.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Registers and clock behind the host build of the drivers.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include "config.h"
+#include "host_avr.h"
+
+volatile uint8_t host_regs[0x60];
+uint64_t host_cycles;
+void (*host_hook)(void);
+
+void host_reset(void)
+{
+  memset((void *)host_regs, 0, sizeof(host_regs));
+  host_cycles = 0;
+}
+
+volatile uint8_t *host_io(uint8_t addr)
+{
+  if(host_hook)
+    host_hook();
+  host_cycles++;
+  return &host_regs[addr];
+}
+
+void host_delay_cycles(uint32_t cycles)
+{
+  if(host_hook)
+    host_hook();
+  host_cycles += cycles;
+}
+
+uint64_t host_ns(void)
+{
+  return host_cycles * 1000000000ULL / F_CPU;
+}
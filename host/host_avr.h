@@ -0,0 +1,63 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file host_avr.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Runs the drivers on the PC for the host tests.
+///
+///  The test programs build the driver sources with the host compiler and
+///  -Ihost, so <avr/io.h> and friends come from here (an ATmega8).
+///  Registers live in host_regs.  Time is counted in CPU cycles:  the
+///  delay calls add what they would take on the part and, in HOST_IO_HOOK
+///  builds, every register access adds one.  host_hook runs before each
+///  of those with the clock at the moment of the access, so a test can
+///  feed the pins to a device model.  ISRs are functions the test calls.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_AVR_H
+#define HOST_AVR_H
+
+#include <stdint.h>
+#include <avr/io.h>
+
+// Registers of a pin's port by its GPIO_PIN_ name, for tests to read
+// and drive without going through host_io
+#define HOST_PORT(pin)   host_regs[0x3b - 3 * ((pin) >> 3)]
+#define HOST_DDR(pin)    host_regs[0x3a - 3 * ((pin) >> 3)]
+#define HOST_PIN(pin)    host_regs[0x39 - 3 * ((pin) >> 3)]
+#define HOST_LEVEL(reg, pin)   (((reg) >> ((pin) & 0x07)) & 1)
+#define HOST_SREG        host_regs[0x5f]
+
+extern volatile uint8_t host_regs[0x60];
+extern uint64_t host_cycles;
+extern void (*host_hook)(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn host_reset
+/// @brief Clears the registers and the clock.  The hook is left alone.
+//////////////////////////////////////////////////////////////////////////////
+void host_reset(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn host_io
+/// @brief Where HOST_IO_HOOK builds send every register access.
+/// @param[in] addr  Data space address
+/// @return The register.
+//////////////////////////////////////////////////////////////////////////////
+volatile uint8_t *host_io(uint8_t addr);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn host_delay_cycles
+/// @brief Lets time pass, as the util/delay calls do.
+//////////////////////////////////////////////////////////////////////////////
+void host_delay_cycles(uint32_t cycles);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn host_ns
+/// @brief The clock in nS since host_reset, at F_CPU.
+//////////////////////////////////////////////////////////////////////////////
+uint64_t host_ns(void);
+
+#endif  // HOST_AVR_H
@@ -0,0 +1,26 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file lcd_44780_20x4_config.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief device_config.h with a 20x4 panel, for the 20x4 builds of
+///         lcd_44780_test.
+///
+///  Force-included ahead of everything else, on its own or with
+///  lcd_44780_8bit_config.h.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCD_44780_20X4_CONFIG_H
+#define LCD_44780_20X4_CONFIG_H
+
+#include "config.h"
+#include "device_config.h"
+
+#undef LCD_44780_COLUMNS
+#undef LCD_44780_ROWS
+#define LCD_44780_COLUMNS       20
+#define LCD_44780_ROWS          4
+
+#endif  // LCD_44780_20X4_CONFIG_H
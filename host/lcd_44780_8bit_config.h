@@ -0,0 +1,27 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file lcd_44780_8bit_config.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief device_config.h with all eight data lines wired, for the 8 bit
+///         builds of lcd_44780_test.
+///
+///  Force-included ahead of everything else, on its own or with
+///  lcd_44780_20x4_config.h.  D0 to D3 go on PD0 to PD3, so D0 to D7 are
+///  the whole of port D and the driver writes a byte in one go.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCD_44780_8BIT_CONFIG_H
+#define LCD_44780_8BIT_CONFIG_H
+
+#include "config.h"
+#include "device_config.h"
+
+#define LCD_44780_D3            GPIO_PIN_D3
+#define LCD_44780_D2            GPIO_PIN_D2
+#define LCD_44780_D1            GPIO_PIN_D1
+#define LCD_44780_D0            GPIO_PIN_D0
+
+#endif  // LCD_44780_8BIT_CONFIG_H
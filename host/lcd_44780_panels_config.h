@@ -0,0 +1,25 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file lcd_44780_panels_config.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief device_config.h with two panels on the shared bus and the
+///         queue on, for lcd_44780_panels_test.
+///
+///  Force-included ahead of everything else.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCD_44780_PANELS_CONFIG_H
+#define LCD_44780_PANELS_CONFIG_H
+
+#include "config.h"
+#include "device_config.h"
+
+#define PANEL_EN0               GPIO_PIN_B0
+#define PANEL_EN1               GPIO_PIN_C0
+#define LCD_44780_PANELS        PANEL_EN0, PANEL_EN1
+#define LCD_44780_QUEUE_SIZE    64
+
+#endif  // LCD_44780_PANELS_CONFIG_H
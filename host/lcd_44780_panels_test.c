@@ -0,0 +1,159 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file lcd_44780_panels_test.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Runs two panels sharing RS and D7..D4 against two HD44780
+///         models on the PC.
+///
+///  Built with HOST_IO_HOOK and lcd_44780_panels_config.h:  two EN pins
+///  and the queue on.  sample() feeds the shared lines to both models
+///  with each one's own EN, and takes the systick interrupt when it is
+///  due.  Writes both screens, then changes a digit on each in turn and
+///  checks that each panel only saw its own two bytes.  make host-test
+///  runs it.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/interrupt.h>
+#include "config.h"
+#include "device_config.h"
+#include "host_avr.h"
+#include "gpio.h"
+#include "systick.h"
+#include "lcd_44780.h"
+#include "lcd_44780_model.h"
+
+// Timer 0 overflows every 256 clocks at CLK_DIV_8
+#define TICK_CYCLES     (256UL * 8)
+void TIMER0_OVF_vect(void);
+
+static const uint8_t en[2] = { PANEL_EN0, PANEL_EN1 };
+static lcd_44780_model_t model[2];
+static uint64_t next_tick = TICK_CYCLES;
+static uint8_t in_isr = 0;
+static int failed = 0;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Feeds the shared lines and each EN to the models, and
+///   takes the systick interrupt when it is due.
+//////////////////////////////////////////////////////////////////////////////
+static void sample(void)
+{
+  static const uint8_t d[4] =
+    { LCD_44780_D4, LCD_44780_D5, LCD_44780_D6, LCD_44780_D7 };
+  uint8_t data = 0;
+
+  for(uint8_t i = 0; i < 4; i++)
+  {
+    data |= HOST_LEVEL(HOST_PORT(d[i]), d[i]) << (4 + i);
+  }
+  for(uint8_t p = 0; p < 2; p++)
+  {
+    LCD_44780_MODEL_pins(&model[p], host_ns(),
+                         HOST_LEVEL(HOST_PORT(LCD_44780_RS), LCD_44780_RS), 0,
+                         HOST_LEVEL(HOST_PORT(en[p]), en[p]), data);
+  }
+  if(!in_isr && (HOST_SREG & 0x80) && host_cycles >= next_tick)
+  {
+    next_tick += TICK_CYCLES;
+    in_isr = 1;
+    HOST_SREG &= ~0x80;
+    TIMER0_OVF_vect();
+    HOST_SREG |= 0x80;
+    in_isr = 0;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Compares a panel with the text expected.
+//////////////////////////////////////////////////////////////////////////////
+static void expect(const char *what, uint8_t p, const char *text)
+{
+  char buf[(LCD_44780_COLUMNS + 1) * LCD_44780_ROWS + 1];
+
+  LCD_44780_MODEL_render(&model[p], buf, LCD_44780_COLUMNS, LCD_44780_ROWS);
+  if(LCD_44780_MODEL_faults(&model[p]) || strcmp(buf, text))
+  {
+    failed = 1;
+    printf("FAIL %s, panel %u\n%s", what, p, buf);
+    for(int i = 0; i < LCD_44780_MODEL_FAULTS; i++)
+    {
+      if(model[p].faults[i])
+      {
+        printf("  %s: %u\n", LCD_44780_MODEL_fault_name(i),
+               (unsigned)model[p].faults[i]);
+      }
+    }
+  }
+}
+
+int main(void)
+{
+  uint16_t sent[2];
+  uint32_t strobes[2];
+
+  host_reset();
+  LCD_44780_MODEL_init(&model[0], 0);
+  LCD_44780_MODEL_init(&model[1], 0);
+  host_hook = sample;
+  SYSTICK_init(CLK_DIV_8);
+  sei();
+
+  LCD_44780_init2();
+  LCD_44780_sync();
+  expect("init", 0, "                \n                \n");
+  expect("init", 1, "                \n                \n");
+
+  // Queued back to back:  the entries carry their panel.
+  LCD_44780_select(0);
+  LCD_44780_fb_goto(0, 0);
+  LCD_44780_fb_write_string("Panel 0");
+  LCD_44780_fb_goto(0, 1);
+  LCD_44780_fb_write_string("T=21.5");
+  LCD_44780_flush();
+  LCD_44780_select(1);
+  LCD_44780_fb_goto(0, 0);
+  LCD_44780_fb_write_string("Panel 1");
+  LCD_44780_fb_goto(0, 1);
+  LCD_44780_fb_write_string("T=19.0");
+  LCD_44780_flush();
+  LCD_44780_sync();
+  sample();
+  expect("frames", 0, "Panel 0         \nT=21.5          \n");
+  expect("frames", 1, "Panel 1         \nT=19.0          \n");
+
+  // A digit on each:  switching panels mustn't cost either one its
+  // address counter or send it the other's bytes.
+  strobes[0] = model[0].strobes;
+  strobes[1] = model[1].strobes;
+  LCD_44780_select(0);
+  LCD_44780_fb_goto(3, 1);
+  LCD_44780_fb_write_string("2");
+  sent[0] = LCD_44780_flush();
+  LCD_44780_select(1);
+  LCD_44780_fb_goto(5, 1);
+  LCD_44780_fb_write_string("5");
+  sent[1] = LCD_44780_flush();
+  LCD_44780_sync();
+  sample();
+  expect("digits", 0, "Panel 0         \nT=22.5          \n");
+  expect("digits", 1, "Panel 1         \nT=19.5          \n");
+  for(uint8_t p = 0; p < 2; p++)
+  {
+    uint32_t s = model[p].strobes - strobes[p];
+    printf("lcd_44780 panels: panel %u digit %u bytes, %u strobes\n", p,
+           sent[p], (unsigned)s);
+    if(sent[p] != 2 || s != 4)
+    {
+      failed = 1;
+      printf("FAIL panel %u:  2 bytes, 4 strobes expected\n", p);
+    }
+  }
+
+  printf("lcd_44780 panels: %s\n", failed ? "FAILED" : "passed");
+  return failed;
+}
@@ -0,0 +1,25 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file lcd_44780_pcf_config.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief device_config.h with the panel behind a PCF8574 backpack on the
+///         bit-banged I2C bus, for lcd_44780_pcf_test.
+///
+///  Force-included ahead of everything else.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCD_44780_PCF_CONFIG_H
+#define LCD_44780_PCF_CONFIG_H
+
+#include "config.h"
+#include "device_config.h"
+
+#define LCD_44780_PCF8574       0x27
+#define LCD_44780_PCF8574_BPS   100000
+#define TWI_SOFT_SDA            GPIO_PIN_C4
+#define TWI_SOFT_SCL            GPIO_PIN_C5
+
+#endif  // LCD_44780_PCF_CONFIG_H
@@ -0,0 +1,135 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file lcd_44780_pcf_test.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Runs lcd_44780.c through a PCF8574 backpack on the PC and
+///         reports the throughput.
+///
+///  Built with HOST_IO_HOOK and lcd_44780_pcf_config.h, so the driver
+///  talks to the expander over twi.c's bit-banged bus.  sample() feeds SDA
+///  and SCL to the PCF8574 model, puts its ack on SDA, and feeds the
+///  expander's port to the HD44780 model as the common backpack wires it.
+///  Writes every cell of the screen and fails if the model counted any
+///  fault or shows anything else.
+///
+///  The chars/s figures come from the SCL clocks the frame took, counting
+///  start and stop as a bit time each, so they hold for the TWI
+///  peripheral at that rate too.  The bit-banged figure is the host's
+///  count of the cycles twi.c takes.  make host-test runs it.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "device_config.h"
+#include "host_avr.h"
+#include "gpio.h"
+#include "lcd_44780.h"
+#include "lcd_44780_model.h"
+#include "pcf8574_model.h"
+
+// The common backpack:  RS P0, RW P1, EN P2, backlight P3, D7..D4 on P7..P4
+#define PCF_RS          0x01
+#define PCF_RW          0x02
+#define PCF_EN          0x04
+
+static lcd_44780_model_t lcd;
+static pcf8574_model_t pcf;
+static int failed = 0;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Drives a PIN bit with the level of a line.
+//////////////////////////////////////////////////////////////////////////////
+static void drive(uint8_t pin, uint8_t level)
+{
+  HOST_PIN(pin) = (HOST_PIN(pin) & ~GPIO_PIN_MASK(pin))
+    | (level ? GPIO_PIN_MASK(pin) : 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Feeds the bus to the expander and its port to the panel,
+///   as they are before the access that is about to happen.
+/// @remark Open drain:  a pin set as an output pulls its line low,
+///   otherwise the pull-up holds it high unless the expander acks.
+//////////////////////////////////////////////////////////////////////////////
+static void sample(void)
+{
+  uint64_t t = host_ns();
+  uint8_t scl = !HOST_LEVEL(HOST_DDR(TWI_SOFT_SCL), TWI_SOFT_SCL);
+  uint8_t sda = !HOST_LEVEL(HOST_DDR(TWI_SOFT_SDA), TWI_SOFT_SDA);
+
+  if(PCF8574_MODEL_pins(&pcf, t, sda && PCF8574_MODEL_sda(&pcf), scl))
+  {
+    uint8_t p = pcf.out;
+    LCD_44780_MODEL_pins(&lcd, t, p & PCF_RS, p & PCF_RW, p & PCF_EN,
+                         p & 0xf0);
+  }
+  drive(TWI_SOFT_SCL, scl);
+  drive(TWI_SOFT_SDA, sda && PCF8574_MODEL_sda(&pcf));
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Compares the panel with the text expected.
+//////////////////////////////////////////////////////////////////////////////
+static void expect(const char *what, const char *text)
+{
+  char buf[(LCD_44780_COLUMNS + 1) * LCD_44780_ROWS + 1];
+
+  LCD_44780_MODEL_render(&lcd, buf, LCD_44780_COLUMNS, LCD_44780_ROWS);
+  if(LCD_44780_MODEL_faults(&lcd) || strcmp(buf, text))
+  {
+    failed = 1;
+    printf("FAIL %s\n%s", what, buf);
+    for(int i = 0; i < LCD_44780_MODEL_FAULTS; i++)
+    {
+      if(lcd.faults[i])
+      {
+        printf("  %s: %u\n", LCD_44780_MODEL_fault_name(i),
+               (unsigned)lcd.faults[i]);
+      }
+    }
+  }
+}
+
+int main(void)
+{
+  static const char *rows[2] = { "0123456789ABCDEF", "fedcba9876543210" };
+  uint32_t chars = 0;
+
+  host_reset();
+  LCD_44780_MODEL_init(&lcd, 0);
+  PCF8574_MODEL_init(&pcf, LCD_44780_PCF8574);
+  host_hook = sample;
+
+  LCD_44780_init2();
+  expect("init", "                \n                \n");
+
+  uint64_t t0 = host_ns();
+  uint32_t tr0 = pcf.transactions;
+  uint32_t clk0 = pcf.clocks;
+  for(uint8_t r = 0; r < 2; r++)
+  {
+    LCD_44780_fb_goto(0, r);
+    LCD_44780_fb_write_string(rows[r]);
+    chars += strlen(rows[r]);
+  }
+  LCD_44780_flush();
+  sample();
+  expect("frame", "0123456789ABCDEF\nfedcba9876543210\n");
+
+  uint32_t tr = pcf.transactions - tr0;
+  uint32_t bits = (pcf.clocks - clk0) + 2 * tr;
+  double ns = (double)(host_ns() - t0);
+  printf("lcd_44780 pcf8574: %u chars, %u transactions, %u bit times\n",
+         (unsigned)chars, (unsigned)tr, (unsigned)bits);
+  printf("lcd_44780 pcf8574: %.0f chars/s at 100 kHz, %.0f at 400 kHz, "
+         "%.0f bit-banged at %lu\n",
+         chars * 100000.0 / bits, chars * 400000.0 / bits,
+         chars * 1e9 / ns, (unsigned long)LCD_44780_PCF8574_BPS);
+
+  printf("lcd_44780 pcf8574: %s\n", failed ? "FAILED" : "passed");
+  return failed;
+}
@@ -0,0 +1,24 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file lcd_44780_rw_blocking_config.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief device_config.h with RW wired and no queue, for the blocking
+///         RW build of lcd_44780_test.
+///
+///  Force-included ahead of everything else.  Every call then polls the
+///  busy flag until the controller is done, and the test reads the panel
+///  back.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCD_44780_RW_BLOCKING_CONFIG_H
+#define LCD_44780_RW_BLOCKING_CONFIG_H
+
+#include "config.h"
+#include "device_config.h"
+
+#define LCD_44780_RW            GPIO_PIN_B2
+
+#endif  // LCD_44780_RW_BLOCKING_CONFIG_H
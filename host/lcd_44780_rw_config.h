@@ -0,0 +1,24 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file lcd_44780_rw_config.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief device_config.h with RW wired and the queue on, for the second
+///         build of lcd_44780_test.
+///
+///  Force-included ahead of everything else.  The queue then polls the
+///  busy flag instead of holding, and the test reads the panel back.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCD_44780_RW_CONFIG_H
+#define LCD_44780_RW_CONFIG_H
+
+#include "config.h"
+#include "device_config.h"
+
+#define LCD_44780_RW            GPIO_PIN_B2
+#define LCD_44780_QUEUE_SIZE    64
+
+#endif  // LCD_44780_RW_CONFIG_H
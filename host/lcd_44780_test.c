@@ -0,0 +1,408 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file lcd_44780_test.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Runs lcd_44780.c against the HD44780 model on the PC.
+///
+///  Built with HOST_IO_HOOK so every port access reaches sample(), which
+///  feeds the device_config.h pins to the model and, while the panel is
+///  read, drives the data pins with what it puts on the bus.  Writes a
+///  screen through the frame buffer and fails if the model counted any
+///  timing fault or shows anything else.  Then times a whole screen.
+///  make host-test runs it.
+///
+///  Built again with lcd_44780_rw_config.h, which wires RW and turns the
+///  queue on.  sample() then takes the systick interrupt when it is due
+///  and the screen is read back, so a read while the controller is
+///  still busy counts as a fault.  lcd_44780_rw_blocking_config.h wires
+///  RW without the queue, so each call polls the busy flag instead of
+///  waiting the datasheet time.  lcd_44780_8bit_config.h wires D0 to D3
+///  and lcd_44780_20x4_config.h makes the panel 20x4; the 8 bit and 20x4
+///  builds use them on their own and together.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/interrupt.h>
+#include "config.h"
+#include "device_config.h"
+#include "host_avr.h"
+#include "gpio.h"
+#include "systick.h"
+#include "lcd_44780.h"
+#include "lcd_44780_model.h"
+
+#define STR(x)          #x
+#define XSTR(x)         STR(x)
+
+#ifdef LCD_44780_D0
+#define BUS_LINES       8
+#define NAME_BUS        " 8 bit"
+#else
+#define BUS_LINES       4
+#define NAME_BUS        " 4 bit"
+#endif
+#ifdef LCD_44780_RW
+#define NAME_RW         " rw"
+#else
+#define NAME_RW         ""
+#endif
+#ifdef LCD_44780_QUEUE_SIZE
+#define NAME_QUEUE      " queued"
+#else
+#define NAME_QUEUE      ""
+#endif
+#define NAME            "lcd_44780 " XSTR(LCD_44780_COLUMNS) "x"            \
+                        XSTR(LCD_44780_ROWS) NAME_BUS NAME_RW NAME_QUEUE
+
+// Data pins, D0 or D4 up
+static const uint8_t d[BUS_LINES] =
+  {
+#ifdef LCD_44780_D0
+    LCD_44780_D0, LCD_44780_D1, LCD_44780_D2, LCD_44780_D3,
+#endif
+    LCD_44780_D4, LCD_44780_D5, LCD_44780_D6, LCD_44780_D7
+  };
+
+static lcd_44780_model_t model;
+static int failed = 0;
+
+#ifdef LCD_44780_QUEUE_SIZE
+// Timer 0 overflows every 256 clocks at CLK_DIV_8
+#define TICK_CYCLES     (256UL * 8)
+void TIMER0_OVF_vect(void);
+static uint64_t next_tick = TICK_CYCLES;
+static uint8_t in_isr = 0;
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Feeds the pins to the model as they are before the
+///   access that is about to happen.
+//////////////////////////////////////////////////////////////////////////////
+static void sample(void)
+{
+  uint8_t data = 0;
+  uint8_t rw = 0;
+  uint8_t bus;
+
+  for(uint8_t i = 0; i < BUS_LINES; i++)
+  {
+    data |= HOST_LEVEL(HOST_PORT(d[i]), d[i]) << (8 - BUS_LINES + i);
+  }
+#ifdef LCD_44780_RW
+  rw = HOST_LEVEL(HOST_PORT(LCD_44780_RW), LCD_44780_RW);
+#endif
+  LCD_44780_MODEL_pins(&model, host_ns(),
+                       HOST_LEVEL(HOST_PORT(LCD_44780_RS), LCD_44780_RS), rw,
+                       HOST_LEVEL(HOST_PORT(LCD_44780_EN), LCD_44780_EN),
+                       data);
+  bus = LCD_44780_MODEL_bus(&model);
+  for(uint8_t i = 0; i < BUS_LINES; i++)
+  {
+    HOST_PIN(d[i]) = (HOST_PIN(d[i]) & ~GPIO_PIN_MASK(d[i]))
+      | (((bus >> (8 - BUS_LINES + i)) & 1) ? GPIO_PIN_MASK(d[i]) : 0);
+  }
+#ifdef LCD_44780_QUEUE_SIZE
+  // The systick interrupt, between accesses as the part would take it
+  if(!in_isr && (HOST_SREG & 0x80) && host_cycles >= next_tick)
+  {
+    next_tick += TICK_CYCLES;
+    in_isr = 1;
+    HOST_SREG &= ~0x80;
+    TIMER0_OVF_vect();
+    HOST_SREG |= 0x80;
+    in_isr = 0;
+  }
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Compares the panel with the text expected, a line per
+///   row.  Lines are padded with spaces and rows left out are blank, so
+///   the same text fits any panel.  CGRAM shows as codes 8 to 15.
+//////////////////////////////////////////////////////////////////////////////
+static void expect(const char *what, const char *text)
+{
+  char buf[(LCD_44780_COLUMNS + 1) * LCD_44780_ROWS + 1];
+  char want[sizeof(buf)];
+  char *w = want;
+
+  for(uint8_t r = 0; r < LCD_44780_ROWS; r++)
+  {
+    uint8_t c = 0;
+    while(*text != '\0' && *text != '\n' && c < LCD_44780_COLUMNS)
+    {
+      *w++ = *text++;
+      c++;
+    }
+    while(c++ < LCD_44780_COLUMNS)
+    {
+      *w++ = ' ';
+    }
+    *w++ = '\n';
+    if(*text == '\n')
+    {
+      text++;
+    }
+  }
+  *w = '\0';
+  LCD_44780_MODEL_render(&model, buf, LCD_44780_COLUMNS, LCD_44780_ROWS);
+  if(LCD_44780_MODEL_faults(&model) || memcmp(buf, want, sizeof(buf)))
+  {
+    failed = 1;
+    printf("FAIL %s\n", what);
+    fwrite(buf, 1, sizeof(buf) - 1, stdout);
+    for(int i = 0; i < LCD_44780_MODEL_FAULTS; i++)
+    {
+      if(model.faults[i])
+      {
+        printf("  %s: %u\n", LCD_44780_MODEL_fault_name(i),
+               (unsigned)model.faults[i]);
+      }
+    }
+  }
+}
+
+#if defined(LCD_44780_QUEUE_SIZE) && LCD_44780_ROWS <= 2
+#define MARQUEE_MS      10
+#define MARQUEE_CYCLES  (F_CPU / 1000 * MARQUEE_MS)
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Lets time pass with nothing else going on, the systick
+///   interrupt and the marquee still running.
+/// @param[in] until  host_cycles to stop at
+//////////////////////////////////////////////////////////////////////////////
+static void idle(uint64_t until)
+{
+  while(host_cycles < until)
+  {
+    host_delay_cycles(64);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Scrolls text along row 1 and checks the row and the
+///   bytes the controller took for every step.
+/// @param[in] text   Marquee text
+/// @param[in] steps  Steps to check
+/// @remark Samples half way between steps, to within a tick.  Step k
+///   shows the text, then blanks, from place k:  the 40 column line for
+///   text that fits in it, the text and a screen of blanks for longer
+///   text.
+//////////////////////////////////////////////////////////////////////////////
+static void marquee(const char *text, uint16_t steps)
+{
+  char buf[(LCD_44780_COLUMNS + 1) * LCD_44780_ROWS + 1];
+  uint16_t len = strlen(text);
+  uint16_t period = (len <= 40) ? 40 : len + LCD_44780_COLUMNS;
+  uint32_t per_step = (len <= 40) ? 1 : 3;
+
+  LCD_44780_marquee(1, text, MARQUEE_MS);
+  LCD_44780_sync();
+  // The first step waits for the line to be written, so time the rest
+  // from it
+  uint16_t first = model.shift + 1;
+  uint32_t bytes = model.commands + model.writes;
+  while(model.shift != first)
+  {
+    bytes = model.commands + model.writes;
+    host_delay_cycles(64);
+  }
+  uint64_t start = host_cycles;
+  for(uint16_t k = first; k <= steps && !failed; k++)
+  {
+    idle(start + (k - first) * MARQUEE_CYCLES + MARQUEE_CYCLES / 2);
+    uint32_t now = model.commands + model.writes;
+    const char *row = buf + LCD_44780_COLUMNS + 1;
+    LCD_44780_MODEL_render(&model, buf, LCD_44780_COLUMNS, LCD_44780_ROWS);
+    for(uint8_t c = 0; c < LCD_44780_COLUMNS; c++)
+    {
+      uint16_t i = (k + c) % period;
+      if(row[c] != ((i < len) ? text[i] : ' '))
+      {
+        failed = 1;
+      }
+    }
+    if(failed || now - bytes != per_step || LCD_44780_MODEL_faults(&model))
+    {
+      failed = 1;
+      printf("FAIL marquee of %u at step %u:  %lu bytes\n%s", len, k,
+             (unsigned long)(now - bytes), buf);
+    }
+    bytes = now;
+  }
+  LCD_44780_marquee_stop();
+  LCD_44780_flush();
+  LCD_44780_sync();
+  sample();
+  printf(NAME ": marquee of %u, %lu bytes a step, %u steps\n", len,
+         (unsigned long)per_step, steps);
+}
+#endif
+
+int main(void)
+{
+  static const uint8_t bell[8] = { 4, 14, 14, 14, 31, 0, 4, 0 };
+  char glyph[49];
+  uint64_t t0;
+
+  host_reset();
+  LCD_44780_MODEL_init(&model, BUS_LINES == 8);
+  host_hook = sample;
+#ifdef LCD_44780_QUEUE_SIZE
+  SYSTICK_init(CLK_DIV_8);
+  sei();
+#endif
+
+  LCD_44780_init2();
+  LCD_44780_sync();
+  expect("init", "");
+
+  t0 = host_ns();
+  LCD_44780_fb_goto(0, 0);
+  LCD_44780_fb_write_string("Hello, World!");
+  LCD_44780_fb_goto(0, 1);
+  LCD_44780_fb_write_string("V=12.5");
+  LCD_44780_flush();
+  LCD_44780_sync();
+  sample();
+  printf(NAME ": frame %.1f uS, %u strobes\n", (host_ns() - t0) / 1e3,
+         (unsigned)model.strobes);
+  expect("frame", "Hello, World!\nV=12.5");
+
+  LCD_44780_fb_goto(3, 1);
+  LCD_44780_fb_write_string("3");
+  LCD_44780_flush();
+  LCD_44780_sync();
+  sample();
+  expect("digit", "Hello, World!\nV=13.5");
+
+#ifdef LCD_44780_RW
+  // Each read follows a command the controller may still be running
+  char back[7] = { 0 };
+  LCD_44780_goto(0, 1);
+  for(uint8_t i = 0; i < 6; i++)
+  {
+    back[i] = LCD_44780_read_data();
+  }
+  LCD_44780_goto(5, 1);
+  uint8_t ac = LCD_44780_read_status();
+  sample();
+  if(strcmp(back, "V=13.5") || ac != 0x45)
+  {
+    failed = 1;
+    printf("FAIL read back \"%s\", address %02x\n", back, ac);
+  }
+  expect("read", "Hello, World!\nV=13.5");
+#endif
+
+  // Decrement mode:  the driver loses the address, each flush must
+  // still send a cell once.
+  LCD_44780_entry_mode(0);
+  LCD_44780_fb_goto(10, 1);
+  LCD_44780_fb_write_string("xyz");
+  uint16_t sent[3];
+  for(uint8_t i = 0; i < 3; i++)
+  {
+    sent[i] = LCD_44780_flush();
+  }
+  LCD_44780_entry_mode(LCD_44780_INCREMENT);
+  LCD_44780_sync();
+  sample();
+  if(sent[0] != 6 || sent[1] != 0 || sent[2] != 0)
+  {
+    failed = 1;
+    printf("FAIL decrement flushes sent %u, %u, %u\n", sent[0], sent[1],
+           sent[2]);
+  }
+  expect("decrement", "Hello, World!\nV=13.5    xyz");
+
+  LCD_44780_fb_goto(15, 0);
+  LCD_44780_fb_putglyph(bell);
+  LCD_44780_flush();
+  LCD_44780_sync();
+  sample();
+  LCD_44780_MODEL_render_glyph(&model, glyph, 0);
+  if(strcmp(glyph, "..#..\n.###.\n.###.\n.###.\n#####\n.....\n..#..\n.....\n"))
+  {
+    failed = 1;
+    printf("FAIL glyph\n%s", glyph);
+  }
+  // The driver loads glyphs as codes 8 to 15, which show CGRAM 0 to 7
+  expect("glyph", "Hello, World!  \x08\nV=13.5    xyz");
+
+  // LRU past 256 requests:  with the bell showing, g[0] to g[6] fill the
+  // other slots, g[0] is asked for over and over, and g[7] has to take
+  // g[1]'s slot, the one asked for longest ago.
+  static uint8_t g[8][8];
+  uint8_t code[8];
+  for(uint8_t i = 0; i < 8; i++)
+  {
+    g[i][0] = i + 1;
+  }
+  for(uint8_t i = 0; i < 7; i++)
+  {
+    code[i] = LCD_44780_glyph(g[i]);
+    LCD_44780_sync();
+  }
+  for(uint16_t n = 0; n < 252; n++)
+  {
+    LCD_44780_glyph(g[0]);
+  }
+  code[7] = LCD_44780_glyph(g[7]);
+  LCD_44780_sync();
+  if(code[7] != code[1])
+  {
+    failed = 1;
+    printf("FAIL LRU:  evicted code %02x, not %02x\n", code[7], code[1]);
+  }
+
+#if defined(LCD_44780_QUEUE_SIZE) && LCD_44780_ROWS <= 2
+  // Twice round the line for the short text, and round the long text
+  // and its blanks once, refilling every column of the line
+  marquee("Short marquee", 85);
+  expect("marquee short", "Hello, World!  \x08\nV=13.5    xyz");
+  marquee("A marquee longer than the forty columns of DDRAM", 70);
+  expect("marquee long", "Hello, World!  \x08\nV=13.5    xyz");
+#endif
+
+  // Every cell changed at once, from the flush until the last byte has
+  // executed
+  char screen[(LCD_44780_COLUMNS + 1) * LCD_44780_ROWS + 1];
+  char *p = screen;
+  for(uint8_t row = 0; row < LCD_44780_ROWS; row++)
+  {
+    for(uint8_t col = 0; col < LCD_44780_COLUMNS; col++)
+    {
+      *p++ = 'A' + (row * LCD_44780_COLUMNS + col) % 26;
+    }
+    *p++ = '\n';
+  }
+  *p = '\0';
+  uint32_t bytes = LCD_44780_bus_bytes();
+  p = screen;
+  for(uint8_t row = 0; row < LCD_44780_ROWS; row++)
+  {
+    LCD_44780_fb_goto(0, row);
+    for(; *p != '\n'; p++)
+    {
+      LCD_44780_fb_putc(*p);
+    }
+    p++;
+  }
+  t0 = host_ns();
+  LCD_44780_flush();
+  LCD_44780_sync();
+  sample();
+  printf(NAME ": full screen %lu bytes, %.1f uS, %.0f chars/s\n",
+         (unsigned long)(LCD_44780_bus_bytes() - bytes),
+         (host_ns() - t0) / 1e3,
+         LCD_44780_COLUMNS * LCD_44780_ROWS * 1e9 / (host_ns() - t0));
+  expect("full screen", screen);
+
+  printf(NAME ": %s\n", failed ? "FAILED" : "passed");
+  return failed;
+}
@@ -0,0 +1,211 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file serial_bench.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Throughput and loss of serial.c, against the USART model on
+///         the PC.
+///
+///  The driver runs for real, but time is a budget:  each ISR and each
+///  SERIAL_read or SERIAL_write call lets the model run by the cycles it
+///  is reckoned to cost, counted by hand from the code as there is no
+///  avr-gcc to count them.  So the figures are model estimates, not
+///  measurements.  The ISRs run whenever their flag is up, ahead of the
+///  main loop.  Every row of costs runs 100000 bytes four ways:  receive
+///  only and transmit only at 1 Mbaud, and echoing each byte back at
+///  1 Mbaud and at 500 kbaud.
+///
+///  Fails unless receive and transmit alone keep up at 1 Mbaud and echo
+///  keeps up at 500 kbaud, with nothing lost, at every cost.  Echo at
+///  1 Mbaud is shown to make the limit in serial.h visible:  its four
+///  steps take more than a 160 cycle frame and it drops bytes.  make
+///  host-test runs it.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include "config.h"
+#include "host_avr.h"
+#include "serial.h"
+#include "usart_model.h"
+
+#define BYTES       100000UL
+#define FRAME(bps)  (10 * F_CPU / (bps))  // 8N1, in CPU cycles
+
+void USART_RXC_vect(void);
+void USART_UDRE_vect(void);
+
+// Cycles for each step, ISR entry and exit included
+typedef struct cost
+{
+  uint16_t rx_isr;
+  uint16_t udre_isr;
+  uint16_t read;
+  uint16_t write;
+} cost_t;
+
+static const cost_t costs[] =
+{
+  {  60,  60, 30, 30 },
+  {  80,  80, 40, 40 },
+  { 100, 100, 50, 50 },
+};
+
+typedef struct result
+{
+  uint32_t got;             // bytes SERIAL_read returned
+  uint32_t gaps;            // of those, out of sequence
+  uint32_t dropped;         // lost to a full receive ring
+  uint32_t overruns;        // lost to a full USART FIFO
+  uint32_t sent;            // bytes that went out on the line
+  double   per_byte;        // cycles between them
+} result_t;
+
+static usart_model_t usart;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Runs 100000 bytes one way ('r' or 't') or echoed ('e')
+///   at bps.
+//////////////////////////////////////////////////////////////////////////////
+static void run(char mode, uint32_t bps, const cost_t *c, result_t *r)
+{
+  uint32_t want_rx = (mode == 't') ? 0 : BYTES;
+  uint32_t want_tx = (mode == 'r') ? 0 : BYTES;
+  uint32_t written = 0;
+  int holding = -1;
+  uint8_t expect = 0;
+  serial_stats_t st;
+
+  host_reset();
+  *r = (result_t){ 0 };
+  SERIAL_init(0, bps, 'N', 1, 8);
+  USART_MODEL_init(&usart, FRAME(bps));
+  USART_MODEL_incoming(&usart, want_rx);
+
+  while(usart.now < (uint64_t)BYTES * FRAME(bps) * 3)
+  {
+    if(r->got + r->dropped + usart.overruns >= want_rx
+       && usart.sent >= want_tx && USART_MODEL_udre(&usart))
+    {
+      break;
+    }
+    if(USART_MODEL_rxc(&usart))
+    {
+      uint8_t dor;
+      uint8_t b = USART_MODEL_read(&usart, &dor);
+      UCSRA = (UCSRA & (1 << U2X)) | (1 << RXC) | (dor ? (1 << DOR) : 0);
+      UDR = b;
+      SERIAL_get_stats(0, &st);
+      uint16_t d = st.dropped;
+      USART_RXC_vect();
+      SERIAL_get_stats(0, &st);
+      r->dropped += (uint16_t)(st.dropped - d);
+      USART_MODEL_run(&usart, c->rx_isr);
+    }
+    else if((UCSRB & (1 << UDRIE)) && USART_MODEL_udre(&usart))
+    {
+      int left = SERIAL_sending(0);
+      USART_UDRE_vect();
+      if(SERIAL_sending(0) != left)
+      {
+        USART_MODEL_write(&usart, UDR);
+      }
+      USART_MODEL_run(&usart, c->udre_isr);
+    }
+    else if(mode == 't')
+    {
+      if(written < want_tx && SERIAL_write(0, (uint8_t)written) >= 0)
+      {
+        written++;
+      }
+      USART_MODEL_run(&usart, c->write);
+    }
+    else if(holding < 0)
+    {
+      int ch = SERIAL_read(0);
+      USART_MODEL_run(&usart, c->read);
+      if(ch >= 0)
+      {
+        r->gaps += ((uint8_t)ch != expect);
+        expect = (uint8_t)ch + 1;
+        r->got++;
+        if(mode == 'e')
+        {
+          holding = ch;
+        }
+      }
+    }
+    else
+    {
+      if(SERIAL_write(0, holding) >= 0)
+      {
+        holding = -1;
+      }
+      USART_MODEL_run(&usart, c->write);
+    }
+  }
+  r->overruns = usart.overruns;
+  r->sent = usart.sent;
+  r->per_byte = (usart.sent > 1)
+    ? (double)(usart.last_tx - usart.first_tx) / (usart.sent - 1) : 0;
+}
+
+int main(void)
+{
+  // Each run:  mode, bps, and whether it has to keep up
+  static const struct
+  {
+    char mode;
+    const char *name;
+    uint32_t bps;
+    uint8_t check;
+  } runs[] =
+  {
+    { 'r', "rx",   1000000, 1 },
+    { 't', "tx",   1000000, 1 },
+    { 'e', "echo", 1000000, 0 },
+    { 'e', "echo",  500000, 1 },
+  };
+  int failed = 0;
+
+  printf("serial: model estimates, hand-counted cycle costs\n");
+  for(unsigned i = 0; i < sizeof(costs) / sizeof(costs[0]); i++)
+  {
+    for(unsigned k = 0; k < sizeof(runs) / sizeof(runs[0]); k++)
+    {
+      result_t r;
+      uint32_t frame = FRAME(runs[k].bps);
+      run(runs[k].mode, runs[k].bps, &costs[i], &r);
+      printf("serial: %-4s %4lu k isr %3u/%3u call %2u/%2u:  got %6lu "
+             "gaps %5lu dropped %5lu overrun %5lu | sent %6lu at %5.1f "
+             "cycles/byte%s\n",
+             runs[k].name, (unsigned long)(runs[k].bps / 1000),
+             costs[i].rx_isr, costs[i].udre_isr, costs[i].read,
+             costs[i].write, (unsigned long)r.got, (unsigned long)r.gaps,
+             (unsigned long)r.dropped, (unsigned long)r.overruns,
+             (unsigned long)r.sent, r.per_byte,
+             runs[k].check ? "" : "  (over budget, not checked)");
+      if(!runs[k].check)
+      {
+        continue;
+      }
+      if(runs[k].mode != 't' && (r.got != BYTES || r.gaps || r.dropped
+                                 || r.overruns))
+      {
+        failed = 1;
+      }
+      // Echo is paced by what comes in, so only the count is its to keep
+      if(runs[k].mode == 't' && r.per_byte != frame)
+      {
+        failed = 1;
+      }
+      if(runs[k].mode != 'r' && r.sent != BYTES)
+      {
+        failed = 1;
+      }
+    }
+  }
+  printf("serial: %s\n", failed ? "FAILED" : "passed");
+  return failed;
+}
@@ -0,0 +1,24 @@
+//////////////////////////////////////////////////////////////////////////////
+///  @file softspi_lanes_config.h
+///  @brief config.h for host/softspi_lanes_test.c, forced in with -include.
+///
+///  Four devices three ways, all _SLOW mode 0 at 100 kHz and bit-banged:
+///  one interface each on SS C0 to C3, four lanes on D4 to D7 behind
+///  SS C4, and a chain of four behind SS C5.  Each device takes 16 bits.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "config.h"
+
+#undef SOFTSPI_INTERFACES
+#define SOFTSPI_INTERFACES   \
+  SOFTSPI_INTERFACE(100000,   GPIO_PIN_C0, SPI_MODE_0_MSB_FIRST_SLOW, 16, SOFTSPI_BACKEND_SOFT), \
+  SOFTSPI_INTERFACE(100000,   GPIO_PIN_C1, SPI_MODE_0_MSB_FIRST_SLOW, 16, SOFTSPI_BACKEND_SOFT), \
+  SOFTSPI_INTERFACE(100000,   GPIO_PIN_C2, SPI_MODE_0_MSB_FIRST_SLOW, 16, SOFTSPI_BACKEND_SOFT), \
+  SOFTSPI_INTERFACE(100000,   GPIO_PIN_C3, SPI_MODE_0_MSB_FIRST_SLOW, 16, SOFTSPI_BACKEND_SOFT), \
+  SOFTSPI_INTERFACE(100000,   GPIO_PIN_C4, SPI_MODE_0_MSB_FIRST_SLOW, 16, SOFTSPI_BACKEND_SOFT), \
+  SOFTSPI_INTERFACE(100000,   GPIO_PIN_C5, SPI_MODE_0_MSB_FIRST_SLOW, 16, SOFTSPI_BACKEND_SOFT)
+
+#define SOFTSPI_ENABLE_MODE_0_MSB_FIRST_SLOW    1
+
+#define SOFTSPI_LANE_PINS   GPIO_PIN_D4, GPIO_PIN_D5, GPIO_PIN_D6, GPIO_PIN_D7
+#define SOFTSPI_CHAINS      SOFTSPI_CHAIN(5, 4, 2)
@@ -0,0 +1,190 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file softspi_lanes_test.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Sends a word to each of four devices three ways on the PC:
+///         four SOFTSPI_write calls, one SOFTSPI_lanes_write and one
+///         SOFTSPI_chain_flush.
+///
+///  softspi_lanes_config.h sets up the interfaces.  watch() runs on every
+///  delay, when the kernels let time pass, and clocks MOSI and each lane
+///  in on the rising edges, as a mode 0 device would.  Every device must
+///  get its own word, with its SS low, and the lanes must take a quarter
+///  of the SCLK edges the four writes do.
+///
+///  The host clock only counts the delays, so the times printed add the
+///  hand-counted kernel cycles for each edge:  an estimate for the part.
+///  The lanes delay must put the lanes kernel within 5% under 100 kHz.
+///  make host-test runs it.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include "config.h"
+#include "host_avr.h"
+#include "gpio.h"
+#include "softspi.h"
+
+#define DEVICES   4
+#define BPS       100000UL
+
+static const uint8_t lane_pins[DEVICES] = { SOFTSPI_LANE_PINS };
+static const uint16_t words[DEVICES] = { 0xa5c3, 0x5a3c, 0xf00f, 0x0ff1 };
+
+static int failed = 0;
+static uint8_t ss;              // SS that has to be low on every edge
+static uint8_t clk_was;
+static uint32_t edges;          // rising SCLK edges
+static uint32_t stray;          // of those, with ss high
+static uint64_t mosi;           // MOSI bits, last in bit 0
+static uint16_t lanes[DEVICES]; // each lane's bits, last in bit 0
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Clocks MOSI and the lanes in on a rising SCLK.
+//////////////////////////////////////////////////////////////////////////////
+static void watch(void)
+{
+  uint8_t clk = HOST_LEVEL(HOST_PORT(SOFTSPI_CLK), SOFTSPI_CLK);
+  if(clk && !clk_was)
+  {
+    edges++;
+    if(HOST_LEVEL(HOST_PORT(ss), ss))
+    {
+      stray++;
+    }
+    mosi = (mosi << 1) | HOST_LEVEL(HOST_PORT(SOFTSPI_MOSI), SOFTSPI_MOSI);
+    for(uint8_t k = 0; k < DEVICES; k++)
+    {
+      lanes[k] = (lanes[k] << 1)
+        | HOST_LEVEL(HOST_PORT(lane_pins[k]), lane_pins[k]);
+    }
+  }
+  clk_was = clk;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Clears the decoders and the clock for the next way.
+/// @param[in] pin  SS the edges have to fall under
+//////////////////////////////////////////////////////////////////////////////
+static void start(uint8_t pin)
+{
+  ss = pin;
+  clk_was = 0;
+  edges = 0;
+  stray = 0;
+  mosi = 0;
+  for(uint8_t k = 0; k < DEVICES; k++)
+  {
+    lanes[k] = 0;
+  }
+  host_cycles = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Prints one way's edges and estimated time.
+/// @param[in] name    Way
+/// @param[in] kernel  Hand-counted kernel cycles per bit
+//////////////////////////////////////////////////////////////////////////////
+static void report(const char *name, uint32_t kernel)
+{
+  uint64_t cycles = host_cycles + (uint64_t)edges * kernel;
+  printf("softspi lanes: %-16s %3lu edges %5lu delay cycles, about "
+         "%5.1f uS on the part\n", name, (unsigned long)edges,
+         (unsigned long)host_cycles, cycles * 1e6 / F_CPU);
+  if(stray)
+  {
+    failed = 1;
+    printf("FAIL %s: %lu edges with SS high\n", name, (unsigned long)stray);
+  }
+}
+
+int main(void)
+{
+  uint8_t data[2 * DEVICES];
+  uint32_t one_by_one;
+
+  host_reset();
+  SOFTSPI_init2();
+  host_hook = watch;
+
+  // One SOFTSPI_write per device, each behind its own SS
+  start(GPIO_PIN_C0);
+  uint64_t want = 0;
+  for(uint8_t k = 0; k < DEVICES; k++)
+  {
+    ss = GPIO_PIN_C0 + k;
+    SOFTSPI_write(k, words[k]);
+    want = (want << 16) | words[k];
+  }
+  report("SOFTSPI_write x4", SOFTSPI_SLOW_KERNEL_CYCLES);
+  one_by_one = edges;
+  if(mosi != want || edges != 16 * DEVICES)
+  {
+    failed = 1;
+    printf("FAIL writes: %lu edges, MOSI 0x%016llx\n", (unsigned long)edges,
+           (unsigned long long)mosi);
+  }
+
+  // The same words, one per lane, in one SS window
+  for(uint8_t k = 0; k < DEVICES; k++)
+  {
+    data[k] = words[k] >> 8;
+    data[DEVICES + k] = (uint8_t)words[k];
+  }
+  start(GPIO_PIN_C4);
+  SOFTSPI_lanes_write(4, data, 2);
+  report("lanes", SOFTSPI_LANES_KERNEL_CYCLES);
+  for(uint8_t k = 0; k < DEVICES; k++)
+  {
+    if(lanes[k] != words[k])
+    {
+      failed = 1;
+      printf("FAIL lane %u: got 0x%04x, not 0x%04x\n", k, lanes[k],
+             words[k]);
+    }
+  }
+  if(edges * DEVICES != one_by_one)
+  {
+    failed = 1;
+    printf("FAIL lanes: %lu edges, not %lu\n", (unsigned long)edges,
+           (unsigned long)(one_by_one / DEVICES));
+  }
+  else
+  {
+    // Only the lanes kernel's delays ran, so this is 8 per tick a bit
+    uint32_t bit = host_cycles / edges + SOFTSPI_LANES_KERNEL_CYCLES;
+    uint32_t bps = F_CPU / bit;
+    if(bps > BPS || bps < BPS - BPS / 20)
+    {
+      failed = 1;
+      printf("FAIL lanes: %lu cycles a bit is %lu bps\n",
+             (unsigned long)bit, (unsigned long)bps);
+    }
+  }
+
+  // The same words down a chain, the far end first
+  start(GPIO_PIN_C5);
+  for(uint8_t k = 0; k < DEVICES; k++)
+  {
+    SOFTSPI_chain_set(5, k, words[k]);
+  }
+  SOFTSPI_chain_flush(5, 0);
+  report("chain", SOFTSPI_SLOW_KERNEL_CYCLES);
+  want = 0;
+  for(uint8_t k = DEVICES; k > 0; k--)
+  {
+    want = (want << 16) | words[k - 1];
+  }
+  if(mosi != want || edges != one_by_one)
+  {
+    failed = 1;
+    printf("FAIL chain: %lu edges, MOSI 0x%016llx\n", (unsigned long)edges,
+           (unsigned long long)mosi);
+  }
+  host_hook = NULL;
+
+  printf("softspi lanes: %s\n", failed ? "FAILED" : "passed");
+  return failed;
+}
@@ -0,0 +1,248 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file softspi_test.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Runs softspi.c on the PC with MISO looped to MOSI, then with a
+///         device on its own MISO.
+///
+///  softspi_test_config.h sets up interfaces of 12, 4, 16 and 24 bits,
+///  and two _SLOW ones.  Each word must come back whole, after either
+///  init, and SS must be high again afterwards.  The _SLOW ones must
+///  spend as many of their waits with SCLK active as idle.
+///
+///  The loop reads back whatever edge MISO is sampled on, so the _SLOW
+///  ones, one of each clock phase, then talk to device(), which runs on
+///  every delay.  It changes MISO only on the edge opposite the one the
+///  master samples on, and samples MOSI on that one, so a master reading
+///  on the wrong edge gets the wrong bit.  Both words must get across.
+///  The kernels without delays never reach the hook, so only the _SLOW
+///  ones can be checked this way.  make host-test runs it.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include "config.h"
+#include "host_avr.h"
+#include "gpio.h"
+#include "softspi.h"
+
+static const struct
+{
+  uint8_t   ss;
+  uint8_t   bits;
+} rows[] =
+  {
+    { GPIO_PIN_C5, 12 }, { GPIO_PIN_C4, 4 }, { GPIO_PIN_C3, 16 },
+    { GPIO_PIN_C2, 24 }, { GPIO_PIN_C1, 8 }, { GPIO_PIN_C0, 8 }
+  };
+
+// MISO for the device, away from MOSI
+#define DEVICE_MISO   GPIO_PIN_B4
+
+static int failed = 0;
+static uint8_t waits[2];        // delays seen with SCLK low, high
+
+// The device on the _SLOW interfaces
+static struct
+{
+  uint8_t   ss;
+  uint8_t   bits;
+  uint8_t   cpol;
+  uint8_t   cpha;
+  uint8_t   lsb;
+  uint8_t   selected;
+  uint8_t   clk_was;
+  uint8_t   sampled;            // MOSI bits in so far
+  uint8_t   driven;             // MISO bits out so far
+  uint32_t  in;                 // word from MOSI
+  uint32_t  out;                // word to answer with
+} dev;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Counts the delay calls by the SCLK level during them.
+//////////////////////////////////////////////////////////////////////////////
+static void count_wait(void)
+{
+  waits[HOST_LEVEL(HOST_PORT(SOFTSPI_CLK), SOFTSPI_CLK)]++;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Checks a _SLOW interface waits half of each bit with the
+///   clock idle and half with it active, then once more for SS hold.
+/// @param[in] idx   Interface
+/// @param[in] idle  SCLK level at idle, its CPOL
+//////////////////////////////////////////////////////////////////////////////
+static void halves(uint8_t idx, uint8_t idle)
+{
+  waits[0] = 0;
+  waits[1] = 0;
+  host_hook = count_wait;
+  SOFTSPI_write(idx, 0x5a);
+  host_hook = NULL;
+  if(waits[!idle] != rows[idx].bits || waits[idle] != rows[idx].bits + 1)
+  {
+    failed = 1;
+    printf("FAIL %u: %u waits with SCLK idle, %u active\n", idx,
+           waits[idle], waits[!idle]);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Puts the device's next bit on MISO, high once it has
+///   run out.
+//////////////////////////////////////////////////////////////////////////////
+static void device_drive(void)
+{
+  uint8_t k = dev.driven++;
+  uint8_t level = 1;
+  if(k < dev.bits)
+  {
+    level = (dev.out >> (dev.lsb ? k : dev.bits - 1 - k)) & 1;
+  }
+  HOST_PORT(DEVICE_MISO) = (HOST_PORT(DEVICE_MISO)
+                            & ~GPIO_PIN_MASK(DEVICE_MISO))
+    | (level ? GPIO_PIN_MASK(DEVICE_MISO) : 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC A device in dev's mode, seen on every delay.  CPHA 0
+///   puts its first bit out when selected, samples on the leading edge
+///   and shifts on the trailing one.  CPHA 1 shifts on the leading edge
+///   and samples on the trailing one.
+//////////////////////////////////////////////////////////////////////////////
+static void device(void)
+{
+  uint8_t clk = HOST_LEVEL(HOST_PORT(SOFTSPI_CLK), SOFTSPI_CLK);
+
+  if(HOST_LEVEL(HOST_PORT(dev.ss), dev.ss))
+  {
+    dev.selected = 0;
+  }
+  else
+  {
+    if(!dev.selected)
+    {
+      dev.selected = 1;
+      dev.clk_was = dev.cpol;
+      if(!dev.cpha)
+      {
+        device_drive();
+      }
+    }
+    // The kernel may have made the leading edge before this delay
+    if(clk != dev.clk_was)
+    {
+      uint8_t leading = (clk != dev.cpol);
+      if(leading != (dev.cpha != 0))
+      {
+        uint8_t bit = HOST_LEVEL(HOST_PORT(SOFTSPI_MOSI), SOFTSPI_MOSI);
+        if(dev.lsb)
+        {
+          dev.in |= (uint32_t)bit << dev.sampled;
+        }
+        else
+        {
+          dev.in = (dev.in << 1) | bit;
+        }
+        dev.sampled++;
+      }
+      else
+      {
+        device_drive();
+      }
+    }
+  }
+  dev.clk_was = clk;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Swaps words with the device on a _SLOW interface.
+/// @param[in] idx   Interface
+/// @param[in] cpol  Its mode's SCLK idle level
+/// @param[in] cpha  Its mode's clock phase
+/// @param[in] lsb   Nonzero if it sends LSB first
+//////////////////////////////////////////////////////////////////////////////
+static void device_words(uint8_t idx, uint8_t cpol, uint8_t cpha,
+                         uint8_t lsb)
+{
+  static const uint8_t sent[] = { 0xa5, 0x01, 0x80, 0x3c };
+  static const uint8_t reply[] = { 0x5b, 0x80, 0x01, 0xe7 };
+
+  dev.ss = rows[idx].ss;
+  dev.bits = rows[idx].bits;
+  dev.cpol = cpol;
+  dev.cpha = cpha;
+  dev.lsb = lsb;
+  host_hook = device;
+  for(uint8_t i = 0; i < sizeof(sent); i++)
+  {
+    // SS goes up after the last delay, where the hook can't see it
+    dev.selected = 0;
+    dev.sampled = 0;
+    dev.driven = 0;
+    dev.in = 0;
+    dev.out = reply[i];
+    uint32_t got = SOFTSPI_write(idx, sent[i]);
+    if(got != reply[i] || dev.in != sent[i] || dev.sampled != dev.bits)
+    {
+      failed = 1;
+      printf("FAIL device CPHA %u: sent 0x%02x got 0x%02lx, it got 0x%02lx "
+             "in %u bits\n", cpha, sent[i], (unsigned long)got,
+             (unsigned long)dev.in, dev.sampled);
+    }
+  }
+  host_hook = NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Sends a few words on every interface.
+//////////////////////////////////////////////////////////////////////////////
+static void words(const char *init)
+{
+  static const uint32_t sent[] = { 0xa5c3e1, 0x5a3c1e, 0xffffff, 0x000001 };
+
+  for(uint8_t idx = 0; idx < sizeof(rows) / sizeof(rows[0]); idx++)
+  {
+    uint32_t mask = (1UL << rows[idx].bits) - 1;
+    for(uint8_t i = 0; i < sizeof(sent) / sizeof(sent[0]); i++)
+    {
+      uint32_t got = SOFTSPI_write(idx, sent[i]);
+      if(got != (sent[i] & mask)
+         || !HOST_LEVEL(HOST_PORT(rows[idx].ss), rows[idx].ss)
+         || SOFTSPI_get_backend(idx) != SOFTSPI_BACKEND_SOFT)
+      {
+        failed = 1;
+        printf("FAIL %s: %u bits sent 0x%06lx got 0x%06lx backend %d\n",
+               init, rows[idx].bits, (unsigned long)(sent[i] & mask),
+               (unsigned long)got, SOFTSPI_get_backend(idx));
+      }
+    }
+  }
+}
+
+int main(void)
+{
+  host_reset();
+  for(uint8_t idx = 0; idx < sizeof(rows) / sizeof(rows[0]); idx++)
+  {
+    GPIO_write_pin(rows[idx].ss, 1);
+    GPIO_pin_mode(rows[idx].ss, GPIO_PIN_MODE_OUTPUT);
+  }
+  SOFTSPI_init(SOFTSPI_CLK, SOFTSPI_MOSI, SOFTSPI_MISO);
+  words("SOFTSPI_init");
+
+  host_reset();
+  SOFTSPI_init2();
+  words("SOFTSPI_init2");
+  halves(4, 1);
+  halves(5, 0);
+
+  SOFTSPI_init(SOFTSPI_CLK, SOFTSPI_MOSI, DEVICE_MISO);
+  device_words(4, 1, 0, 0);     // mode 2, MSB first
+  device_words(5, 0, 1, 1);     // mode 1, LSB first
+
+  printf("softspi: %s\n", failed ? "FAILED" : "passed");
+  return failed;
+}
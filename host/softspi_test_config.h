@@ -0,0 +1,27 @@
+//////////////////////////////////////////////////////////////////////////////
+///  @file softspi_test_config.h
+///  @brief config.h for host/softspi_test.c, forced in with -include.
+///
+///  MISO is MOSI, so every word comes back as sent, until the test moves
+///  MISO to the device it models with SOFTSPI_init.  The first two
+///  widths are not whole bytes, which only the bit-bang kernels can do.
+///  The last two are _SLOW at 100 kHz, one of each clock phase.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "config.h"
+
+#undef SOFTSPI_MISO
+#define SOFTSPI_MISO        GPIO_PIN_B3
+
+#undef SOFTSPI_INTERFACES
+#define SOFTSPI_INTERFACES   \
+  SOFTSPI_INTERFACE(    0,    GPIO_PIN_C5, SPI_MODE_2_MSB_FIRST, 12,   SOFTSPI_BACKEND_AUTO),  \
+  SOFTSPI_INTERFACE(    0,    GPIO_PIN_C4, SPI_MODE_1_LSB_FIRST,  4,   SOFTSPI_BACKEND_AUTO),  \
+  SOFTSPI_INTERFACE(    0,    GPIO_PIN_C3, SPI_MODE_2_MSB_FIRST, 16,   SOFTSPI_BACKEND_AUTO),  \
+  SOFTSPI_INTERFACE(    0,    GPIO_PIN_C2, SPI_MODE_1_LSB_FIRST, 24,   SOFTSPI_BACKEND_SOFT),  \
+  SOFTSPI_INTERFACE(100000,   GPIO_PIN_C1, SPI_MODE_2_MSB_FIRST_SLOW, 8, SOFTSPI_BACKEND_AUTO), \
+  SOFTSPI_INTERFACE(100000,   GPIO_PIN_C0, SPI_MODE_1_LSB_FIRST_SLOW, 8, SOFTSPI_BACKEND_AUTO)
+
+#define SOFTSPI_ENABLE_MODE_1_LSB_FIRST    1
+#define SOFTSPI_ENABLE_MODE_2_MSB_FIRST_SLOW    1
+#define SOFTSPI_ENABLE_MODE_1_LSB_FIRST_SLOW    1
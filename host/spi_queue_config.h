@@ -0,0 +1,21 @@
+//////////////////////////////////////////////////////////////////////////////
+///  @file spi_queue_config.h
+///  @brief config.h for host/spi_queue_test.c, forced in with -include.
+///
+///  Interface 0 sits on the SPI pins and goes to the hardware SPI.
+///  Interface 1 shares the pins but is bit-banged, _SLOW at 100 kHz.
+///  MISO is the SPI MISO pin, where the test puts the device's answer.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "config.h"
+
+#undef SOFTSPI_MISO
+#define SOFTSPI_MISO        GPIO_PIN_B4
+
+#undef SOFTSPI_INTERFACES
+#define SOFTSPI_INTERFACES   \
+  SOFTSPI_INTERFACE(     0,   GPIO_PIN_C0, SPI_MODE_0_MSB_FIRST,      8, SOFTSPI_BACKEND_AUTO), \
+  SOFTSPI_INTERFACE(100000,   GPIO_PIN_C1, SPI_MODE_0_MSB_FIRST_SLOW, 8, SOFTSPI_BACKEND_SOFT)
+
+#define SOFTSPI_ENABLE_MODE_0_MSB_FIRST         1
+#define SOFTSPI_ENABLE_MODE_0_MSB_FIRST_SLOW    1
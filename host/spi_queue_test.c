@@ -0,0 +1,316 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file spi_queue_test.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Runs spi_queue.c on the PC with one hardware SPI and one
+///         bit-banged interface.
+///
+///  Built with spi_queue_config.h but not HOST_IO_HOOK, which softspi.c's
+///  tables can't take, so sample() runs on every delay:  the _SLOW kernel
+///  between edges and drain() while the program waits.  It stands in for
+///  the SPI peripheral and the device:  it takes the byte out of SPDR a
+///  byte time after SPIE goes up, answers with its complement and calls
+///  SPI_STC_vect.  It clocks the bit-banged bytes in off SCLK and MOSI,
+///  answering on MISO the same way, and takes the systick interrupt when
+///  it is due.  Every byte goes in one log with the SS that was low.
+///
+///  Queues a mix of transactions on both, then fills the ring with
+///  interrupts off, then times a long bit-banged one.  Checks the bytes
+///  and their order on the bus, what was read, which interrupt ran each
+///  callback and in what order, and the statistics.  make host-test runs
+///  it.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <avr/interrupt.h>
+#include "config.h"
+#include "host_avr.h"
+#include "gpio.h"
+#include "systick.h"
+#include "softspi.h"
+#include "spi_queue.h"
+
+// Timer 0 overflows every 256 clocks at CLK_DIV_64
+#define TICK_CYCLES     (256UL * 64)
+// A hardware SPI byte at F_CPU / 2
+#define SPI_BYTE_CYCLES 16
+#define HOST_SPCR       host_regs[0x2d]
+#define HOST_SPDR       host_regs[0x2f]
+void TIMER0_OVF_vect(void);
+void SPI_STC_vect(void);
+
+// What in_isr holds
+#define IN_SYSTICK      1
+#define IN_SPI          2
+
+static const uint8_t ss_pins[2] = { GPIO_PIN_C0, GPIO_PIN_C1 };
+static int failed = 0;
+static uint8_t in_isr = 0;
+static uint64_t next_tick = TICK_CYCLES;
+static uint8_t spi_busy = 0;
+static uint64_t spi_done;
+
+// The bus
+static int8_t log_ss[64];
+static uint8_t log_byte[64];
+static uint8_t logged = 0;
+static uint8_t clk_was = 0;
+static uint8_t bits = 0;
+static uint8_t shift;
+
+// The callbacks
+static uint8_t order[8];
+static uint8_t context[8];
+static uint8_t called = 0;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC The interface whose SS is low, -1 for none or both.
+//////////////////////////////////////////////////////////////////////////////
+static int8_t selected(void)
+{
+  int8_t rtn = -1;
+  for(uint8_t i = 0; i < 2; i++)
+  {
+    if(!HOST_LEVEL(HOST_PORT(ss_pins[i]), ss_pins[i]))
+    {
+      rtn = (rtn == -1) ? (int8_t)i : -2;
+    }
+  }
+  return (rtn < 0) ? -1 : rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Logs a byte on the bus.
+//////////////////////////////////////////////////////////////////////////////
+static void add_log(uint8_t b)
+{
+  if(logged < sizeof(log_byte))
+  {
+    log_ss[logged] = selected();
+    log_byte[logged] = b;
+    logged++;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Takes an interrupt, between accesses as the part would.
+/// @param[in] which  IN_SYSTICK or IN_SPI
+/// @param[in] isr    Vector
+//////////////////////////////////////////////////////////////////////////////
+static void interrupt(uint8_t which, void (*isr)(void))
+{
+  in_isr = which;
+  HOST_SREG &= ~0x80;
+  isr();
+  HOST_SREG |= 0x80;
+  in_isr = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC The SPI peripheral, the device and the systick timer,
+///   brought up to host_cycles.
+//////////////////////////////////////////////////////////////////////////////
+static void sample(void)
+{
+  uint8_t mosi = HOST_LEVEL(HOST_PORT(SOFTSPI_MOSI), SOFTSPI_MOSI);
+  uint8_t clk = HOST_LEVEL(HOST_PORT(SOFTSPI_CLK), SOFTSPI_CLK);
+
+  // Bit-banged:  the device answers each bit with its complement, on
+  // PORTB since PINB reads it back in these builds
+  HOST_PORT(SOFTSPI_MISO) = (HOST_PORT(SOFTSPI_MISO)
+                             & ~GPIO_PIN_MASK(SOFTSPI_MISO))
+    | (mosi ? 0 : GPIO_PIN_MASK(SOFTSPI_MISO));
+  if(!(HOST_SPCR & (1 << SPE)) && clk && !clk_was)
+  {
+    shift = (shift << 1) | mosi;
+    if(++bits == 8)
+    {
+      add_log(shift);
+      bits = 0;
+    }
+  }
+  clk_was = clk;
+
+  // Hardware:  a byte time after SPIE goes up, swap SPDR for the answer
+  if((HOST_SPCR & (1 << SPIE)) && (HOST_SPCR & (1 << SPE)))
+  {
+    if(!spi_busy)
+    {
+      spi_busy = 1;
+      spi_done = host_cycles + SPI_BYTE_CYCLES;
+    }
+    else if(!in_isr && (HOST_SREG & 0x80) && host_cycles >= spi_done)
+    {
+      add_log(HOST_SPDR);
+      HOST_SPDR = ~HOST_SPDR;
+      spi_busy = 0;
+      interrupt(IN_SPI, SPI_STC_vect);
+    }
+  }
+
+  if(!in_isr && (HOST_SREG & 0x80) && host_cycles >= next_tick)
+  {
+    next_tick += TICK_CYCLES;
+    interrupt(IN_SYSTICK, TIMER0_OVF_vect);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Callback:  notes the order and the interrupt it ran in.
+//////////////////////////////////////////////////////////////////////////////
+static void done(void *arg)
+{
+  if(called < sizeof(order))
+  {
+    order[called] = (uint8_t)(uintptr_t)arg;
+    context[called] = in_isr;
+    called++;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @brief STATIC Lets time pass until the queue is empty.
+//////////////////////////////////////////////////////////////////////////////
+static void drain(void)
+{
+  uint64_t give_up = host_cycles + 1000 * TICK_CYCLES;
+  while(SPI_QUEUE_depth() != 0 && host_cycles < give_up)
+  {
+    host_delay_cycles(64);
+  }
+}
+
+int main(void)
+{
+  static const uint8_t tx_a[] = { 0x12, 0x34, 0x56 };
+  static const uint8_t tx_b[] = { 0x81, 0x42, 0x24, 0x18, 0xff, 0x00 };
+  static const uint8_t tx_c[] = { 0xa5 };
+  static uint8_t rx_a[3], rx_b[6], rx_d[2];
+  const spi_queue_desc_t mixed[] =
+    {
+      { 0, tx_a, rx_a, 3, done, (void *)1 },
+      { 1, tx_b, rx_b, 6, done, (void *)2 },
+      { 0, tx_c, NULL, 1, done, (void *)3 },
+      { 1, NULL, rx_d, 2, NULL, NULL },
+      { 1, tx_c, NULL, 1, done, (void *)5 },
+    };
+  const uint8_t count = sizeof(mixed) / sizeof(mixed[0]);
+  spi_queue_stats_t st;
+
+  host_reset();
+  host_hook = sample;
+  SYSTICK_init(CLK_DIV_64);
+  SOFTSPI_init2();
+  sei();
+  if(SPI_QUEUE_init() < 0 || SOFTSPI_get_backend(0) != SOFTSPI_BACKEND_SPI
+     || SOFTSPI_get_backend(1) != SOFTSPI_BACKEND_SOFT)
+  {
+    failed = 1;
+    printf("FAIL init:  backends %d and %d\n", SOFTSPI_get_backend(0),
+           SOFTSPI_get_backend(1));
+  }
+
+  // A mix of both, queued back to back
+  for(uint8_t i = 0; i < count; i++)
+  {
+    if(SPI_QUEUE_enqueue(&mixed[i]) < 0)
+    {
+      failed = 1;
+      printf("FAIL enqueue %u\n", i);
+    }
+  }
+  drain();
+  uint8_t n = 0;
+  uint8_t calls = 0;
+  for(uint8_t i = 0; i < count; i++)
+  {
+    const spi_queue_desc_t *d = &mixed[i];
+    for(uint8_t b = 0; b < d->len; b++, n++)
+    {
+      uint8_t out = (d->tx != NULL) ? d->tx[b] : 0;
+      if(n >= logged || log_ss[n] != d->idx || log_byte[n] != out
+         || (d->rx != NULL && d->rx[b] != (uint8_t)~out))
+      {
+        failed = 1;
+        printf("FAIL transaction %u byte %u:  sent %02x on SS %d, "
+               "read %02x\n", i, b, log_byte[n], log_ss[n],
+               (d->rx != NULL) ? d->rx[b] : 0);
+      }
+    }
+    if(d->callback != NULL)
+    {
+      // Hardware SPI finishes in its own interrupt, the rest in systick
+      uint8_t isr = (d->idx == 0) ? IN_SPI : IN_SYSTICK;
+      if(calls >= called || order[calls] != (uintptr_t)d->arg
+         || context[calls] != isr)
+      {
+        failed = 1;
+        printf("FAIL callback %u:  got %u from %u\n", i, order[calls],
+               context[calls]);
+      }
+      calls++;
+    }
+  }
+  SPI_QUEUE_get_stats(&st);
+  if(logged != n || called != calls || st.bytes != n
+     || st.transfers != count || st.rejected != 0 || st.depth != 0
+     || !HOST_LEVEL(HOST_PORT(GPIO_PIN_C0), GPIO_PIN_C0)
+     || !HOST_LEVEL(HOST_PORT(GPIO_PIN_C1), GPIO_PIN_C1))
+  {
+    failed = 1;
+    printf("FAIL mixed:  %u bytes on the bus, %u callbacks, stats %lu "
+           "bytes %u transfers %u rejected %u deep\n", logged, called,
+           (unsigned long)st.bytes, st.transfers, st.rejected, st.depth);
+  }
+  printf("spi_queue: %u transactions, %u bytes, %u callbacks in order\n",
+         count, n, calls);
+
+  // With interrupts off nothing moves:  the ring takes SIZE - 1
+  SPI_QUEUE_clear_stats();
+  const spi_queue_desc_t one = { 1, tx_c, NULL, 1, NULL, NULL };
+  uint8_t took = 0;
+  cli();
+  for(uint8_t i = 0; i < SPI_QUEUE_SIZE; i++)
+  {
+    took += (SPI_QUEUE_enqueue(&one) == 0);
+  }
+  sei();
+  drain();
+  SPI_QUEUE_get_stats(&st);
+  if(took != SPI_QUEUE_SIZE - 1 || st.rejected != 1
+     || st.max_depth != SPI_QUEUE_SIZE - 1
+     || st.transfers != SPI_QUEUE_SIZE - 1)
+  {
+    failed = 1;
+    printf("FAIL full:  took %u, %u rejected, %u deep, %u done\n", took,
+           st.rejected, st.max_depth, st.transfers);
+  }
+
+  // The bit-banged rate is set by the tick, not the interface
+  static uint8_t big[40];
+  const spi_queue_desc_t slow = { 1, big, NULL, sizeof(big), NULL, NULL };
+  SPI_QUEUE_clear_stats();
+  SPI_QUEUE_enqueue(&slow);
+  drain();
+  SPI_QUEUE_get_stats(&st);
+  printf("spi_queue: bit-banged %lu bytes in %lu ticks, %.1f a tick, "
+         "%.0f bytes/s\n", (unsigned long)st.bytes, (unsigned long)st.ticks,
+         (double)st.bytes / st.ticks,
+         (double)st.bytes * F_CPU / ((double)st.ticks * TICK_CYCLES));
+  if(st.bytes != sizeof(big)
+     || st.ticks < sizeof(big) / SPI_QUEUE_SOFT_BYTES
+     || st.ticks > sizeof(big) / SPI_QUEUE_SOFT_BYTES + 1)
+  {
+    failed = 1;
+    printf("FAIL rate\n");
+  }
+  host_hook = NULL;
+
+  printf("spi_queue: %s\n", failed ? "FAILED" : "passed");
+  return failed;
+}
@@ -0,0 +1,15 @@
+//////////////////////////////////////////////////////////////////////////////
+///  @file host/stdio.h
+///  @brief Host build:  the C library's stdio plus enough of avr-libc's
+///         stream setup for the drivers' static FILEs to build.  They
+///         can't be written to on the PC.
+//////////////////////////////////////////////////////////////////////////////
+
+#include_next <stdio.h>
+
+#ifndef _FDEV_SETUP_WRITE
+#define _FDEV_SETUP_READ            1
+#define _FDEV_SETUP_WRITE           2
+#define _FDEV_SETUP_RW              3
+#define FDEV_SETUP_STREAM(p, g, f)  { 0 }
+#endif
@@ -0,0 +1,25 @@
+//////////////////////////////////////////////////////////////////////////////
+///  @file host/util/delay.h
+///  @brief Host build:  delays advance the simulated clock, see host_avr.h.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+
+#ifndef F_CPU
+#error "F_CPU must be defined before util/delay.h"
+#endif
+
+#include <util/delay_basic.h>
+
+static inline void _delay_us(double us)
+{
+  host_delay_cycles((uint32_t)(us * (F_CPU / 1000000.0) + 0.5));
+}
+
+static inline void _delay_ms(double ms)
+{
+  host_delay_cycles((uint32_t)(ms * (F_CPU / 1000.0) + 0.5));
+}
+
+#endif  // HOST_UTIL_DELAY_H
@@ -0,0 +1,24 @@
+//////////////////////////////////////////////////////////////////////////////
+///  @file host/util/delay_basic.h
+///  @brief Host build:  the loops cost what they do on the AVR, 3 and 4
+///         cycles a count, 0 counting as 256 and 65536.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef HOST_UTIL_DELAY_BASIC_H
+#define HOST_UTIL_DELAY_BASIC_H
+
+#include <stdint.h>
+
+void host_delay_cycles(uint32_t cycles);
+
+static inline void _delay_loop_1(uint8_t count)
+{
+  host_delay_cycles(3 * (count ? count : 256UL));
+}
+
+static inline void _delay_loop_2(uint16_t count)
+{
+  host_delay_cycles(4 * (count ? count : 65536UL));
+}
+
+#endif  // HOST_UTIL_DELAY_BASIC_H
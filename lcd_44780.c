@@ -8,10 +8,22 @@
 #include "config.h"
 #include "device_config.h"
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <util/delay.h>
 #include <stdint.h>
+#include <stddef.h>   // for NULL
 //#include "config.h"
 #include "gpio.h"
+#ifdef LCD_44780_PCF8574
+#include "twi.h"
+#if !TWI_AVAILABLE
+#error LCD_44780_PCF8574 needs TWI:  define TWI_SOFT_SDA and TWI_SOFT_SCL
+#endif
+#endif
+#ifdef LCD_44780_QUEUE_SIZE
+#include "systick.h"
+#endif
 
 #include "lcd_44780.h"
 
@@ -23,6 +35,161 @@
 
 #define DELAY_1     10
 
+// Datasheet execution times, used when there is no RW pin to read the
+// busy flag.  Clear and home are the slow ones.
+#define EXEC_US         37
+#define EXEC_DATA_US    (EXEC_US + 4)     // plus tADD for the counter
+#define EXEC_SLOW_US    1520
+
+#define CELLS       (LCD_44780_COLUMNS * LCD_44780_ROWS)
+#define NO_CELL     0xff
+
+// CGRAM glyph cache.  Framebuffer cells holding codes 0x00-0x0f show
+// slot code & 7;  refs counts them so a slot in use is never evicted.
+#define GLYPH_SLOTS     8
+typedef struct glyph_slot
+{
+  const uint8_t *glyph;     // bitmap in flash, NULL if the slot is empty
+  uint8_t refs;             // framebuffer cells showing it
+  uint8_t rank;             // 0 asked for last, GLYPH_SLOTS - 1 longest ago
+} glyph_slot_t;
+static lcd_44780_glyph_stats_t glyph_stats;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @struct panel
+/// @brief What the driver knows about one display.
+//////////////////////////////////////////////////////////////////////////////
+typedef struct panel
+{
+  // Framebuffer:  what the display shows, or will after LCD_44780_flush.
+  // A dirty bit marks each cell written since it was last sent.
+  char fb[CELLS];
+  uint8_t dirty[(CELLS + 7) / 8];
+  uint8_t fb_cursor;        // next cell LCD_44780_fb_putc writes
+  uint8_t fb_row;           // row of fb_cursor, kept when it clips
+  uint8_t fb_end;           // first cell past fb_row
+  // Cell the controller's address counter points at, NO_CELL when it is
+  // off the visible cells, in CGRAM, or moving backwards.
+  uint8_t lcd_cell;
+  uint8_t lcd_left;         // cells before the counter leaves the row
+  uint8_t increment;        // entry mode moves right
+  glyph_slot_t slots[GLYPH_SLOTS];
+} panel_t;
+
+// Several panels share RS, RW and the data lines and each has its own
+// EN.  pn is the one LCD_44780_select picked;  en_port and en_mask the
+// EN that bus writes strobe, which the queue sets per entry.
+#ifdef LCD_44780_PANELS
+#ifdef LCD_44780_PCF8574
+#error LCD_44780_PANELS needs the parallel bus
+#endif
+static const uint8_t panel_en[] = { LCD_44780_PANELS };
+#define PANELS          sizeof(panel_en)
+_Static_assert(PANELS <= 16, "The LCD queue tags entries with 4 bits of panel");
+static panel_t panels[PANELS];
+static panel_t *pn = &panels[0];
+static uint8_t cur = 0;
+static volatile uint8_t *en_port;
+static uint8_t en_mask;
+#define EN_PORT         en_port
+#define EN_MASK         en_mask
+#else
+#define PANELS          1
+static panel_t panels[PANELS];
+#define pn              (&panels[0])
+#define cur             0
+#endif
+
+#ifdef LCD_44780_PANELS
+//////////////////////////////////////////////////////////////////////////////
+/// @fn use_panel
+/// @brief STATIC Points the bus writes at a panel's EN.
+/// @param[in] idx  Panel
+//////////////////////////////////////////////////////////////////////////////
+static void use_panel(uint8_t idx)
+{
+  en_port = GPIO_OUTPUT_REGISTER(panel_en[idx]);
+  en_mask = GPIO_PIN_MASK(panel_en[idx]);
+}
+#endif
+
+// Stream escape parser, see LCD_44780_stream
+#define ESC             0x1b
+#define ESC_NONE        0
+#define ESC_START       1       // had ESC
+#define ESC_ROW         2       // had ESC Y, row next
+#define ESC_COL         3       // had ESC Y row, column next
+static uint8_t esc = ESC_NONE;
+static uint8_t esc_row;
+
+static int stream_put(char ch, FILE *f);
+static FILE stream = FDEV_SETUP_STREAM(stream_put, NULL, _FDEV_SETUP_WRITE);
+
+#ifdef LCD_44780_EN2
+// A 40x4 is two controllers sharing everything but E.  Data and DDRAM
+// commands go to the one holding the cursor's row, the rest to both.
+static uint8_t ctrl_sel = 1;             // controller of the cursor's row
+static uint8_t send_sel = 3;             // controllers the next byte is for
+static volatile uint8_t en_sel = 3;      // controllers the bus strobes
+#define Q_TAG           send_sel
+#else
+#define Q_TAG           cur
+#endif
+
+static volatile uint32_t bus_bytes = 0;  // commands and data sent
+static uint32_t issued = 0;        // commands and data asked for
+
+#ifdef LCD_44780_QUEUE_SIZE
+#if (LCD_44780_QUEUE_SIZE & (LCD_44780_QUEUE_SIZE - 1)) != 0
+#error LCD_44780_QUEUE_SIZE must be a power of two
+#endif
+#define QUEUE_MASK  (LCD_44780_QUEUE_SIZE - 1)
+
+// Queue entries:  the byte in the low eight bits, what to do with it above.
+#define Q_DATA      0x0100      // RS high
+#define Q_NIBBLE    0x0200      // one bus write of the reset sequence
+#define Q_PANEL_SHIFT   12      // panel, or EN2 controllers, on top
+
+static uint16_t queue[LCD_44780_QUEUE_SIZE];
+static volatile uint8_t q_head = 0;      // next free entry
+static volatile uint8_t q_tail = 0;      // next entry to send
+static volatile uint16_t hold = 0;       // ticks to wait before the next
+static int queue_timer = -1;             // systick timer, -1 if blocking
+
+// Ticks to hold for after each kind of entry, from the systick rate.
+static uint16_t data_ticks;
+static uint16_t cmd_ticks;
+static uint16_t slow_ticks;
+static uint16_t reset_ticks;
+
+#if LCD_44780_ROWS <= 2 && !defined(LCD_44780_SPLIT)
+// The marquee scrolls a row with display shifts sent from step() when
+// the queue is idle.  Text up to a DDRAM line long is written once; the
+// line is circular, so after that a step is just the shift.  Longer text
+// refills the column that has just scrolled off, 40 steps ahead of it
+// coming round again.
+#define MARQUEE
+#define MQ_LINE         40      // DDRAM columns in a line
+#define MQ_SHIFT        0       // next op:  shift left
+#define MQ_ADDR         1       //   address the column that went off
+#define MQ_DATA         2       //   refill it
+static const char *mq_text = NULL;       // NULL while stopped
+static uint8_t mq_flash;                 // mq_text is in PROGMEM
+static uint16_t mq_len;                  // characters in mq_text
+static uint16_t mq_period;               // text plus a screen of blanks
+static uint16_t mq_next;                 // text index of the next refill
+static uint8_t mq_col;                   // column the next refill goes to
+static uint8_t mq_addr;                  // DDRAM address of the row
+static uint8_t mq_row;
+static uint8_t mq_panel;
+static uint16_t mq_tag;                  // panel bits for the entries
+static uint8_t mq_op;
+static volatile uint8_t mq_due = 0;      // set by the timer, a step owed
+static volatile uint32_t mq_bytes = 0;   // sent by the marquee
+static int mq_timer = -1;
+#endif
+#endif
+
 //static uint8_t columns = 8;
 //static uint8_t rows = 1;
 
@@ -41,9 +208,121 @@
 
 
 
-static void RS_set(int rs)
+//////////////////////////////////////////////////////////////////////////////
+/// @array rows
+/// @brief Geometry:  DDRAM address and first framebuffer cell of each row.
+/// @remark Bit 7 of the address picks the second controller of a 40x4.
+///   One line panels wired as two half lines set LCD_44780_SPLIT, the
+///   column that starts at 0x40.
+//////////////////////////////////////////////////////////////////////////////
+typedef struct row
+{
+  uint8_t addr;
+  uint8_t cell;
+} row_t;
+
+#define SECOND          0x80    // row is on LCD_44780_EN2's controller
+#define C               LCD_44780_COLUMNS
+#if LCD_44780_ROWS == 4 && LCD_44780_COLUMNS == 40
+#ifndef LCD_44780_EN2
+#error A 40x4 is two controllers:  define LCD_44780_EN2
+#endif
+static const row_t rows[4] PROGMEM =
+  { { 0x00, 0 }, { 0x40, C }, { SECOND | 0x00, 2 * C }, { SECOND | 0x40, 3 * C } };
+#elif LCD_44780_ROWS == 4
+// 16x4, 20x4:  rows 2 and 3 carry on from the ends of rows 0 and 1
+static const row_t rows[4] PROGMEM =
+  { { 0x00, 0 }, { 0x40, C }, { C, 2 * C }, { 0x40 + C, 3 * C } };
+#elif LCD_44780_ROWS == 2
+static const row_t rows[2] PROGMEM = { { 0x00, 0 }, { 0x40, C } };
+#elif LCD_44780_ROWS == 1
+static const row_t rows[1] PROGMEM = { { 0x00, 0 } };
+#else
+#error LCD_44780_ROWS must be 1, 2 or 4
+#endif
+#undef C
+
+#ifdef LCD_44780_SPLIT
+#if LCD_44780_ROWS != 1
+#error LCD_44780_SPLIT is for one line panels
+#endif
+#define SPLIT           LCD_44780_SPLIT
+#else
+#define SPLIT           LCD_44780_COLUMNS
+#endif
+
+#if defined(LCD_44780_EN2) && (defined(LCD_44780_PANELS) || defined(LCD_44780_PCF8574))
+#error LCD_44780_EN2 needs the single panel parallel bus
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn locate
+/// @brief STATIC DDRAM address of a column and row.
+/// @param[in]  col   Column, in range
+/// @param[in]  row   Row, in range
+/// @param[out] left  Cells from there to the end of the contiguous DDRAM
+/// @return Address, bit 7 set for the second controller.
+//////////////////////////////////////////////////////////////////////////////
+static uint8_t locate(uint8_t col, uint8_t row, uint8_t *left)
+{
+  uint8_t adr = pgm_read_byte(&rows[row].addr);
+  if(col < SPLIT)
+  {
+    *left = SPLIT - col;
+    adr += col;
+  }
+  else
+  {
+    *left = LCD_44780_COLUMNS - col;
+    adr += 0x40 + (col - SPLIT);
+  }
+  return adr;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn set_cell
+/// @brief STATIC Changes a framebuffer cell, keeping glyph refs counted.
+/// @param[in] cell  Cell to change
+/// @param[in] ch    New character, different from the old one
+//////////////////////////////////////////////////////////////////////////////
+static void set_cell(uint8_t cell, char ch)
 {
-  GPIO_write_pin(LCD_44780_RS, rs);
+  uint8_t old = (uint8_t)pn->fb[cell];
+  if(old < 0x10 && pn->slots[old & 0x07].refs != 0)
+  {
+    pn->slots[old & 0x07].refs--;
+  }
+  if((uint8_t)ch < 0x10)
+  {
+    pn->slots[ch & 0x07].refs++;
+  }
+  pn->fb[cell] = ch;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn track_data
+/// @brief STATIC Keeps the framebuffer in step with a data byte sent
+///        straight to the display.
+/// @param[in] data  Byte just written
+//////////////////////////////////////////////////////////////////////////////
+static void track_data(uint8_t data)
+{
+  uint8_t cell = pn->lcd_cell;
+  if(cell != NO_CELL)
+  {
+    if(pn->fb[cell] != (char)data)
+    {
+      set_cell(cell, data);
+    }
+    pn->dirty[cell >> 3] &= ~(1 << (cell & 0x07));
+    cell++;
+    // Past the last column the address runs on into hidden DDRAM.
+    if(!pn->increment || --pn->lcd_left == 0)
+    {
+      cell = NO_CELL;
+    }
+    pn->lcd_cell = cell;
+  }
 }
 
 //static void E_set(int e) // pb5
@@ -56,28 +335,604 @@ static void RS_set(int rs)
 //{
 //}
 
-static void write_nibble(uint8_t nib)
+#ifndef LCD_44780_PCF8574
+// Bus width:  defining LCD_44780_D0..D3 in device_config.h selects
+// the 8 bit interface.
+#ifdef LCD_44780_D0
+#define BUS_BITS        8
+#define D_LOW           LCD_44780_D0
+#define RESET_VALUE     0x30    // function set, 8 bit
+#else
+#define BUS_BITS        4
+#define D_LOW           LCD_44780_D4
+#define RESET_VALUE     0x03    // upper nibble of function set, 8 bit
+#endif
+
+// Data pins, D7 first.
+static const uint8_t data_pins[BUS_BITS] =
+  {
+    LCD_44780_D7, LCD_44780_D6, LCD_44780_D5, LCD_44780_D4,
+#ifdef LCD_44780_D0
+    LCD_44780_D3, LCD_44780_D2, LCD_44780_D1, LCD_44780_D0,
+#endif
+  };
+
+// The pins are enum values, so these are constant expressions:  the
+// compiler picks the bus write below and drops the other paths.
+#define PIN_PORT(pin)   ((pin) >> 3)
+#define SAME_PORT(pin)  (PIN_PORT(pin) == PIN_PORT(D_LOW))
+// Mask for pin if bit n of v is set
+#define D_BIT(v, n, pin)  (((v) & (1 << (n))) ? GPIO_PIN_MASK(pin) : 0)
+#ifdef LCD_44780_D0
+#define D_ONE_PORT      (SAME_PORT(LCD_44780_D1) && SAME_PORT(LCD_44780_D2) \
+                         && SAME_PORT(LCD_44780_D3) && SAME_PORT(LCD_44780_D4) \
+                         && SAME_PORT(LCD_44780_D5) && SAME_PORT(LCD_44780_D6) \
+                         && SAME_PORT(LCD_44780_D7))
+#define D_CONTIGUOUS    (D_ONE_PORT                                \
+                         && LCD_44780_D1 == LCD_44780_D0 + 1       \
+                         && LCD_44780_D2 == LCD_44780_D0 + 2       \
+                         && LCD_44780_D3 == LCD_44780_D0 + 3       \
+                         && LCD_44780_D4 == LCD_44780_D0 + 4       \
+                         && LCD_44780_D5 == LCD_44780_D0 + 5       \
+                         && LCD_44780_D6 == LCD_44780_D0 + 6       \
+                         && LCD_44780_D7 == LCD_44780_D0 + 7)
+#define D_PLACE(v)      (D_BIT(v, 7, LCD_44780_D7) | D_BIT(v, 6, LCD_44780_D6) \
+                         | D_BIT(v, 5, LCD_44780_D5) | D_BIT(v, 4, LCD_44780_D4) \
+                         | D_BIT(v, 3, LCD_44780_D3) | D_BIT(v, 2, LCD_44780_D2) \
+                         | D_BIT(v, 1, LCD_44780_D1) | D_BIT(v, 0, LCD_44780_D0))
+#else
+#define D_ONE_PORT      (SAME_PORT(LCD_44780_D5) && SAME_PORT(LCD_44780_D6) \
+                         && SAME_PORT(LCD_44780_D7))
+#define D_CONTIGUOUS    (D_ONE_PORT                                \
+                         && LCD_44780_D5 == LCD_44780_D4 + 1       \
+                         && LCD_44780_D6 == LCD_44780_D4 + 2       \
+                         && LCD_44780_D7 == LCD_44780_D4 + 3)
+#define D_PLACE(v)      (D_BIT(v, 3, LCD_44780_D7) | D_BIT(v, 2, LCD_44780_D6) \
+                         | D_BIT(v, 1, LCD_44780_D5) | D_BIT(v, 0, LCD_44780_D4))
+#endif
+#define D_MASK          ((uint8_t)D_PLACE(0xff))
+#define D_PORT          GPIO_OUTPUT_REGISTER(D_LOW)
+#ifndef LCD_44780_PANELS
+#define EN_PORT         GPIO_OUTPUT_REGISTER(LCD_44780_EN)
+#define EN_MASK         GPIO_PIN_MASK(LCD_44780_EN)
+#endif
+#ifdef LCD_44780_EN2
+// en_sel picks the controllers the bus strobes:  1 for EN, 2 for EN2
+#define EN2_PORT        GPIO_OUTPUT_REGISTER(LCD_44780_EN2)
+#define EN2_MASK        GPIO_PIN_MASK(LCD_44780_EN2)
+#define EN_HIGH()       do                                           \
+                        {                                            \
+                          if(en_sel & 1) *EN_PORT |= EN_MASK;        \
+                          if(en_sel & 2) *EN2_PORT |= EN2_MASK;      \
+                        } while(0)
+#define EN_LOW()        do                                           \
+                        {                                            \
+                          *EN_PORT &= ~EN_MASK;                      \
+                          *EN2_PORT &= ~EN2_MASK;                    \
+                        } while(0)
+#else
+#define EN_HIGH()       (*EN_PORT |= EN_MASK)
+#define EN_LOW()        (*EN_PORT &= ~EN_MASK)
+#endif
+#define RS_PORT         GPIO_OUTPUT_REGISTER(LCD_44780_RS)
+#define RS_MASK         GPIO_PIN_MASK(LCD_44780_RS)
+
+static void RS_set(int rs)
 {
-  GPIO_write_pin(LCD_44780_D7, nib & 0x08);
-  GPIO_write_pin(LCD_44780_D6, nib & 0x04);
-  GPIO_write_pin(LCD_44780_D5, nib & 0x02);
-  GPIO_write_pin(LCD_44780_D4, nib & 0x01);
-  
-  //nib &= 0x0f;  // Use only low four bits
-  //uint8_t tmp = PORTB;
-  //tmp &= 0xf0;  // Keep port's high bits as-is
-  //tmp |= nib;   // Merge the nibble bits
-  //PORTB = tmp;
-  _delay_us(DELAY_1);//5);
-  //E_set(1);
-  GPIO_write_pin(LCD_44780_EN, 1);
-  _delay_us( DELAY_1); //5);
-  //E_set(0);
-  GPIO_write_pin(LCD_44780_EN, 0);
-  _delay_us( DELAY_1 ); //5);
-  
+  if(rs)
+  {
+    *RS_PORT |= RS_MASK;
+  }
+  else
+  {
+    *RS_PORT &= ~RS_MASK;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn bus_mode
+/// @brief STATIC Turns the data lines around.
+/// @param[in] mode  GPIO_PIN_MODE_OUTPUT or GPIO_PIN_MODE_INPUT
+//////////////////////////////////////////////////////////////////////////////
+static void bus_mode(int mode)
+{
+  for(uint8_t i = 0; i < BUS_BITS; i++)
+  {
+    GPIO_pin_mode(data_pins[i], mode);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn write_bus
+/// @brief STATIC Puts a nibble on D7..D4, or a byte on D7..D0, and
+///   strobes EN.
+/// @param[in] v  Value in the low BUS_BITS bits
+/// @remark With the data lines on one port this is a single
+///   read-modify-write, just a shift (or a plain store for 8 lines) when
+///   they are in order.  Scattered pins fall back to GPIO_write_pin.
+//////////////////////////////////////////////////////////////////////////////
+static void write_bus(uint8_t v)
+{
+  if(D_CONTIGUOUS && D_MASK == 0xff)
+  {
+    *D_PORT = v;
+  }
+  else if(D_ONE_PORT)
+  {
+    uint8_t bits;
+    if(D_CONTIGUOUS)
+    {
+      bits = (uint8_t)(v << (D_LOW & 0x07)) & D_MASK;
+    }
+    else
+    {
+      bits = D_PLACE(v);
+    }
+    *D_PORT = (*D_PORT & (uint8_t)~D_MASK) | bits;
+  }
+  else
+  {
+    for(uint8_t i = 0; i < BUS_BITS; i++)
+    {
+      GPIO_write_pin(data_pins[i], v & (1 << (BUS_BITS - 1 - i)));
+    }
+  }
+  // Setup and hold are tens of nS, the enable pulse 450 nS and the
+  // cycle 1000 nS:  1 uS each side covers them.
+  EN_HIGH();
+  _delay_us(1);
+  EN_LOW();
+  _delay_us(1);
+}
+
+#ifdef LCD_44780_RW
+//////////////////////////////////////////////////////////////////////////////
+/// @fn read_byte
+/// @brief STATIC Reads a byte, as two nibbles on a 4 bit bus, with RW high.
+/// @param[in] rs  CMD for the busy flag and address, DAT for RAM
+//////////////////////////////////////////////////////////////////////////////
+static uint8_t read_byte(uint8_t rs)
+{
+  uint8_t rtn = 0;
+  bus_mode(GPIO_PIN_MODE_INPUT);
+  RS_set(rs);
+  GPIO_write_pin(LCD_44780_RW, RD);
+  for(uint8_t n = 0; n < 8 / BUS_BITS; n++)
+  {
+    EN_HIGH();
+    _delay_us(1);                   // tDDR, data out 360 nS after E
+    for(uint8_t i = 0; i < BUS_BITS; i++)
+    {
+      rtn = (rtn << 1) | (GPIO_read_pin(data_pins[i]) != 0);
+    }
+    EN_LOW();
+    _delay_us(1);
+  }
+  GPIO_write_pin(LCD_44780_RW, WR);
+  bus_mode(GPIO_PIN_MODE_OUTPUT);
+  return rtn;
+}
+#endif
+
+#else  // LCD_44780_PCF8574
+
+// The backpack's expander drives the LCD:  D7..D4 on P7..P4 and the
+// control lines below it.  Override these for boards wired otherwise.
+#ifndef LCD_44780_PCF8574_RS
+#define LCD_44780_PCF8574_RS    0x01
+#endif
+#ifndef LCD_44780_PCF8574_EN
+#define LCD_44780_PCF8574_EN    0x04
+#endif
+#ifndef LCD_44780_PCF8574_BL
+#define LCD_44780_PCF8574_BL    0x08    // backlight
+#endif
+#ifndef LCD_44780_PCF8574_BPS
+#define LCD_44780_PCF8574_BPS   100000
+#endif
+#if defined(LCD_44780_D0) || defined(LCD_44780_RW)
+#error The PCF8574 transport is 4 bit and write only
+#endif
+#ifdef LCD_44780_QUEUE_SIZE
+// step() would run each byte's I2C write, about 540 uS at 100 kHz, in
+// the systick interrupt.
+#error The PCF8574 transport cannot be queued
+#endif
+
+#define RESET_VALUE     0x03    // upper nibble of function set, 8 bit
+
+static uint8_t pcf_ctrl = LCD_44780_PCF8574_BL;   // RS and backlight
+static uint8_t pcf_last = 0;       // last byte the expander was sent
+
+static void RS_set(int rs)
+{
+  if(rs)
+  {
+    pcf_ctrl |= LCD_44780_PCF8574_RS;
+  }
+  else
+  {
+    pcf_ctrl &= ~LCD_44780_PCF8574_RS;
+  }
+}
+
+static void bus_mode(int mode)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn pcf_write
+/// @brief STATIC Sends nibbles to the expander in a single I2C write.
+/// @param[in] v  Byte to send, high nibble first
+/// @param[in] n  1 for the high nibble only, 2 for the whole byte
+/// @remark Each nibble is two expander bytes, EN high then EN low.  If
+///   RS changed, a byte with EN low goes first so RS settles before the
+///   rising edge.  An expander byte takes 9 SCL clocks, so the pulse and
+///   setup times are met many times over.
+//////////////////////////////////////////////////////////////////////////////
+static void pcf_write(uint8_t v, uint8_t n)
+{
+  uint8_t frame[5];
+  uint8_t len = 0;
+  if((pcf_last ^ pcf_ctrl) & LCD_44780_PCF8574_RS)
+  {
+    frame[len++] = (pcf_last & 0xf0) | pcf_ctrl;
+  }
+  for(uint8_t i = 0; i < n; i++)
+  {
+    uint8_t out = (v & 0xf0) | pcf_ctrl;
+    frame[len++] = out | LCD_44780_PCF8574_EN;
+    frame[len++] = out;
+    v <<= 4;
+  }
+  pcf_last = frame[len - 1];
+  TWI_write(LCD_44780_PCF8574, frame, len);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn write_bus
+/// @brief STATIC Puts a nibble on D7..D4 and strobes EN.
+/// @param[in] v  Nibble in the low four bits
+//////////////////////////////////////////////////////////////////////////////
+static void write_bus(uint8_t v)
+{
+  pcf_write(v << 4, 1);
 }
+#endif  // LCD_44780_PCF8574
 
+#ifdef LCD_44780_RW
+//////////////////////////////////////////////////////////////////////////////
+/// @fn busy
+/// @brief STATIC Reads the busy flag.
+/// @return Nonzero while a selected controller is busy.
+/// @remark Both halves of a 40x4 would drive the bus at once, so each is
+///   read on its own.
+//////////////////////////////////////////////////////////////////////////////
+static uint8_t busy(void)
+{
+#ifdef LCD_44780_EN2
+  uint8_t sel = en_sel;
+  uint8_t b = 0;
+  for(en_sel = 1; en_sel <= 2; en_sel <<= 1)
+  {
+    if(sel & en_sel)
+    {
+      b |= read_byte(CMD);
+    }
+  }
+  en_sel = sel;
+  return b & 0x80;
+#else
+  return read_byte(CMD) & 0x80;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn read_ready
+/// @brief STATIC Reads from the current panel once its controller is idle.
+/// @param[in] rs  CMD for the busy flag and address, DAT for RAM
+/// @return The byte read.
+/// @remark Each poll and the read run with interrupts off, so the queue
+///   can't send to the controller, or point the bus elsewhere, between
+///   them.
+//////////////////////////////////////////////////////////////////////////////
+static uint8_t read_ready(uint8_t rs)
+{
+  uint8_t rtn = 0;
+  uint8_t wait;
+  do
+  {
+    uint8_t sreg = SREG;
+    cli();
+#if defined(LCD_44780_PANELS)
+    use_panel(cur);
+#elif defined(LCD_44780_EN2)
+    en_sel = (ctrl_sel == 2) ? 2 : 1;
+#endif
+    wait = busy();
+    if(!wait)
+    {
+      rtn = read_byte(rs);
+    }
+    SREG = sreg;
+  } while(wait);
+  return rtn;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn wait_ready
+/// @brief STATIC Waits until the controller can take the next byte.
+/// @param[in] exec  EXEC_US, EXEC_DATA_US or EXEC_SLOW_US
+/// @remark With RW wired this polls the busy flag and returns as soon as
+///   it clears.  Without it, it waits the datasheet time.
+//////////////////////////////////////////////////////////////////////////////
+static void wait_ready(uint16_t exec)
+{
+#if defined(LCD_44780_PCF8574)
+  // Sending the next byte to the expander takes longer than anything
+  // but clear and home.
+  if(exec == EXEC_SLOW_US)
+  {
+    _delay_us(EXEC_SLOW_US);
+  }
+#elif defined(LCD_44780_RW)
+  while(busy())
+    ;
+#else
+  // _delay_us needs a constant
+  if(exec == EXEC_SLOW_US)
+  {
+    _delay_us(EXEC_SLOW_US);
+  }
+  else if(exec == EXEC_DATA_US)
+  {
+    _delay_us(EXEC_DATA_US);
+  }
+  else
+  {
+    _delay_us(EXEC_US);
+  }
+#endif
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn send_byte
+/// @brief STATIC Clocks a command or data byte out as two nibbles.
+/// @param[in] rs  CMD or DAT
+/// @param[in] b   Byte to send
+/// @remark Doesn't wait for the controller to finish with it.
+//////////////////////////////////////////////////////////////////////////////
+static void send_byte(uint8_t rs, uint8_t b)
+{
+  RS_set(rs);
+#if defined(LCD_44780_PCF8574)
+  pcf_write(b, 2);
+#elif defined(LCD_44780_D0)
+  write_bus(b);
+#else
+  write_bus( (b >> 4) & 0x0f );
+  write_bus( b & 0x0f );
+#endif
+  bus_bytes++;
+}
+
+#ifdef LCD_44780_QUEUE_SIZE
+#ifdef MARQUEE
+//////////////////////////////////////////////////////////////////////////////
+/// @fn mq_char
+/// @brief STATIC Character at a place in the marquee text.
+/// @param[in] i  Index, blanks past the end of the text
+//////////////////////////////////////////////////////////////////////////////
+static char mq_char(uint16_t i)
+{
+  char ch = ' ';
+  if(i < mq_len)
+  {
+    ch = mq_flash ? pgm_read_byte(&mq_text[i]) : mq_text[i];
+  }
+  return ch;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn mq_entry
+/// @brief STATIC The marquee's next bus operation as a queue entry.
+//////////////////////////////////////////////////////////////////////////////
+static uint16_t mq_entry(void)
+{
+  uint16_t e;
+  if(mq_op == MQ_SHIFT)
+  {
+    e = 0x18;                 // display shift left
+  }
+  else if(mq_op == MQ_ADDR)
+  {
+    e = 0x80 | (mq_addr + mq_col);
+  }
+  else
+  {
+    e = Q_DATA | (uint8_t)mq_char(mq_next);
+  }
+  return e | mq_tag;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn mq_sent
+/// @brief STATIC Moves the marquee on once mq_entry's operation is sent.
+//////////////////////////////////////////////////////////////////////////////
+static void mq_sent(void)
+{
+  mq_bytes++;
+  if(mq_op == MQ_SHIFT && mq_len > MQ_LINE)
+  {
+    mq_op = MQ_ADDR;
+  }
+  else if(mq_op == MQ_ADDR)
+  {
+    mq_op = MQ_DATA;
+  }
+  else
+  {
+    if(mq_op == MQ_DATA)
+    {
+      mq_col = (mq_col == MQ_LINE - 1) ? 0 : mq_col + 1;
+      mq_next = (mq_next == mq_period - 1) ? 0 : mq_next + 1;
+    }
+    mq_op = MQ_SHIFT;
+    mq_due = 0;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn mq_tick
+/// @brief STATIC Systick callback:  time for the next step.
+/// @remark A step that can't go out before the next tick is dropped, not
+///   saved up.
+//////////////////////////////////////////////////////////////////////////////
+static void mq_tick(void)
+{
+  mq_due = 1;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn ticks_for
+/// @brief STATIC Systick ticks to hold for after an operation.
+/// @param[in] us       Execution time in uS
+/// @param[in] tick_us  Length of a tick in uS
+/// @return Ticks to skip before the next entry, the one after the send
+///   counts as the first.
+//////////////////////////////////////////////////////////////////////////////
+static uint16_t ticks_for(uint32_t us, uint16_t tick_us)
+{
+  uint32_t t = (us + tick_us - 1) / tick_us;
+  if(t > 0xffff)
+  {
+    t = 0xffff;
+  }
+  return (t > 0) ? (uint16_t)(t - 1) : 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn step
+/// @brief STATIC Systick callback that sends the next queued entry once
+///   the controller is ready for it.
+/// @remark Interrupt context:  a byte is two nibbles, about 4 uS.
+//////////////////////////////////////////////////////////////////////////////
+static void step(void)
+{
+  uint8_t queued = (q_tail != q_head);
+  uint8_t own = 0;
+#ifdef MARQUEE
+  own = !queued && mq_due && mq_text != NULL;
+#endif
+  if(hold != 0)
+  {
+    hold--;
+  }
+  else if(queued || own)
+  {
+    uint16_t e;
+#ifdef MARQUEE
+    if(own)
+    {
+      e = mq_entry();
+    }
+    else
+#endif
+    {
+      e = queue[q_tail];
+    }
+    uint8_t b = (uint8_t)e;
+    uint8_t sent = 1;
+#if defined(LCD_44780_PANELS)
+    use_panel(e >> Q_PANEL_SHIFT);
+#elif defined(LCD_44780_EN2)
+    en_sel = e >> Q_PANEL_SHIFT;
+#endif
+    if(e & Q_NIBBLE)
+    {
+      // The busy flag isn't valid until the reset sequence is done.
+      RS_set(CMD);
+      write_bus(b);
+      hold = reset_ticks;
+    }
+    else
+    {
+#ifdef LCD_44780_RW
+      // Poll the busy flag once a tick, send when it clears.
+      sent = !busy();
+      if(sent)
+      {
+        send_byte((e & Q_DATA) ? DAT : CMD, b);
+      }
+#else
+      send_byte((e & Q_DATA) ? DAT : CMD, b);
+      if(e & Q_DATA)
+      {
+        hold = data_ticks;
+      }
+      else
+      {
+        hold = (b < 0x04) ? slow_ticks : cmd_ticks;
+      }
+#endif
+    }
+    if(sent && own)
+    {
+#ifdef MARQUEE
+      mq_sent();
+#endif
+    }
+    else if(sent)
+    {
+      q_tail = (q_tail + 1) & QUEUE_MASK;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn enqueue
+/// @brief STATIC Adds an entry, waiting for room if the queue is full.
+/// @param[in] e  Entry:  byte plus Q_ flags
+//////////////////////////////////////////////////////////////////////////////
+static void enqueue(uint16_t e)
+{
+  uint8_t next = (q_head + 1) & QUEUE_MASK;
+  while(next == q_tail)
+    ;   // step() makes room
+  queue[q_head] = e | ((uint16_t)Q_TAG << Q_PANEL_SHIFT);
+  q_head = next;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn queue_start
+/// @brief STATIC Works out the hold times and claims a systick timer.
+/// @return Nonzero if the queue is running, zero to stay blocking.
+//////////////////////////////////////////////////////////////////////////////
+static uint8_t queue_start(void)
+{
+  if(queue_timer < 0)
+  {
+    uint16_t tick_us = (uint16_t)(SYSTICK_get_ms_per_tick() * 1000.0 + 0.5);
+    if(tick_us == 0)
+    {
+      tick_us = 1;
+    }
+    data_ticks = ticks_for(EXEC_DATA_US, tick_us);
+    cmd_ticks = ticks_for(EXEC_US, tick_us);
+    slow_ticks = ticks_for(EXEC_SLOW_US, tick_us);
+    reset_ticks = ticks_for(4100, tick_us);
+    q_head = 0;
+    q_tail = 0;
+    // Power-up wait before the first nibble
+    hold = ticks_for(50000, tick_us);
+    queue_timer = SYSTICK_set_timer_ticks(1, 0, step);
+  }
+  return queue_timer >= 0;
+}
+#endif
 
 //////////////////////////////////////////////////////////////////////////////
 ///  \b LCD_44780_init
@@ -152,36 +1007,126 @@ void LCD_44780_init2(void)
 {
 
    
+#ifdef LCD_44780_PCF8574
+   TWI_init(LCD_44780_PCF8574_BPS);
+   RS_set(CMD);
+   pcf_last = pcf_ctrl;        // EN low, backlight on
+   TWI_write(LCD_44780_PCF8574, &pcf_last, 1);
+#else
    GPIO_pin_mode(LCD_44780_RS, GPIO_PIN_MODE_OUTPUT);
-   GPIO_pin_mode(LCD_44780_EN, GPIO_PIN_MODE_OUTPUT);
-   GPIO_pin_mode(LCD_44780_D7, GPIO_PIN_MODE_OUTPUT);
-   GPIO_pin_mode(LCD_44780_D6, GPIO_PIN_MODE_OUTPUT);
-   GPIO_pin_mode(LCD_44780_D5, GPIO_PIN_MODE_OUTPUT);
-   GPIO_pin_mode(LCD_44780_D4, GPIO_PIN_MODE_OUTPUT);
+   bus_mode(GPIO_PIN_MODE_OUTPUT);
+#ifdef LCD_44780_RW
+   GPIO_write_pin(LCD_44780_RW, WR);
+   GPIO_pin_mode(LCD_44780_RW, GPIO_PIN_MODE_OUTPUT);
+#endif
 
    //RS_set(0);  // Command mode
    GPIO_write_pin(LCD_44780_RS, 0);
 
    
    //E_set(0);
+#ifdef LCD_44780_PANELS
+   for(uint8_t i = 0; i < PANELS; i++)
+   {
+     GPIO_write_pin(panel_en[i], 0);
+     GPIO_pin_mode(panel_en[i], GPIO_PIN_MODE_OUTPUT);
+   }
+#else
    GPIO_write_pin(LCD_44780_EN, 0);
-   
-   _delay_ms( 50 );  // wait for it to finish initialization
-   // Set 4 bit mode
-   write_nibble(3);
-   _delay_us( DELAY_1 );   // was 15
-   write_nibble(3);
-   _delay_us( DELAY_1 );
-   write_nibble(2);
-   _delay_us( DELAY_1 );
-   
-   // Now set it how we want it
-   LCD_44780_function_set(LCD_44780_TWO_LINES);
-   LCD_44780_entry_mode(LCD_44780_INCREMENT);
-   LCD_44780_display_enable(LCD_44780_ON); // turn on the display
-   LCD_44780_clear();
-   LCD_44780_home();
+   GPIO_pin_mode(LCD_44780_EN, GPIO_PIN_MODE_OUTPUT);
+#endif
+#ifdef LCD_44780_EN2
+   GPIO_write_pin(LCD_44780_EN2, 0);
+   GPIO_pin_mode(LCD_44780_EN2, GPIO_PIN_MODE_OUTPUT);
+#endif
+#endif
+
+#ifdef LCD_44780_QUEUE_SIZE
+   uint8_t queued = queue_start();
+#endif
+   // Power-up wait, once for all panels
+#ifdef LCD_44780_QUEUE_SIZE
+   if(!queued)
+#endif
+   {
+     _delay_ms( 50 );  // wait for it to finish initialization
+   }
+
+   for(uint8_t i = 0; i < PANELS; i++)
+   {
+     LCD_44780_select(i);
+#ifdef LCD_44780_QUEUE_SIZE
+     if(queued)
+     {
+       // Same sequence, but the waits happen in step().
+       enqueue(Q_NIBBLE | RESET_VALUE);
+       enqueue(Q_NIBBLE | RESET_VALUE);
+       enqueue(Q_NIBBLE | RESET_VALUE);
+#ifndef LCD_44780_D0
+       enqueue(Q_NIBBLE | 2);
+#endif
+     }
+     else
+#endif
+     {
+       // Reset by instruction, then 4 bit mode if that's the bus.  The
+       // busy flag can't be read until this is done, so these waits are
+       // fixed.
+       write_bus(RESET_VALUE);
+       _delay_us( 4100 );
+       write_bus(RESET_VALUE);
+       _delay_us( 100 );
+       write_bus(RESET_VALUE);
+       _delay_us( EXEC_US );
+#ifndef LCD_44780_D0
+       write_bus(2);
+       _delay_us( EXEC_US );
+#endif
+     }
+
+     // CGRAM is random at power up
+     for(uint8_t n = 0; n < GLYPH_SLOTS; n++)
+     {
+       pn->slots[n].glyph = NULL;
+       pn->slots[n].rank = n;
+     }
+
+     // Now set it how we want it
+     LCD_44780_function_set(LCD_44780_TWO_LINES);
+     LCD_44780_entry_mode(LCD_44780_INCREMENT);
+     LCD_44780_display_enable(LCD_44780_ON); // turn on the display
+     LCD_44780_clear();
+     LCD_44780_home();
+   }
+   LCD_44780_select(0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_select
+/// @brief Picks the panel the other LCD_44780_ calls work on.
+/// @param[in] idx  Panel, in LCD_44780_PANELS order
+/// @return Zero on success, -1 if there is no such panel.
+//////////////////////////////////////////////////////////////////////////////
+int LCD_44780_select(uint8_t idx)
+{
+  int rtn = -1;
+  if(idx < PANELS)
+  {
+#ifdef LCD_44780_PANELS
+    cur = idx;
+    pn = &panels[idx];
+#ifdef LCD_44780_QUEUE_SIZE
+    if(queue_timer < 0)
+#endif
+    {
+      use_panel(idx);     // queued entries pick their own
+    }
+#endif
+    rtn = 0;
+  }
+  return rtn;
 }
+
 //////////////////////////////////////////////////////////////////////////////
 ///  \b LCD_44780_write_command
 ///  \brief Send a command to lcd
@@ -189,10 +1134,25 @@ void LCD_44780_init2(void)
 //////////////////////////////////////////////////////////////////////////////
 void LCD_44780_write_command( uint8_t cmd)
 {
-  RS_set(CMD);
-  write_nibble( (cmd >> 4) & 0x0f );
-  write_nibble( cmd & 0x0f );
-  _delay_us( DELAY_1 );
+  issued++;
+#ifdef LCD_44780_EN2
+  send_sel = (cmd & 0x80) ? ctrl_sel : 3;
+#endif
+#ifdef LCD_44780_QUEUE_SIZE
+  if(queue_timer >= 0)
+  {
+    enqueue(cmd);
+  }
+  else
+#endif
+  {
+#ifdef LCD_44780_EN2
+    en_sel = send_sel;
+#endif
+    send_byte(CMD, cmd);
+    // Clear (0x01) and home (0x02, 0x03) take 1.52 mS, the rest 37 uS
+    wait_ready(cmd < 0x04 ? EXEC_SLOW_US : EXEC_US);
+  }
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -201,10 +1161,38 @@ void LCD_44780_write_command( uint8_t cmd)
 /////////////////////////////////////////////////////////////////////////////
 void LCD_44780_write_data(uint8_t data)
 {
-  RS_set(DAT);
-  write_nibble( (data >> 4) & 0x0f );
-  write_nibble( data & 0x0f );
-  _delay_us(  DELAY_1 );
+  issued++;
+#ifdef LCD_44780_EN2
+  send_sel = ctrl_sel;
+#endif
+#ifdef LCD_44780_QUEUE_SIZE
+  if(queue_timer >= 0)
+  {
+    enqueue(Q_DATA | data);
+  }
+  else
+#endif
+  {
+#ifdef LCD_44780_EN2
+    en_sel = send_sel;
+#endif
+    send_byte(DAT, data);
+    wait_ready(EXEC_DATA_US);
+  }
+  track_data(data);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn home_state
+/// @brief STATIC Tracks the address counter going back to 0.
+//////////////////////////////////////////////////////////////////////////////
+static void home_state(void)
+{
+  pn->lcd_cell = 0;
+  pn->lcd_left = SPLIT;
+#ifdef LCD_44780_EN2
+  ctrl_sel = 1;               // both went home, the top one shows it
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -214,7 +1202,22 @@ void LCD_44780_write_data(uint8_t data)
 void LCD_44780_clear(void)
 {
   LCD_44780_write_command(0x01);
-  _delay_ms(5);
+  for(uint8_t i = 0; i < CELLS; i++)
+  {
+    pn->fb[i] = ' ';
+  }
+  for(uint8_t i = 0; i < GLYPH_SLOTS; i++)
+  {
+    pn->slots[i].refs = 0;    // resident glyphs stay, nothing shows them
+  }
+  for(uint8_t i = 0; i < sizeof(pn->dirty); i++)
+  {
+    pn->dirty[i] = 0;
+  }
+  home_state();
+  pn->fb_cursor = 0;
+  pn->fb_row = 0;
+  pn->fb_end = LCD_44780_COLUMNS;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -224,7 +1227,7 @@ void LCD_44780_clear(void)
 void LCD_44780_home(void)
 {
   LCD_44780_write_command(0x02);
-  _delay_ms(5);
+  home_state();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -238,7 +1241,8 @@ void LCD_44780_entry_mode(LCD_44780_param_t p)
   uint8_t cmd = 0x04;
   cmd |= p;
   LCD_44780_write_command(cmd);
-  _delay_us( DELAY_1 );  // was 40
+  pn->increment = (p & LCD_44780_INCREMENT) != 0;
+  pn->lcd_cell = NO_CELL;
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -251,7 +1255,6 @@ void LCD_44780_display_enable(int p)
   uint8_t cmd = 0x08;
   cmd |= p;
   LCD_44780_write_command(cmd);
-  _delay_us( DELAY_1 ); // 40);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -264,7 +1267,7 @@ void LCD_44780_cursor_display_shift(int p)
   uint8_t cmd = 0x10;
   cmd |= p;
   LCD_44780_write_command(cmd);
-  _delay_us( DELAY_1); //40);
+  pn->lcd_cell = NO_CELL;     // a cursor shift moves the address
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -275,9 +1278,12 @@ void LCD_44780_cursor_display_shift(int p)
 void LCD_44780_function_set(int p)
 {
   uint8_t cmd = 0x20;
-  cmd |= p;
+  // The interface width follows the wiring, whatever p says.
+  cmd |= p & ~LCD_44780_8_BIT;
+#ifdef LCD_44780_D0
+  cmd |= LCD_44780_8_BIT;
+#endif
   LCD_44780_write_command(cmd);
-  _delay_us( DELAY_1); // 40);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -288,36 +1294,46 @@ void LCD_44780_function_set(int p)
 void LCD_44780_set_CGRAM_address(int adr)
 {
   uint8_t cmd = 0x40 + (uint8_t)(adr & 0x3f);
+#ifdef LCD_44780_EN2
+  ctrl_sel = 3;               // glyphs go to both halves
+#endif
   LCD_44780_write_command(cmd);
-  _delay_us( DELAY_1); // 40);
+  pn->lcd_cell = NO_CELL;     // data now goes to CGRAM
 }
 
 //////////////////////////////////////////////////////////////////////////////
 /// @fn LCD_44780_set_DDRAM_address
 /// @brief Sets DDRAM address pointer.
-/// @param[in] adr Address to set.
+/// @param[in] adr Address to set.  On a 40x4, 0x80 picks the bottom half.
 //////////////////////////////////////////////////////////////////////////////
 void LCD_44780_set_DDRAM_address(int adr)
 {
   uint8_t cmd = 0x80 + (uint8_t)(adr & 0x7f);
+#ifdef LCD_44780_EN2
+  ctrl_sel = (adr & SECOND) ? 2 : 1;
+#endif
   LCD_44780_write_command(cmd);
-  _delay_us( DELAY_1); // 40);
+  pn->lcd_cell = NO_CELL;     // LCD_44780_goto sets it when it can
 }
 
 //////////////////////////////////////////////////////////////////////////////
 /// @fn LCD_44780_goto
 /// @brief Move cursor to column and row given
-/// @param[in] col  Column to go to, 0 to 39
-/// @param[in] row  Row to go to , 0 to 4.
+/// @param[in] col  Column to go to, 0 to LCD_44780_COLUMNS - 1
+/// @param[in] row  Row to go to, 0 to LCD_44780_ROWS - 1
 /// @return Returns 1 if succesful, 0 if not
 //////////////////////////////////////////////////////////////////////////////
 uint8_t LCD_44780_goto(int col, int row)
 {
   uint8_t rtn = 0;
-  if(col < LCD_44780_COLUMNS && row < LCD_44780_ROWS)
+  if((unsigned)col < LCD_44780_COLUMNS && (unsigned)row < LCD_44780_ROWS)
     {
       rtn = 1;
-      LCD_44780_set_DDRAM_address(row * 40 + col);
+      uint8_t left;
+      LCD_44780_set_DDRAM_address(locate(col, row, &left));
+      pn->lcd_cell = pn->increment ? pgm_read_byte(&rows[row].cell) + col
+                                   : NO_CELL;
+      pn->lcd_left = left;
     }
   
   return rtn;
@@ -327,11 +1343,16 @@ uint8_t LCD_44780_goto(int col, int row)
 /// @fn LCD_44780_read_status
 /// @brief Reads busy flag and address.
 /// @return Returns byte with busy flag and address.
+/// @remark Waits for everything queued to finish first, so the busy flag
+///   is clear and the address is where the last call left it.
 //////////////////////////////////////////////////////////////////////////////
 uint8_t LCD_44780_read_status(void)
 {
   uint8_t rtn = 0;
-  // TODO read byte here
+#ifdef LCD_44780_RW
+  LCD_44780_sync();
+  rtn = read_ready(CMD);
+#endif
   return rtn;
 }
 
@@ -343,7 +1364,12 @@ uint8_t LCD_44780_read_status(void)
 uint8_t LCD_44780_read_data(void)
 {
   uint8_t rtn = 0;
-  // TODO add stuff here
+#ifdef LCD_44780_RW
+  LCD_44780_sync();
+  rtn = read_ready(DAT);
+  wait_ready(EXEC_DATA_US);   // the read moves the address counter
+  pn->lcd_cell = NO_CELL;
+#endif
   return rtn;
 }
 
@@ -366,4 +1392,570 @@ int LCD_44780_write_string(char* str)
   return cnt;
 }
 
-  
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_write_string_P
+/// @brief Writes a string from flash straight to the display.
+/// @param[in] str String in PROGMEM, null terminated
+/// @return Number of characters written.
+//////////////////////////////////////////////////////////////////////////////
+int LCD_44780_write_string_P(const char *str)
+{
+  int cnt = 0;
+  char ch;
+  while( (ch = pgm_read_byte(str)) )
+    {
+      cnt++;
+      LCD_44780_write_data(ch);
+      str++;
+    }
+  return cnt;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_clear
+/// @brief Blanks the framebuffer and homes its cursor.  Nothing is sent
+///        until LCD_44780_flush.
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_fb_clear(void)
+{
+  for(uint8_t i = 0; i < CELLS; i++)
+  {
+    if(pn->fb[i] != ' ')
+    {
+      set_cell(i, ' ');
+      pn->dirty[i >> 3] |= (1 << (i & 0x07));
+    }
+  }
+  pn->fb_cursor = 0;
+  pn->fb_row = 0;
+  pn->fb_end = LCD_44780_COLUMNS;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_goto
+/// @brief Moves the framebuffer cursor.
+/// @param[in] col  Column to go to
+/// @param[in] row  Row to go to
+/// @return Returns 1 if succesful, 0 if not
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_fb_goto(int col, int row)
+{
+  uint8_t rtn = 0;
+  if((unsigned)col < LCD_44780_COLUMNS && (unsigned)row < LCD_44780_ROWS)
+    {
+      rtn = 1;
+      uint8_t start = pgm_read_byte(&rows[row].cell);
+      pn->fb_cursor = start + col;
+      pn->fb_row = row;
+      pn->fb_end = start + LCD_44780_COLUMNS;
+    }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_putc
+/// @brief Puts a character in the framebuffer at the cursor.
+/// @param[in] ch  Character
+/// @return 1 if the cell changed, 0 if not or the cursor is off the end.
+/// @remark The cursor stops at the end of the row.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_fb_putc(char ch)
+{
+  uint8_t rtn = 0;
+  uint8_t cell = pn->fb_cursor;
+  if(cell < CELLS)
+  {
+    if(pn->fb[cell] != ch)
+    {
+      set_cell(cell, ch);
+      pn->dirty[cell >> 3] |= (1 << (cell & 0x07));
+      rtn = 1;
+    }
+    cell++;
+    if(cell == pn->fb_end)
+    {
+      cell = NO_CELL;         // clip at the end of the row
+    }
+    pn->fb_cursor = cell;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_write_string
+/// @brief Puts a string in the framebuffer at the cursor.
+/// @param[in] str String to write, null terminated
+/// @return Number of characters that changed a cell.
+//////////////////////////////////////////////////////////////////////////////
+int LCD_44780_fb_write_string(const char *str)
+{
+  int cnt = 0;
+  char ch;
+  while( (ch = *str) )
+    {
+      cnt += LCD_44780_fb_putc(ch);
+      str++;
+    }
+  return cnt;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_write_string_P
+/// @brief Puts a string from flash in the framebuffer at the cursor.
+/// @param[in] str String in PROGMEM, null terminated
+/// @return Number of characters that changed a cell.
+//////////////////////////////////////////////////////////////////////////////
+int LCD_44780_fb_write_string_P(const char *str)
+{
+  int cnt = 0;
+  char ch;
+  while( (ch = pgm_read_byte(str)) )
+    {
+      cnt += LCD_44780_fb_putc(ch);
+      str++;
+    }
+  return cnt;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_clear_eol
+/// @brief Blanks the framebuffer from the cursor to the end of its row.
+/// @remark The cursor doesn't move.
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_fb_clear_eol(void)
+{
+  uint8_t cell = pn->fb_cursor;
+  if(cell < CELLS)
+  {
+    uint8_t end = pn->fb_end;
+    for( ; cell < end; cell++)
+    {
+      if(pn->fb[cell] != ' ')
+      {
+        set_cell(cell, ' ');
+        pn->dirty[cell >> 3] |= (1 << (cell & 0x07));
+      }
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn stream_put
+/// @brief STATIC Stream output:  a framebuffer write or part of an escape.
+/// @param[in] ch  Character
+/// @param[in] f   The stream, unused
+/// @return 0
+//////////////////////////////////////////////////////////////////////////////
+static int stream_put(char ch, FILE *f)
+{
+  switch(esc)
+  {
+  case ESC_START:
+    esc = ESC_NONE;
+    switch(ch)
+    {
+    case 'Y':
+      esc = ESC_ROW;
+      break;
+    case 'K':
+      LCD_44780_fb_clear_eol();
+      break;
+    case 'H':
+      LCD_44780_fb_goto(0, 0);
+      break;
+    case 'E':
+      LCD_44780_fb_clear();
+      break;
+    default:
+      break;        // unknown escapes are dropped
+    }
+    break;
+
+  case ESC_ROW:
+    esc_row = (uint8_t)(ch - ' ');
+    esc = ESC_COL;
+    break;
+
+  case ESC_COL:
+    esc = ESC_NONE;
+    LCD_44780_fb_goto((uint8_t)(ch - ' '), esc_row);
+    break;
+
+  default:
+    if(ch == ESC)
+    {
+      esc = ESC_START;
+    }
+    else if(ch == '\n')
+    {
+      LCD_44780_fb_clear_eol();
+      if(!LCD_44780_fb_goto(0, pn->fb_row + 1))
+      {
+        pn->fb_cursor = NO_CELL;    // off the bottom
+      }
+    }
+    else if(ch == '\r')
+    {
+      LCD_44780_fb_goto(0, pn->fb_row);
+    }
+    else if(ch == '\f')
+    {
+      LCD_44780_fb_clear();
+    }
+    else
+    {
+      LCD_44780_fb_putc(ch);
+    }
+    break;
+  }
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_stream
+/// @brief Stream that writes to the framebuffer.
+/// @return The stream, for fprintf_P and friends.
+//////////////////////////////////////////////////////////////////////////////
+FILE *LCD_44780_stream(void)
+{
+  return &stream;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_glyph
+/// @brief Makes a custom character resident in CGRAM.
+/// @param[in] glyph  8 row bitmap in flash, the glyph's ID
+/// @return Character code to show it, or LCD_44780_NO_GLYPH if every
+///   slot is showing in the framebuffer.
+/// @remark A resident glyph costs nothing.  Otherwise the least
+///   recently asked for slot that no cell shows is reloaded:  one
+///   address command and 8 data bytes.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_glyph(const uint8_t *glyph)
+{
+  uint8_t rtn = LCD_44780_NO_GLYPH;
+  uint8_t oldest = 0;
+  uint8_t victim = LCD_44780_NO_GLYPH;
+  for(uint8_t i = 0; i < GLYPH_SLOTS; i++)
+  {
+    if(pn->slots[i].glyph == glyph)
+    {
+      rtn = i;
+      break;
+    }
+    if(pn->slots[i].refs == 0)
+    {
+      // Empty slots first, then the one asked for longest ago.
+      uint8_t age = (pn->slots[i].glyph == NULL)
+        ? 0xff : pn->slots[i].rank;
+      if(victim == LCD_44780_NO_GLYPH || age > oldest)
+      {
+        victim = i;
+        oldest = age;
+      }
+    }
+  }
+  if(rtn != LCD_44780_NO_GLYPH)
+  {
+    glyph_stats.hits++;
+  }
+  else if(victim != LCD_44780_NO_GLYPH)
+  {
+    LCD_44780_set_CGRAM_address(victim << 3);
+    for(uint8_t n = 0; n < 8; n++)
+    {
+      LCD_44780_write_data(pgm_read_byte(glyph + n));
+    }
+    pn->slots[victim].glyph = glyph;
+    glyph_stats.uploads++;
+    rtn = victim;
+  }
+  else
+  {
+    glyph_stats.full++;
+  }
+  if(rtn != LCD_44780_NO_GLYPH)
+  {
+    // The ranks stay a permutation, so they never wrap.
+    uint8_t r = pn->slots[rtn].rank;
+    for(uint8_t i = 0; i < GLYPH_SLOTS; i++)
+    {
+      if(pn->slots[i].rank < r)
+      {
+        pn->slots[i].rank++;
+      }
+    }
+    pn->slots[rtn].rank = 0;
+    rtn |= 0x08;            // 0x08-0x0f mirror the slots and aren't NUL
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_putglyph
+/// @brief Puts a custom character in the framebuffer at the cursor.
+/// @param[in] glyph  8 row bitmap in flash
+/// @return 1 if the cell changed, 0 if not or no slot was free.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_fb_putglyph(const uint8_t *glyph)
+{
+  uint8_t rtn = 0;
+  uint8_t code = LCD_44780_glyph(glyph);
+  if(code != LCD_44780_NO_GLYPH)
+  {
+    rtn = LCD_44780_fb_putc(code);
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_glyph_stats
+/// @brief Copies the glyph cache counters.
+/// @param[out] stats  Where to put them.
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_glyph_stats(lcd_44780_glyph_stats_t *stats)
+{
+  *stats = glyph_stats;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_flush
+/// @brief Sends the framebuffer cells that changed.
+/// @return Bytes sent on the bus, commands included.
+/// @remark Runs of changed cells go out back to back.  The address is
+///   only set when the controller's counter isn't already on the cell.
+//////////////////////////////////////////////////////////////////////////////
+uint16_t LCD_44780_flush(void)
+{
+  uint32_t start = issued;
+  uint8_t i = 0;
+  for(uint8_t row = 0; row < LCD_44780_ROWS; row++)
+  {
+    for(uint8_t col = 0; col < LCD_44780_COLUMNS; col++, i++)
+    {
+      if(pn->dirty[i >> 3] & (1 << (i & 0x07)))
+      {
+        if(pn->lcd_cell != i)
+        {
+          LCD_44780_goto(col, row);
+        }
+        LCD_44780_write_data(pn->fb[i]);
+        // track_data only clears it when it knows the address, which it
+        // doesn't in decrement mode.
+        pn->dirty[i >> 3] &= ~(1 << (i & 0x07));
+      }
+    }
+  }
+  return (uint16_t)(issued - start);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_bus_bytes
+/// @brief Counts bytes sent to the display since reset.
+/// @return Commands plus data bytes.
+//////////////////////////////////////////////////////////////////////////////
+uint32_t LCD_44780_bus_bytes(void)
+{
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t rtn = bus_bytes;
+  SREG = sreg;
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_pending
+/// @brief Counts queued entries not yet sent.
+/// @return Zero once the queue has drained, always zero when blocking.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_pending(void)
+{
+  uint8_t rtn = 0;
+#ifdef LCD_44780_QUEUE_SIZE
+  rtn = (q_head - q_tail) & QUEUE_MASK;
+#endif
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_sync
+/// @brief Waits until everything queued has been sent and executed.
+/// @remark With RW wired the queue doesn't hold after a byte, so once it
+///   has drained this polls the busy flag of the controller it sent to
+///   last.
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_sync(void)
+{
+#ifdef LCD_44780_QUEUE_SIZE
+  if(queue_timer >= 0)
+  {
+    uint8_t wait;
+    do
+    {
+      uint8_t sreg = SREG;
+      cli();
+      wait = (q_head != q_tail) || (hold != 0);
+#ifdef LCD_44780_RW
+      if(!wait)
+      {
+        wait = busy();
+      }
+#endif
+      SREG = sreg;
+    } while(wait);
+  }
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_mark
+/// @brief Tags the point reached by the calls made so far.
+/// @return Value for LCD_44780_done.
+//////////////////////////////////////////////////////////////////////////////
+uint32_t LCD_44780_mark(void)
+{
+  return issued;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_done
+/// @brief Tells whether the bytes up to a mark have gone out.
+/// @param[in] mark  From LCD_44780_mark
+/// @return Nonzero once they have.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_done(uint32_t mark)
+{
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t sent = bus_bytes;
+#ifdef MARQUEE
+  sent -= mq_bytes;           // those were never issued
+#endif
+  SREG = sreg;
+  return (int32_t)(sent - mark) >= 0;
+}
+
+#ifdef MARQUEE
+//////////////////////////////////////////////////////////////////////////////
+/// @fn marquee_start
+/// @brief STATIC Loads a DDRAM line with the text and starts the timer.
+/// @param[in] row    Row to scroll
+/// @param[in] text   Text, null terminated
+/// @param[in] flash  Nonzero if text is in PROGMEM
+/// @param[in] ms     Milliseconds per step
+/// @return Zero on success, -1 if it can't run.
+//////////////////////////////////////////////////////////////////////////////
+static int marquee_start(uint8_t row, const char *text, uint8_t flash,
+                         uint16_t ms)
+{
+  int rtn = -1;
+  LCD_44780_marquee_stop();
+  uint16_t len = 0;
+  while((flash ? pgm_read_byte(&text[len]) : text[len]) != 0)
+  {
+    len++;
+  }
+  // Refills need a column off screen to write to.
+  if(queue_timer >= 0 && row < LCD_44780_ROWS && ms != 0
+     && (len <= MQ_LINE || LCD_44780_COLUMNS < MQ_LINE))
+  {
+    mq_text = text;
+    mq_flash = flash;
+    mq_len = len;
+    mq_period = len + LCD_44780_COLUMNS;
+    mq_addr = pgm_read_byte(&rows[row].addr);
+    mq_row = row;
+    mq_panel = cur;
+    mq_tag = (uint16_t)cur << Q_PANEL_SHIFT;
+    LCD_44780_home();         // shift back to 0
+    LCD_44780_goto(0, row);
+    // Keep the text out of the framebuffer, so LCD_44780_marquee_stop
+    // can put the row back.
+    pn->lcd_cell = NO_CELL;
+    for(uint8_t i = 0; i < MQ_LINE; i++)
+    {
+      LCD_44780_write_data(mq_char(i));
+    }
+    mq_col = 0;
+    mq_next = MQ_LINE;
+    mq_op = MQ_SHIFT;
+    mq_due = 0;
+    mq_timer = SYSTICK_set_timer_ms(ms, 0, mq_tick);
+    if(mq_timer >= 0)
+    {
+      rtn = 0;
+    }
+    else
+    {
+      mq_text = NULL;
+    }
+  }
+  return rtn;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_marquee
+/// @brief Scrolls a row of text in the background.
+/// @param[in] row   Row to scroll
+/// @param[in] text  Text, null terminated, left in place while it runs
+/// @param[in] ms    Milliseconds per one column step
+/// @return Zero on success, -1 if it can't run.
+//////////////////////////////////////////////////////////////////////////////
+int LCD_44780_marquee(uint8_t row, const char *text, uint16_t ms)
+{
+  int rtn = -1;
+#ifdef MARQUEE
+  rtn = marquee_start(row, text, 0, ms);
+#endif
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_marquee_P
+/// @brief Scrolls a row of text from flash in the background.
+/// @param[in] row   Row to scroll
+/// @param[in] text  Text in PROGMEM, null terminated
+/// @param[in] ms    Milliseconds per one column step
+/// @return Zero on success, -1 if it can't run.
+//////////////////////////////////////////////////////////////////////////////
+int LCD_44780_marquee_P(uint8_t row, const char *text, uint16_t ms)
+{
+  int rtn = -1;
+#ifdef MARQUEE
+  rtn = marquee_start(row, text, 1, ms);
+#endif
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_marquee_stop
+/// @brief Stops the marquee and puts the display back unshifted.
+/// @remark The scrolled row is marked dirty so the next LCD_44780_flush
+///   puts the framebuffer's text back.
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_marquee_stop(void)
+{
+#ifdef MARQUEE
+  if(mq_text != NULL)
+  {
+    uint8_t sreg = SREG;
+    cli();
+    mq_text = NULL;
+    mq_due = 0;
+    SREG = sreg;
+    // A timeout of 0 frees the timer.
+    SYSTICK_modify_timer_ticks(mq_timer, 0, 1, NULL);
+    mq_timer = -1;
+    uint8_t was = cur;
+    LCD_44780_select(mq_panel);
+    LCD_44780_home();         // undoes the shift
+    uint8_t i = pgm_read_byte(&rows[mq_row].cell);
+    for(uint8_t n = 0; n < LCD_44780_COLUMNS; n++, i++)
+    {
+      pn->dirty[i >> 3] |= (1 << (i & 0x07));
+    }
+    LCD_44780_select(was);
+  }
+#endif
+}
@@ -5,6 +5,7 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #include <stdint.h>
+#include <stdio.h>
 
 typedef enum _LCD_44780
   {
@@ -21,6 +22,20 @@ typedef enum _LCD_44780
     LCD_44780_5X10              = (1<<2),            // Function Set
   } LCD_44780_param_t;
 
+// Returned by LCD_44780_glyph when every CGRAM slot is in use.
+#define LCD_44780_NO_GLYPH      0xff
+
+//////////////////////////////////////////////////////////////////////////////
+/// @struct lcd_44780_glyph_stats
+/// @brief Glyph cache counters since reset.
+//////////////////////////////////////////////////////////////////////////////
+typedef struct lcd_44780_glyph_stats
+{
+  uint32_t  hits;       // Glyphs already resident:  uploads avoided
+  uint32_t  uploads;    // Glyphs written to CGRAM, 9 bus bytes each
+  uint16_t  full;       // Requests refused, every slot on screen
+} lcd_44780_glyph_stats_t;
+
 
 
 
@@ -41,8 +56,23 @@ void LCD_44780_init(uint8_t num_cols, uint8_t num_rows ,
 		    uint8_t rs, uint8_t en,
 		      uint8_t d7, uint8_t d6, uint8_t d5, uint8_t d4);
 
+//////////////////////////////////////////////////////////////////////////////
+///  \b LCD_44780_init2
+///  \brief Initializes the LCD, or every panel in LCD_44780_PANELS, from
+///         device_config.h
+//////////////////////////////////////////////////////////////////////////////
 void LCD_44780_init2(void);
 
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_select
+/// @brief Picks the panel the other LCD_44780_ calls work on.
+/// @param[in] idx  Panel, in LCD_44780_PANELS order.  Only 0 without it.
+/// @return Zero on success, -1 if there is no such panel.
+/// @remark Each panel keeps its own framebuffer, cursor, address counter
+///   and glyph cache, so switching costs nothing on the bus.
+//////////////////////////////////////////////////////////////////////////////
+int LCD_44780_select(uint8_t idx);
+
 //////////////////////////////////////////////////////////////////////////////
 ///  \b LCD_44780_write_command
 ///  \brief Send a command to lcd
@@ -74,9 +104,11 @@ void LCD_44780_home(void);
 //////////////////////////////////////////////////////////////////////////////
 /// @fn LCD_44780_goto
 /// @brief Move cursor to column and row given
-/// @param[in] col  Column to go to, 0 to 39
-/// @param[in] row  Row to go to , 0 to 4.
+/// @param[in] col  Column to go to, 0 to LCD_44780_COLUMNS - 1
+/// @param[in] row  Row to go to, 0 to LCD_44780_ROWS - 1
 /// @return Returns 1 if succesful, 0 if not
+/// @remark The DDRAM address comes from a table built for the panel size
+///   in device_config.h.
 //////////////////////////////////////////////////////////////////////////////
 uint8_t LCD_44780_goto(int col, int row);
 
@@ -109,6 +141,8 @@ void LCD_44780_cursor_display_shift(int p);
 /// @fn LCD_44780_function_set
 /// @brief SEts display length, lines, and font
 /// @param[in] p Function Set enums or'ed together.
+/// @remark LCD_44780_8_BIT is set from device_config.h:  it is on when
+///   LCD_44780_D0 is defined, whatever p says.
 //////////////////////////////////////////////////////////////////////////////
 void LCD_44780_function_set(int p);
 
@@ -123,21 +157,22 @@ void LCD_44780_set_CGRAM_address(int adr);
 //////////////////////////////////////////////////////////////////////////////
 /// @fn LCD_44780_set_DDRAM_address
 /// @brief Sets DDRAM address pointer.
-/// @param[in] adr Address to set.
+/// @param[in] adr Address to set.  On a 40x4, 0x80 picks the bottom half.
 //////////////////////////////////////////////////////////////////////////////
 void LCD_44780_set_DDRAM_address(int adr);
 
 //////////////////////////////////////////////////////////////////////////////
 /// @fn LCD_44780_read_status
 /// @brief Reads busy flag and address.
-/// @return Returns byte with busy flag and address.
+/// @return Returns byte with busy flag and address, 0 if LCD_44780_RW
+///         isn't defined.
 //////////////////////////////////////////////////////////////////////////////
 uint8_t LCD_44780_read_status(void);
 
 //////////////////////////////////////////////////////////////////////////////
 /// @fn LCD_44780_read_data
 /// @brief Reads data from display.
-/// @return The data.
+/// @return The data, 0 if LCD_44780_RW isn't defined.
 //////////////////////////////////////////////////////////////////////////////
 uint8_t LCD_44780_read_data(void);
 
@@ -149,3 +184,184 @@ uint8_t LCD_44780_read_data(void);
 //////////////////////////////////////////////////////////////////////////////
 int LCD_44780_write_string(char* str);
 
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_write_string_P
+/// @brief Writes a string from flash straight to the display.
+/// @param[in] str String in PROGMEM, null terminated, e.g. PSTR("Hi")
+/// @return Number of characters written.
+//////////////////////////////////////////////////////////////////////////////
+int LCD_44780_write_string_P(const char *str);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_clear
+/// @brief Blanks the framebuffer and homes its cursor.  Nothing is sent
+///        until LCD_44780_flush.
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_fb_clear(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_goto
+/// @brief Moves the framebuffer cursor.
+/// @param[in] col  Column to go to
+/// @param[in] row  Row to go to
+/// @return Returns 1 if succesful, 0 if not
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_fb_goto(int col, int row);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_putc
+/// @brief Puts a character in the framebuffer at the cursor.
+/// @param[in] ch  Character
+/// @return 1 if the cell changed, 0 if not or the cursor is off the end.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_fb_putc(char ch);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_write_string
+/// @brief Puts a string in the framebuffer at the cursor.
+/// @param[in] str String to write, null terminated
+/// @return Number of characters that changed a cell.
+//////////////////////////////////////////////////////////////////////////////
+int LCD_44780_fb_write_string(const char *str);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_write_string_P
+/// @brief Puts a string from flash in the framebuffer at the cursor.
+/// @param[in] str String in PROGMEM, null terminated
+/// @return Number of characters that changed a cell.
+//////////////////////////////////////////////////////////////////////////////
+int LCD_44780_fb_write_string_P(const char *str);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_clear_eol
+/// @brief Blanks the framebuffer from the cursor to the end of its row.
+/// @remark The cursor doesn't move.
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_fb_clear_eol(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_stream
+/// @brief Stream that writes to the framebuffer.
+/// @return The stream, for fprintf_P and friends.
+/// @remark Output lands in the framebuffer:  call LCD_44780_flush to
+///   send it.  Control characters and VT52 style escapes:
+///     \n      clear to end of row, go to the start of the next
+///     \r      go to the start of the row
+///     \f      clear
+///     ESC Y r c  go to row r, column c, each sent as ' ' + n
+///     ESC K    clear to end of row
+///     ESC H    home
+///     ESC E    clear
+///   e.g.  fprintf_P(LCD_44780_stream(), PSTR("\x1bY%c%cV=%d\x1bK"),
+///                   ' ' + 1, ' ' + 0, volts);
+//////////////////////////////////////////////////////////////////////////////
+FILE *LCD_44780_stream(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_glyph
+/// @brief Makes a custom character resident in CGRAM.
+/// @param[in] glyph  8 row bitmap in flash (PROGMEM), the glyph's ID
+/// @return Character code to show it, 0x08-0x0f, or LCD_44780_NO_GLYPH
+///   if all 8 slots are showing in the framebuffer.
+/// @remark Slots are counted as in use while framebuffer cells hold
+///   their code, and the least recently asked for free slot is reloaded
+///   on a miss.  Put the code in the framebuffer before asking for more
+///   glyphs than there are free slots.  A reload leaves the address
+///   counter in CGRAM:  LCD_44780_goto before writing to the display
+///   directly.  Don't mix with your own CGRAM writes.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_glyph(const uint8_t *glyph);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_fb_putglyph
+/// @brief Puts a custom character in the framebuffer at the cursor.
+/// @param[in] glyph  8 row bitmap in flash
+/// @return 1 if the cell changed, 0 if not or no slot was free.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_fb_putglyph(const uint8_t *glyph);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_glyph_stats
+/// @brief Copies the glyph cache counters.
+/// @param[out] stats  Where to put them.
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_glyph_stats(lcd_44780_glyph_stats_t *stats);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_flush
+/// @brief Sends the framebuffer cells that changed.
+/// @return Bytes sent on the bus, commands included.
+/// @remark Rewriting a field with the same text costs nothing.  Use the
+///   return value (or LCD_44780_bus_bytes) to see the bytes per frame.
+//////////////////////////////////////////////////////////////////////////////
+uint16_t LCD_44780_flush(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_bus_bytes
+/// @brief Counts bytes sent to the display since reset.
+/// @return Commands plus data bytes.
+//////////////////////////////////////////////////////////////////////////////
+uint32_t LCD_44780_bus_bytes(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_pending
+/// @brief Counts queued entries not yet sent.
+/// @return Zero once the queue has drained, always zero when blocking.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_pending(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_sync
+/// @brief Waits until everything queued has been sent and executed.
+/// @remark Returns at once when LCD_44780_QUEUE_SIZE isn't defined.
+///   Needs interrupts on.
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_sync(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_mark
+/// @brief Tags the point reached by the calls made so far.
+/// @return Value for LCD_44780_done.
+/// @remark  m = LCD_44780_mark() after drawing a frame, then poll
+///   LCD_44780_done(m) to know when it is on the glass.
+//////////////////////////////////////////////////////////////////////////////
+uint32_t LCD_44780_mark(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_done
+/// @brief Tells whether the bytes up to a mark have gone out.
+/// @param[in] mark  From LCD_44780_mark
+/// @return Nonzero once they have.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_done(uint32_t mark);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_marquee
+/// @brief Scrolls a row of text in the background.
+/// @param[in] row   Row to scroll
+/// @param[in] text  Text, null terminated, left in place while it runs
+/// @param[in] ms    Milliseconds per one column step
+/// @return Zero on success, -1 if it can't run.
+/// @remark Needs LCD_44780_QUEUE_SIZE and a free systick timer, and a
+///   panel of one or two rows.  Text up to 40 characters is written
+///   once and then costs one shift command per step.  Longer text costs
+///   three bytes a step, refilling DDRAM just out of sight.  The display
+///   shift moves every row, and goto and the framebuffer keep working in
+///   unshifted DDRAM, so leave the display alone until
+///   LCD_44780_marquee_stop.
+//////////////////////////////////////////////////////////////////////////////
+int LCD_44780_marquee(uint8_t row, const char *text, uint16_t ms);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_marquee_P
+/// @brief LCD_44780_marquee with the text in PROGMEM.
+//////////////////////////////////////////////////////////////////////////////
+int LCD_44780_marquee_P(uint8_t row, const char *text, uint16_t ms);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_marquee_stop
+/// @brief Stops the marquee and puts the display back unshifted.
+/// @remark Marks the scrolled row dirty:  LCD_44780_flush redraws it
+///   from the framebuffer.
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_marquee_stop(void);
@@ -0,0 +1,471 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file lcd_44780_model.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Host side model of an HD44780 driven from its pin waveform.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <string.h>
+#include "lcd_44780_model.h"
+
+static const char *names[LCD_44780_MODEL_FAULTS] =
+  {
+    "power up", "busy", "RS/RW setup", "RS/RW hold", "E pulse",
+    "E cycle", "data setup", "data hold", "address", "read busy"
+  };
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn line_length
+/// @brief STATIC DDRAM columns in a line for the function set.
+//////////////////////////////////////////////////////////////////////////////
+static uint8_t line_length(const lcd_44780_model_t *m)
+{
+  return m->lines2 ? 40 : 80;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn step_ac
+/// @brief STATIC Moves the address counter after a RAM access.
+/// @param[in] m    Model
+/// @param[in] inc  Nonzero to count up
+/// @remark DDRAM runs 0x00 to 0x27 then 0x40 to 0x67 with two lines,
+///   0x00 to 0x4f with one, and wraps round.
+//////////////////////////////////////////////////////////////////////////////
+static void step_ac(lcd_44780_model_t *m, uint8_t inc)
+{
+  if(m->cg)
+  {
+    m->ac = (m->ac + (inc ? 1 : -1)) & 0x3f;
+  }
+  else if(m->lines2)
+  {
+    if(inc)
+    {
+      m->ac = (m->ac == 0x27) ? 0x40 : (m->ac == 0x67) ? 0x00 : m->ac + 1;
+    }
+    else
+    {
+      m->ac = (m->ac == 0x40) ? 0x27 : (m->ac == 0x00) ? 0x67 : m->ac - 1;
+    }
+  }
+  else
+  {
+    if(inc)
+    {
+      m->ac = (m->ac == 0x4f) ? 0x00 : m->ac + 1;
+    }
+    else
+    {
+      m->ac = (m->ac == 0x00) ? 0x4f : m->ac - 1;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn shift_display
+/// @brief STATIC Shifts the display a column.
+/// @param[in] left  Nonzero to move the text left
+//////////////////////////////////////////////////////////////////////////////
+static void shift_display(lcd_44780_model_t *m, uint8_t left)
+{
+  uint8_t len = line_length(m);
+  m->shift = left ? (m->shift + 1) % len : (m->shift + len - 1) % len;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn check_address
+/// @brief STATIC Counts an address counter outside DDRAM.
+//////////////////////////////////////////////////////////////////////////////
+static void check_address(lcd_44780_model_t *m)
+{
+  uint8_t a = m->ac;
+  if(!m->cg && (m->lines2 ? ((a & 0x3f) > 0x27) : (a > 0x4f)))
+  {
+    m->faults[LCD_44780_MODEL_ADDRESS]++;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn execute
+/// @brief STATIC Carries out an instruction or a data write.
+/// @param[in] m   Model
+/// @param[in] rs  RS level
+/// @param[in] b   Byte
+/// @return Execution time in nS.
+//////////////////////////////////////////////////////////////////////////////
+static uint32_t execute(lcd_44780_model_t *m, uint8_t rs, uint8_t b)
+{
+  uint32_t exec = LCD_44780_MODEL_T_EXEC;
+  if(rs)
+  {
+    check_address(m);
+    if(m->cg)
+    {
+      m->cgram[m->ac & 0x3f] = b;
+    }
+    else
+    {
+      m->ddram[m->ac & 0x7f] = b;
+    }
+    step_ac(m, m->inc);
+    if(m->entry_shift && !m->cg)
+    {
+      shift_display(m, m->inc);
+    }
+    m->writes++;
+    exec += LCD_44780_MODEL_T_ADD;
+  }
+  else
+  {
+    m->commands++;
+    if(b & 0x80)
+    {
+      m->ac = b & 0x7f;
+      m->cg = 0;
+      check_address(m);
+    }
+    else if(b & 0x40)
+    {
+      m->ac = b & 0x3f;
+      m->cg = 1;
+    }
+    else if(b & 0x20)
+    {
+      // Until the reset sequence is done the waits are longer.
+      if((b & 0x10) && m->resets < 3)
+      {
+        exec = (m->resets == 0) ? LCD_44780_MODEL_T_RESET1
+             : (m->resets == 1) ? LCD_44780_MODEL_T_RESET2
+             : LCD_44780_MODEL_T_EXEC;
+        m->resets++;
+      }
+      m->dl8 = (b >> 4) & 1;
+      m->lines2 = (b >> 3) & 1;
+      m->font = (b >> 2) & 1;
+      m->half = 0;
+    }
+    else if(b & 0x10)
+    {
+      if(b & 0x08)
+      {
+        shift_display(m, !(b & 0x04));
+      }
+      else
+      {
+        step_ac(m, (b & 0x04) != 0);
+      }
+    }
+    else if(b & 0x08)
+    {
+      m->display = b & 0x07;
+    }
+    else if(b & 0x04)
+    {
+      m->inc = (b >> 1) & 1;
+      m->entry_shift = b & 1;
+    }
+    else if(b & 0x02)
+    {
+      m->ac = 0;
+      m->cg = 0;
+      m->shift = 0;
+      exec = LCD_44780_MODEL_T_SLOW;
+    }
+    else if(b & 0x01)
+    {
+      memset(m->ddram, ' ', sizeof(m->ddram));
+      m->ac = 0;
+      m->cg = 0;
+      m->shift = 0;
+      m->inc = 1;
+      exec = LCD_44780_MODEL_T_SLOW;
+    }
+  }
+  return exec;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn fall
+/// @brief STATIC Falling edge of E:  latches a write or ends a read.
+//////////////////////////////////////////////////////////////////////////////
+static void fall(lcd_44780_model_t *m, uint64_t t)
+{
+  m->strobes++;
+  if(m->strobes == 1)
+  {
+    m->first = t;
+  }
+  m->last = t;
+
+  if(m->rw)
+  {
+    if(!m->dl8 && !m->half)
+    {
+      m->half = 1;
+    }
+    else
+    {
+      m->half = 0;
+      m->reads++;
+      if(m->rs)
+      {
+        step_ac(m, m->inc);   // a data read moves the counter too
+        m->busy_until = t + LCD_44780_MODEL_T_ADD;
+      }
+    }
+  }
+  else if(t < LCD_44780_MODEL_T_POWER_UP)
+  {
+    m->faults[LCD_44780_MODEL_POWER_UP]++;
+  }
+  else if(!m->half && t < m->busy_until)
+  {
+    // The real part ignores it, so does the model.
+    m->faults[LCD_44780_MODEL_BUSY]++;
+  }
+  else
+  {
+    // Unwired low lines float high
+    uint8_t d = m->wide ? m->data : (m->data | 0x0f);
+    uint8_t b = d;
+    uint8_t done = 1;
+    if(!m->dl8)
+    {
+      if(!m->half)
+      {
+        m->nibble = d & 0xf0;
+        m->half = 1;
+        done = 0;
+      }
+      else
+      {
+        b = m->nibble | (d >> 4);
+        m->half = 0;
+      }
+    }
+    if(done)
+    {
+      uint32_t exec = execute(m, m->rs, b);
+      m->busy_until = t + exec;
+      m->exec_ns += exec;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_init
+/// @brief Powers up a controller at time 0.
+/// @param[in] m     Model
+/// @param[in] wide  Nonzero if D0 to D3 are wired.
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_MODEL_init(lcd_44780_model_t *m, uint8_t wide)
+{
+  memset(m, 0, sizeof(*m));
+  m->wide = wide;
+  // The internal reset:  8 bit, one line, display off, incrementing
+  memset(m->ddram, ' ', sizeof(m->ddram));
+  m->dl8 = 1;
+  m->inc = 1;
+  m->out = 0xff;
+  m->busy_until = LCD_44780_MODEL_T_POWER_UP;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_pins
+/// @brief Feeds the pin levels at a point in time.
+/// @param[in] m     Model
+/// @param[in] t     nS since power up
+/// @param[in] rs    RS level
+/// @param[in] rw    RW level
+/// @param[in] en    E level
+/// @param[in] data  D7 to D0
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_MODEL_pins(lcd_44780_model_t *m, uint64_t t, uint8_t rs,
+                          uint8_t rw, uint8_t en, uint8_t data)
+{
+  rs = rs != 0;
+  rw = rw != 0;
+  en = en != 0;
+  if(!m->wide)
+  {
+    data &= 0xf0;
+  }
+  uint8_t had_edge = (m->strobes != 0 || m->en);
+
+  if(rs != m->rs || rw != m->rw)
+  {
+    if(m->en || (had_edge && t - m->t_fall < LCD_44780_MODEL_T_AH))
+    {
+      m->faults[m->en ? LCD_44780_MODEL_SETUP : LCD_44780_MODEL_ADDR_HOLD]++;
+    }
+    m->rs = rs;
+    m->rw = rw;
+    m->t_ctrl = t;
+  }
+  if(data != m->data)
+  {
+    // Only a write cares:  during a read the controller drives the bus.
+    if(!m->rw && !m->en && had_edge && t - m->t_fall < LCD_44780_MODEL_T_H)
+    {
+      m->faults[LCD_44780_MODEL_DATA_HOLD]++;
+    }
+    m->data = data;
+    m->t_data = t;
+  }
+
+  if(en && !m->en)
+  {
+    if(t - m->t_ctrl < LCD_44780_MODEL_T_AS)
+    {
+      m->faults[LCD_44780_MODEL_SETUP]++;
+    }
+    if(m->strobes != 0 && t - m->t_rise < LCD_44780_MODEL_T_CYC_E)
+    {
+      m->faults[LCD_44780_MODEL_CYCLE]++;
+    }
+    m->t_rise = t;
+    if(m->rw)
+    {
+      uint8_t b;
+      if(m->dl8 || !m->half)
+      {
+        if(m->rs)
+        {
+          if(t < m->busy_until)
+          {
+            m->faults[LCD_44780_MODEL_READ_BUSY]++;
+          }
+          b = m->cg ? m->cgram[m->ac & 0x3f] : m->ddram[m->ac & 0x7f];
+        }
+        else
+        {
+          b = ((t < m->busy_until) ? 0x80 : 0) | m->ac;
+        }
+        m->read = b;
+      }
+      else
+      {
+        b = m->read << 4;
+      }
+      m->out = m->wide ? b : (b & 0xf0);
+    }
+  }
+  else if(!en && m->en)
+  {
+    if(t - m->t_rise < LCD_44780_MODEL_PW_EH)
+    {
+      m->faults[LCD_44780_MODEL_PULSE]++;
+    }
+    if(!m->rw && t - m->t_data < LCD_44780_MODEL_T_DSW)
+    {
+      m->faults[LCD_44780_MODEL_DATA_SETUP]++;
+    }
+    m->t_fall = t;
+    m->out = 0xff;
+    fall(m, t);
+  }
+  m->en = en;
+  m->now = t;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_bus
+/// @brief What the controller drives on D7 to D0.
+/// @return The byte or nibble while RW and E are high, 0xff otherwise.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_MODEL_bus(const lcd_44780_model_t *m)
+{
+  return (m->rw && m->en) ? m->out : 0xff;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_busy
+/// @brief Tells whether the controller is still executing.
+/// @return Nonzero while busy.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t LCD_44780_MODEL_busy(const lcd_44780_model_t *m, uint64_t t)
+{
+  return t < m->busy_until;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_faults
+/// @brief Adds up the violations of every kind.
+/// @return Total.
+//////////////////////////////////////////////////////////////////////////////
+uint32_t LCD_44780_MODEL_faults(const lcd_44780_model_t *m)
+{
+  uint32_t n = 0;
+  for(int i = 0; i < LCD_44780_MODEL_FAULTS; i++)
+  {
+    n += m->faults[i];
+  }
+  return n;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_fault_name
+/// @brief Short name of a kind of violation.
+//////////////////////////////////////////////////////////////////////////////
+const char *LCD_44780_MODEL_fault_name(lcd_44780_model_fault_t f)
+{
+  return ((unsigned)f < LCD_44780_MODEL_FAULTS) ? names[f] : "?";
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_render
+/// @brief Writes what the panel shows as text.
+/// @param[in]  m     Model
+/// @param[out] buf   rows * (cols + 1) + 1 bytes
+/// @param[in]  cols  Columns of the panel
+/// @param[in]  rows  Rows of the panel
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_MODEL_render(const lcd_44780_model_t *m, char *buf,
+                            uint8_t cols, uint8_t rows)
+{
+  uint8_t len = line_length(m);
+  for(uint8_t r = 0; r < rows; r++)
+  {
+    // Rows 2 and 3 of a 4 row panel carry on from rows 0 and 1.
+    uint8_t line = m->lines2 ? (r & 1) : 0;
+    uint8_t start = (r >= 2) ? cols : 0;
+    for(uint8_t c = 0; c < cols; c++)
+    {
+      char ch = ' ';
+      if((m->display & 0x04) && (m->lines2 || r == 0))
+      {
+        uint8_t col = (start + c + m->shift) % len;
+        ch = (char)m->ddram[line * 0x40 + col];
+      }
+      *buf++ = ch;
+    }
+    *buf++ = '\n';
+  }
+  *buf = '\0';
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_render_glyph
+/// @brief Writes a CGRAM character as 8 lines of '#' and '.'.
+/// @param[in]  m     Model
+/// @param[out] buf   49 bytes
+/// @param[in]  code  Character code
+//////////////////////////////////////////////////////////////////////////////
+void LCD_44780_MODEL_render_glyph(const lcd_44780_model_t *m, char *buf,
+                                  uint8_t code)
+{
+  const uint8_t *g = &m->cgram[(code & 0x07) * 8];
+  for(uint8_t r = 0; r < 8; r++)
+  {
+    for(uint8_t bit = 0x10; bit != 0; bit >>= 1)
+    {
+      *buf++ = (g[r] & bit) ? '#' : '.';
+    }
+    *buf++ = '\n';
+  }
+  *buf = '\0';
+}
@@ -0,0 +1,195 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file lcd_44780_model.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Host side model of an HD44780 driven from its pin waveform.
+///
+///  Builds with the host compiler, not avr-gcc.  A harness that stubs the
+///  AVR ports calls LCD_44780_MODEL_pins with the RS, RW, E and data
+///  levels and the time whenever they change.  The model latches
+///  transfers on the falling edge of E like the controller does, checks
+///  the datasheet bus timing and execution times, and keeps DDRAM and
+///  CGRAM so what the panel would show can be compared as text.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef LCD_44780_MODEL_H
+#define LCD_44780_MODEL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#define LCD_44780_MODEL_VERSION_MAJOR     0
+#define LCD_44780_MODEL_VERSION_MINOR     1
+#define LCD_44780_MODEL_VERSION_BUILD     0
+#define LCD_44780_MODEL_VERSION_DATE      (20230701L)
+
+  // HD44780U datasheet, VCC 4.5 to 5.5 V.  Times in nS.
+#define LCD_44780_MODEL_T_POWER_UP   40000000ULL  // VCC to first write
+#define LCD_44780_MODEL_T_AS         40         // RS, RW to E rise
+#define LCD_44780_MODEL_T_AH         10         // RS, RW after E fall
+#define LCD_44780_MODEL_PW_EH        230        // E high
+#define LCD_44780_MODEL_T_CYC_E      500        // E rise to E rise
+#define LCD_44780_MODEL_T_DSW        80         // data to E fall
+#define LCD_44780_MODEL_T_H          10         // data after E fall
+#define LCD_44780_MODEL_T_EXEC       37000      // most instructions
+#define LCD_44780_MODEL_T_ADD        4000       // RAM write, after the 37 uS
+#define LCD_44780_MODEL_T_SLOW       1520000    // clear and home
+#define LCD_44780_MODEL_T_RESET1     4100000    // after the first 0x30
+#define LCD_44780_MODEL_T_RESET2     100000     // after the second
+
+//////////////////////////////////////////////////////////////////////////////
+/// @enum lcd_44780_model_fault
+/// @brief Kinds of violation counted in lcd_44780_model_t.faults.
+//////////////////////////////////////////////////////////////////////////////
+  typedef enum lcd_44780_model_fault
+  {
+    LCD_44780_MODEL_POWER_UP,   // write before the power up time, ignored
+    LCD_44780_MODEL_BUSY,       // write while executing, ignored
+    LCD_44780_MODEL_SETUP,      // RS or RW changed too close to E rise
+    LCD_44780_MODEL_ADDR_HOLD,  // RS or RW changed too soon after E fall
+    LCD_44780_MODEL_PULSE,      // E high too short
+    LCD_44780_MODEL_CYCLE,      // E rises too close together
+    LCD_44780_MODEL_DATA_SETUP, // data changed too close to E fall
+    LCD_44780_MODEL_DATA_HOLD,  // data changed too soon after E fall
+    LCD_44780_MODEL_ADDRESS,    // DDRAM address outside the line
+    LCD_44780_MODEL_READ_BUSY,  // RAM read while executing, undefined
+    LCD_44780_MODEL_FAULTS
+  } lcd_44780_model_fault_t;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @struct lcd_44780_model
+/// @brief One controller.  Read the counters directly, leave the rest to
+///        the LCD_44780_MODEL_ calls.
+//////////////////////////////////////////////////////////////////////////////
+  typedef struct lcd_44780_model
+  {
+    // Counters
+    uint32_t  faults[LCD_44780_MODEL_FAULTS];
+    uint32_t  commands;       // instructions executed
+    uint32_t  writes;         // data bytes written
+    uint32_t  reads;          // status and data reads
+    uint32_t  strobes;        // E pulses, two per byte on a 4 bit bus
+    uint64_t  first;          // nS of the first E fall
+    uint64_t  last;           // nS of the last E fall
+    uint64_t  exec_ns;        // execution time of everything executed
+
+    // Pins and when they changed
+    uint8_t   wide;           // all eight data lines wired
+    uint8_t   rs, rw, en, data;
+    uint64_t  now;
+    uint64_t  t_ctrl;         // RS or RW
+    uint64_t  t_data;
+    uint64_t  t_rise;
+    uint64_t  t_fall;
+    uint8_t   out;            // driven on the data lines during a read
+
+    // Controller
+    uint8_t   ddram[0x80];
+    uint8_t   cgram[0x40];
+    uint8_t   ac;             // address counter
+    uint8_t   cg;             // the counter points into CGRAM
+    uint8_t   shift;          // display shift, columns left
+    uint8_t   dl8;            // 8 bit interface
+    uint8_t   lines2;
+    uint8_t   font;
+    uint8_t   inc;            // entry mode I/D
+    uint8_t   entry_shift;    // entry mode S
+    uint8_t   display;        // display enable D, C, B bits
+    uint8_t   half;           // 4 bit:  first nibble of a byte done
+    uint8_t   nibble;         // 4 bit:  the first nibble
+    uint8_t   resets;         // function sets with DL=1 since power up
+    uint8_t   read;           // byte being read, 4 bit
+    uint64_t  busy_until;
+  } lcd_44780_model_t;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_init
+/// @brief Powers up a controller at time 0.
+/// @param[in] m     Model
+/// @param[in] wide  Nonzero if D0 to D3 are wired.  Otherwise they float
+///                  high as on the real part.
+//////////////////////////////////////////////////////////////////////////////
+  void LCD_44780_MODEL_init(lcd_44780_model_t *m, uint8_t wide);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_pins
+/// @brief Feeds the pin levels at a point in time.
+/// @param[in] m     Model
+/// @param[in] t     nS since power up, never going backwards
+/// @param[in] rs    RS level
+/// @param[in] rw    RW level, 0 if it is tied low
+/// @param[in] en    E level
+/// @param[in] data  D7 to D0, D7 to D4 on a 4 bit bus
+/// @remark Call it whenever any of them change.  Changes in one call
+///   happen at the same instant, so set the data and raise E in separate
+///   calls, as the port writes would.
+//////////////////////////////////////////////////////////////////////////////
+  void LCD_44780_MODEL_pins(lcd_44780_model_t *m, uint64_t t, uint8_t rs,
+                            uint8_t rw, uint8_t en, uint8_t data);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_bus
+/// @brief What the controller drives on D7 to D0.
+/// @return The byte, or nibble in D7 to D4, while RW and E are high.
+///   0xff otherwise.
+//////////////////////////////////////////////////////////////////////////////
+  uint8_t LCD_44780_MODEL_bus(const lcd_44780_model_t *m);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_busy
+/// @brief Tells whether the controller is still executing.
+/// @param[in] m  Model
+/// @param[in] t  nS since power up
+/// @return Nonzero while busy.
+//////////////////////////////////////////////////////////////////////////////
+  uint8_t LCD_44780_MODEL_busy(const lcd_44780_model_t *m, uint64_t t);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_faults
+/// @brief Adds up the violations of every kind.
+/// @return Total.
+//////////////////////////////////////////////////////////////////////////////
+  uint32_t LCD_44780_MODEL_faults(const lcd_44780_model_t *m);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_fault_name
+/// @brief Short name of a kind of violation, for reports.
+//////////////////////////////////////////////////////////////////////////////
+  const char *LCD_44780_MODEL_fault_name(lcd_44780_model_fault_t f);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_render
+/// @brief Writes what the panel shows as text.
+/// @param[in]  m     Model
+/// @param[out] buf   rows lines of cols characters, each ending in '\n',
+///                   then a '\0':  rows * (cols + 1) + 1 bytes
+/// @param[in]  cols  Columns of the panel
+/// @param[in]  rows  Rows of the panel, 1, 2 or 4
+/// @remark Characters are the DDRAM codes, so CGRAM glyphs come out as
+///   0x00 to 0x0f.  A display that is off shows blanks.  For a 40x4 render
+///   each controller as a 40x2.
+//////////////////////////////////////////////////////////////////////////////
+  void LCD_44780_MODEL_render(const lcd_44780_model_t *m, char *buf,
+                              uint8_t cols, uint8_t rows);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn LCD_44780_MODEL_render_glyph
+/// @brief Writes a CGRAM character as 8 lines of '#' and '.'.
+/// @param[in]  m     Model
+/// @param[out] buf   8 lines of 5 characters and '\n', then '\0':  49 bytes
+/// @param[in]  code  Character code, 0 to 7 (8 to 15 are the same)
+//////////////////////////////////////////////////////////////////////////////
+  void LCD_44780_MODEL_render_glyph(const lcd_44780_model_t *m, char *buf,
+                                    uint8_t code);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // #ifndef LCD_44780_MODEL_H
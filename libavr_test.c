@@ -3,6 +3,7 @@
 
 #include <util/delay.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <stdio.h>
 
 #include "gpio.h"
@@ -26,11 +27,10 @@ int main()
 
   SYSTICK_init(CLK_DIV_64, timers, 4);
   
-  LCD_44780_init(16,2,GPIO_PIN_B1, GPIO_PIN_B0,
-		       GPIO_PIN_D7, GPIO_PIN_D6, GPIO_PIN_D5, GPIO_PIN_D4);
+  LCD_44780_init2();
   LCD_44780_clear();
   _delay_ms(1000);
-  LCD_44780_write_string("Hello, World!");
+  LCD_44780_write_string_P(PSTR("Hello, World!"));
   _delay_ms(2000);
   //LCD_44780_goto(4,1);
   //LCD_44780_write_string("More");
@@ -48,22 +48,16 @@ int main()
   _delay_ms(1000);
   //if(SYSTICK_get_ticks()  == 0) LCD_44780_write_string("zero");
   //else LCD_44780_write_string("nonzero");
-  char str[32];
+  FILE *lcd = LCD_44780_stream();
 
   LCD_44780_clear();
-  LCD_44780_goto(0,0);
-  sprintf(str, ":%ld:", (uint32_t) SYSTICK_get_irq_frequency() );
-  LCD_44780_write_string(str);
-  sprintf(str, "%ld:", SYSTICK_get_ticks() );
-  LCD_44780_write_string(str);
-  sprintf(str, "%d:", TCCR0);
-  LCD_44780_write_string(str);
-  sprintf(str, "%d:", TCNT0);
-  LCD_44780_write_string(str);
-  LCD_44780_goto(0,1);
-
-  sprintf(str, "msk:%d:", TIMSK);
-  LCD_44780_write_string(str);
+  // Formats straight into the framebuffer:  no buffer, strings in flash
+  fprintf_P(lcd, PSTR(":%ld:"), (uint32_t) SYSTICK_get_irq_frequency() );
+  fprintf_P(lcd, PSTR("%ld:"), SYSTICK_get_ticks() );
+  fprintf_P(lcd, PSTR("%d:"), TCCR0);
+  fprintf_P(lcd, PSTR("%d:\n"), TCNT0);
+  fprintf_P(lcd, PSTR("msk:%d:"), TIMSK);
+  LCD_44780_flush();
 
   while(1)
     {
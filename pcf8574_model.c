@@ -0,0 +1,136 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file pcf8574_model.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Host side model of a PCF8574 I2C expander driven from the SDA
+///         and SCL waveform.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <string.h>
+#include "pcf8574_model.h"
+
+// Decoder states
+#define IDLE        0       // between transactions
+#define ADDRESS     1       // clocking in the address byte
+#define DATA        2       // addressed for a write, clocking in data
+#define OTHER       3       // another part's transaction, or a read
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn PCF8574_MODEL_init
+/// @brief Powers up an expander:  the bus idle and P7 to P0 high.
+/// @param[in] m     Model
+/// @param[in] addr  7 bit address
+//////////////////////////////////////////////////////////////////////////////
+void PCF8574_MODEL_init(pcf8574_model_t *m, uint8_t addr)
+{
+  memset(m, 0, sizeof(*m));
+  m->addr = addr;
+  m->out = 0xff;              // quasi-bidirectional, high at power up
+  m->sda = 1;
+  m->scl = 1;
+  m->state = IDLE;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn PCF8574_MODEL_pins
+/// @brief Feeds the line levels at a point in time.
+/// @param[in] m    Model
+/// @param[in] t    nS since power up
+/// @param[in] sda  SDA level
+/// @param[in] scl  SCL level
+/// @return Nonzero if out changed.
+/// @remark Bits are sampled on the SCL rise.  The ack is driven from the
+///   fall after the eighth clock to the fall after the ninth, and a data
+///   byte reaches the port as the ack starts.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t PCF8574_MODEL_pins(pcf8574_model_t *m, uint64_t t, uint8_t sda,
+                           uint8_t scl)
+{
+  uint8_t rtn = 0;
+  uint8_t busy = (m->state == ADDRESS || m->state == DATA);
+  sda = sda != 0;
+  scl = scl != 0;
+
+  if(scl && m->scl && sda != m->sda)
+  {
+    if(!sda)
+    {
+      // Start, or a repeated start
+      m->state = ADDRESS;
+      m->bit = 0;
+      m->shift = 0;
+    }
+    else
+    {
+      // Stop
+      if(m->state == DATA)
+      {
+        m->last = t;
+      }
+      m->state = IDLE;
+    }
+    m->ack = 0;
+  }
+  else if(scl && !m->scl && busy)
+  {
+    if(m->bit < 8)
+    {
+      m->shift = (m->shift << 1) | sda;
+    }
+    m->bit++;
+    m->clocks++;
+  }
+  else if(!scl && m->scl && busy)
+  {
+    if(m->bit == 8)
+    {
+      if(m->state == DATA)
+      {
+        rtn = (m->out != m->shift);
+        m->out = m->shift;
+        m->writes++;
+        m->ack = 1;
+      }
+      else if(m->shift == (m->addr << 1))
+      {
+        // Our address, R/W low
+        if(m->transactions == 0)
+        {
+          m->first = t;
+        }
+        m->transactions++;
+        m->ack = 1;
+      }
+      else
+      {
+        m->clocks -= 8;       // not ours after all
+        m->state = OTHER;
+      }
+    }
+    else if(m->bit == 9)
+    {
+      m->ack = 0;
+      m->bit = 0;
+      m->shift = 0;
+      m->state = DATA;
+    }
+  }
+  m->sda = sda;
+  m->scl = scl;
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn PCF8574_MODEL_sda
+/// @brief What the expander does to SDA.
+/// @param[in] m  Model
+/// @return 0 while it pulls SDA low to acknowledge, 1 when it lets go.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t PCF8574_MODEL_sda(const pcf8574_model_t *m)
+{
+  return !m->ack;
+}
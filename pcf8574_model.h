@@ -0,0 +1,93 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file pcf8574_model.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Host side model of a PCF8574 I2C expander driven from the SDA
+///         and SCL waveform.
+///
+///  Builds with the host compiler, not avr-gcc.  A harness that stubs the
+///  AVR ports calls PCF8574_MODEL_pins with the line levels and the time
+///  whenever they change, and puts PCF8574_MODEL_sda on SDA so the master
+///  sees the acknowledges.  The model decodes start, stop and the bytes
+///  written to its address, latches each into P7 to P0 as the part does,
+///  and counts transactions and SCL clocks so a harness can work out the
+///  throughput at any bus rate.  Behind an LCD backpack, feed out to
+///  lcd_44780_model.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef PCF8574_MODEL_H
+#define PCF8574_MODEL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#define PCF8574_MODEL_VERSION_MAJOR     0
+#define PCF8574_MODEL_VERSION_MINOR     1
+#define PCF8574_MODEL_VERSION_BUILD     0
+#define PCF8574_MODEL_VERSION_DATE      (20231019L)
+
+//////////////////////////////////////////////////////////////////////////////
+/// @struct pcf8574_model
+/// @brief One expander.  Read the counters and out directly, leave the
+///        rest to the PCF8574_MODEL_ calls.
+//////////////////////////////////////////////////////////////////////////////
+  typedef struct pcf8574_model
+  {
+    // Counters
+    uint32_t  transactions;   // starts addressed to this part
+    uint32_t  writes;         // bytes latched into P7 to P0
+    uint32_t  clocks;         // SCL clocks in those transactions, acks too
+    uint64_t  first;          // nS of the first address it acknowledged
+    uint64_t  last;           // nS of the last stop after one
+
+    // Port
+    uint8_t   out;            // P7 to P0
+
+    // Bus and decoder
+    uint8_t   addr;           // 7 bit address
+    uint8_t   sda, scl;       // line levels
+    uint8_t   state;          // see pcf8574_model.c
+    uint8_t   bit;            // clocks of the byte so far, 9 with the ack
+    uint8_t   shift;          // byte being clocked in
+    uint8_t   ack;            // pulling SDA low
+  } pcf8574_model_t;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn PCF8574_MODEL_init
+/// @brief Powers up an expander:  the bus idle and P7 to P0 high.
+/// @param[in] m     Model
+/// @param[in] addr  7 bit address, 0x20 to 0x27 on the PCF8574
+//////////////////////////////////////////////////////////////////////////////
+  void PCF8574_MODEL_init(pcf8574_model_t *m, uint8_t addr);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn PCF8574_MODEL_pins
+/// @brief Feeds the line levels at a point in time.
+/// @param[in] m    Model
+/// @param[in] t    nS since power up, never going backwards
+/// @param[in] sda  SDA level, with PCF8574_MODEL_sda already folded in
+/// @param[in] scl  SCL level
+/// @return Nonzero if out changed.
+//////////////////////////////////////////////////////////////////////////////
+  uint8_t PCF8574_MODEL_pins(pcf8574_model_t *m, uint64_t t, uint8_t sda,
+                             uint8_t scl);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn PCF8574_MODEL_sda
+/// @brief What the expander does to SDA.
+/// @param[in] m  Model
+/// @return 0 while it pulls SDA low to acknowledge, 1 when it lets go.
+//////////////////////////////////////////////////////////////////////////////
+  uint8_t PCF8574_MODEL_sda(const pcf8574_model_t *m);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // #ifndef PCF8574_MODEL_H
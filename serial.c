@@ -0,0 +1,598 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file serial.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Interrupt driven USART with receive and transmit rings.
+///
+///  Each ring has one producer and one consumer:  the receive complete
+///  ISR fills the receive ring and SERIAL_read empties it, SERIAL_write
+///  fills the transmit ring and the data register empty ISR empties it.
+///  Each side only writes its own 8 bit index, and a byte store is
+///  atomic, so neither side turns interrupts off for the rings.  Setting
+///  UDRIE does:  the ISR writes TXB8 and UDRIE in the same register.
+///
+///  SERIAL_write_buffer hands the ISR a block to send from where it is,
+///  RAM or flash, without copying it through the ring.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stddef.h>   // for NULL
+#include "config.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "serial.h"
+
+#if (SERIAL_RX_BUFFER_SIZE & (SERIAL_RX_BUFFER_SIZE - 1)) != 0 \
+  || SERIAL_RX_BUFFER_SIZE > 256
+#error SERIAL_RX_BUFFER_SIZE must be a power of two, 256 at most
+#endif
+#if (SERIAL_TX_BUFFER_SIZE & (SERIAL_TX_BUFFER_SIZE - 1)) != 0 \
+  || SERIAL_TX_BUFFER_SIZE > 256
+#error SERIAL_TX_BUFFER_SIZE must be a power of two, 256 at most
+#endif
+#define RX_MASK     (SERIAL_RX_BUFFER_SIZE - 1)
+#define TX_MASK     (SERIAL_TX_BUFFER_SIZE - 1)
+
+// Register bits.  The positions are the same on every part, only the
+// names differ (RXC on the ATmega8, RXC0 on the ATmega328).
+#define RXC         7           // UCSRA
+#define UDRE        5
+#define FE          4
+#define DOR         3
+#define UPE         2
+#define U2X         1
+#define RXCIE       7           // UCSRB
+#define UDRIE       5
+#define RXEN        4
+#define TXEN        3
+#define UCSZ2       2
+#define RXB8        1
+#define TXB8        0
+#define UPM1        5           // UCSRC
+#define UPM0        4
+#define USBS        3
+#define UCSZ0       1
+
+// Registers of each port, named CSRA_n and so on.  The ATmega8 shares
+// an address between UBRRH and UCSRC:  writes with URSEL set go to UCSRC.
+#if defined(UCSR0A)
+#define CSRA_0      UCSR0A
+#define CSRB_0      UCSR0B
+#define CSRC_0      UCSR0C
+#define DR_0        UDR0
+#define BRRL_0      UBRR0L
+#define BRRH_0      UBRR0H
+#define URSEL_0     0
+#if defined(USART0_RX_vect)
+#define RX_VECT_0   USART0_RX_vect
+#define UDRE_VECT_0 USART0_UDRE_vect
+#else
+#define RX_VECT_0   USART_RX_vect
+#define UDRE_VECT_0 USART_UDRE_vect
+#endif
+#elif defined(UCSRA)
+#define CSRA_0      UCSRA
+#define CSRB_0      UCSRB
+#define CSRC_0      UCSRC
+#define DR_0        UDR
+#define BRRL_0      UBRRL
+#define BRRH_0      UBRRH
+#define URSEL_0     0x80
+#define RX_VECT_0   USART_RXC_vect
+#define UDRE_VECT_0 USART_UDRE_vect
+#endif
+
+#if SERIAL_PORTS > 1
+#define CSRA_1      UCSR1A
+#define CSRB_1      UCSR1B
+#define CSRC_1      UCSR1C
+#define DR_1        UDR1
+#define BRRL_1      UBRR1L
+#define BRRH_1      UBRR1H
+#define URSEL_1     0
+#define RX_VECT_1   USART1_RX_vect
+#define UDRE_VECT_1 USART1_UDRE_vect
+#define REG(idx, r) (*((idx) == 0 ? &r##_0 : &r##_1))
+#define SEL(idx)    ((idx) == 0 ? URSEL_0 : URSEL_1)
+#else
+#define REG(idx, r) (r##_0)
+#define SEL(idx)    (URSEL_0)
+#endif
+
+#if SERIAL_PORTS > 0
+
+//////////////////////////////////////////////////////////////////////////////
+/// @struct port
+/// @brief Rings and counters of one USART.
+/// @remark The ISRs only write rx_head, tx_tail, the counters and
+///   status.  The main loop only writes rx_tail and tx_head.  The blk_
+///   fields are set with interrupts off, then only the ISR moves them.
+//////////////////////////////////////////////////////////////////////////////
+typedef struct port
+{
+  uint8_t rx[SERIAL_RX_BUFFER_SIZE];
+  uint8_t tx[SERIAL_TX_BUFFER_SIZE];
+  volatile uint8_t rx_head;             // next free, ISR
+  volatile uint8_t rx_tail;             // next to read, SERIAL_read
+  volatile uint8_t tx_head;             // next free, SERIAL_write
+  volatile uint8_t tx_tail;             // next to send, ISR
+  volatile uint8_t status;              // SERIAL_STATUS_ bits
+  uint8_t nine;                         // 9 bit words
+  // Bit 8 of each word, only used with 9 bit words
+  uint8_t rx9[(SERIAL_RX_BUFFER_SIZE + 7) / 8];
+  uint8_t tx9[(SERIAL_TX_BUFFER_SIZE + 7) / 8];
+  serial_stats_t stats;
+  // Block from SERIAL_write_buffer, sent when tx_tail reaches blk_at
+  const uint8_t *blk;
+  volatile uint16_t blk_len;            // zero when there is none
+  uint8_t blk_at;
+  uint8_t blk_flash;                    // blk is in PROGMEM
+  serial_callback_t blk_done;
+} port_t;
+
+static port_t ports[SERIAL_PORTS];
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn rx_isr
+/// @brief STATIC Receive complete:  moves the word into the ring.
+/// @remark Inlined into each port's ISR with constant registers.  The
+///   error flags and bit 8 have to be read before UDR.
+//////////////////////////////////////////////////////////////////////////////
+static inline void rx_isr(port_t *p, volatile uint8_t *csra,
+                          volatile uint8_t *csrb, volatile uint8_t *dr)
+{
+  uint8_t st = *csra;
+  uint8_t b8 = *csrb & (1 << RXB8);
+  uint8_t b = *dr;
+  if(st & ((1 << FE) | (1 << DOR) | (1 << UPE)))
+  {
+    if(st & (1 << DOR))
+    {
+      p->stats.overruns++;
+      p->status |= SERIAL_STATUS_OVERRUN;
+    }
+    if(st & (1 << FE))
+    {
+      p->stats.frame_errors++;
+      p->status |= SERIAL_STATUS_FRAME;
+    }
+    if(st & (1 << UPE))
+    {
+      p->stats.parity_errors++;
+      p->status |= SERIAL_STATUS_PARITY;
+    }
+  }
+  uint8_t h = p->rx_head;
+  uint8_t next = (h + 1) & RX_MASK;
+  if(next != p->rx_tail)
+  {
+    p->rx[h] = b;
+    if(p->nine)
+    {
+      uint8_t bit = 1 << (h & 0x07);
+      if(b8)
+      {
+        p->rx9[h >> 3] |= bit;
+      }
+      else
+      {
+        p->rx9[h >> 3] &= ~bit;
+      }
+    }
+    p->rx_head = next;
+  }
+  else
+  {
+    p->stats.dropped++;
+    p->status |= SERIAL_STATUS_RX_FULL;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn udre_isr
+/// @brief STATIC Data register empty:  sends the next word, or turns the
+///   interrupt off when the ring is empty and no block is left.
+//////////////////////////////////////////////////////////////////////////////
+static inline void udre_isr(port_t *p, uint8_t idx, volatile uint8_t *csrb,
+                            volatile uint8_t *dr)
+{
+  uint8_t t = p->tx_tail;
+  if(p->blk_len != 0 && t == p->blk_at)
+  {
+    if(p->nine)
+    {
+      *csrb &= ~(1 << TXB8);
+    }
+    *dr = p->blk_flash ? pgm_read_byte(p->blk) : *p->blk;
+    p->blk++;
+    if(--p->blk_len == 0 && p->blk_done != NULL)
+    {
+      p->blk_done(idx);         // may queue another block
+    }
+  }
+  else if(t != p->tx_head)
+  {
+    if(p->nine)
+    {
+      if(p->tx9[t >> 3] & (1 << (t & 0x07)))
+      {
+        *csrb |= (1 << TXB8);
+      }
+      else
+      {
+        *csrb &= ~(1 << TXB8);
+      }
+    }
+    *dr = p->tx[t];
+    t = (t + 1) & TX_MASK;
+    p->tx_tail = t;
+  }
+  if(t == p->tx_head && p->blk_len == 0)
+  {
+    *csrb &= ~(1 << UDRIE);
+  }
+}
+
+ISR(RX_VECT_0)
+{
+  rx_isr(&ports[0], &CSRA_0, &CSRB_0, &DR_0);
+}
+
+ISR(UDRE_VECT_0)
+{
+  udre_isr(&ports[0], 0, &CSRB_0, &DR_0);
+}
+
+#if SERIAL_PORTS > 1
+ISR(RX_VECT_1)
+{
+  rx_isr(&ports[1], &CSRA_1, &CSRB_1, &DR_1);
+}
+
+ISR(UDRE_VECT_1)
+{
+  udre_isr(&ports[1], 1, &CSRB_1, &DR_1);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn baud_error
+/// @brief STATIC Runtime SERIAL_UBRR and SERIAL_ERROR.
+/// @param[in]  bps   Bits per second, not 0
+/// @param[in]  u2x   1 for double speed
+/// @param[out] ubrr  Baud rate register
+/// @return Error in tenths of a percent, 1000 if UBRR is out of range.
+//////////////////////////////////////////////////////////////////////////////
+static uint16_t baud_error(uint32_t bps, uint8_t u2x, uint16_t *ubrr)
+{
+  uint16_t rtn = 1000;
+  uint32_t clocks = (16UL >> u2x) * bps;
+  uint32_t div = (F_CPU + clocks / 2) / clocks;
+  if(div == 0)
+  {
+    div = 1;
+  }
+  if(div <= 4096)
+  {
+    uint32_t rate = F_CPU / ((16UL >> u2x) * div);
+    uint32_t off = (rate > bps) ? rate - bps : bps - rate;
+    uint32_t err = (off * 1000 + bps / 2) / bps;
+    rtn = (err < 1000) ? (uint16_t)err : 1000;
+    *ubrr = (uint16_t)(div - 1);
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @function SERIAL_init
+/// @brief Initialize hardware serial port.
+/// @param[in]  idx Index of serial port number (0 if only one.)
+/// @param[in]  bps Bits per second
+/// @param[in]  parity Indicates type of parity: E,O,N
+/// @param[in]  stop  Number of stop bits (1 or 2)
+/// @param[in]  bits  Number of bits in word (5 to 9)
+/// @return Zero on success, -1 if an argument is out of range or bps is
+///   more than SERIAL_BAUD_TOLERANCE off.
+/////////////////////////////////////////////////////////////////////////////
+int SERIAL_init(uint8_t idx, uint32_t bps, char parity, uint8_t stop, uint8_t bits)
+{
+  int rtn = -1;
+  if(bps != 0)
+  {
+    uint16_t ubrr = 0;
+    uint16_t ubrr2 = 0;
+    uint16_t err = baud_error(bps, 0, &ubrr);
+    uint16_t err2 = baud_error(bps, 1, &ubrr2);
+    uint8_t u2x = 0;
+    if(err2 < err)              // ties keep normal speed, it samples more
+    {
+      err = err2;
+      ubrr = ubrr2;
+      u2x = 1;
+    }
+    if(err <= SERIAL_BAUD_TOLERANCE)
+    {
+      rtn = SERIAL_init_ubrr(idx, ubrr, u2x, parity, stop, bits);
+    }
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_init_ubrr
+/// @brief SERIAL_init with the baud rate register already worked out.
+/// @param[in]  idx   Port
+/// @param[in]  ubrr  Baud rate register, 0 to 4095
+/// @param[in]  u2x   1 for double speed
+/// @param[in]  parity, stop, bits  As SERIAL_init
+/// @return Zero on success, -1 if an argument is out of range.
+//////////////////////////////////////////////////////////////////////////////
+int SERIAL_init_ubrr(uint8_t idx, uint16_t ubrr, uint8_t u2x, char parity,
+                     uint8_t stop, uint8_t bits)
+{
+  int rtn = -1;
+  uint8_t pm = 0xff;
+  if(parity == 'N' || parity == 'n')
+  {
+    pm = 0;
+  }
+  else if(parity == 'E' || parity == 'e')
+  {
+    pm = (1 << UPM1);
+  }
+  else if(parity == 'O' || parity == 'o')
+  {
+    pm = (1 << UPM1) | (1 << UPM0);
+  }
+  if(idx < SERIAL_PORTS && pm != 0xff && (stop == 1 || stop == 2)
+     && bits >= 5 && bits <= 9 && ubrr <= 4095)
+  {
+    port_t *p = &ports[idx];
+    REG(idx, CSRB) = 0;         // quiet while the rings are reset
+    p->rx_head = 0;
+    p->rx_tail = 0;
+    p->tx_head = 0;
+    p->tx_tail = 0;
+    p->blk_len = 0;
+    p->status = 0;
+    p->nine = (bits == 9);
+    SERIAL_clear_stats(idx);
+
+    REG(idx, BRRH) = (uint8_t)(ubrr >> 8);
+    REG(idx, BRRL) = (uint8_t)ubrr;
+    REG(idx, CSRA) = u2x ? (1 << U2X) : 0;
+    // UCSZ 0 to 3 for 5 to 8 bits, 7 with UCSZ2 for 9
+    uint8_t size = (bits == 9) ? 3 : bits - 5;
+    REG(idx, CSRC) = SEL(idx) | pm | ((stop == 2) ? (1 << USBS) : 0)
+                     | (size << UCSZ0);
+    REG(idx, CSRB) = (1 << RXCIE) | (1 << RXEN) | (1 << TXEN)
+                     | ((bits == 9) ? (1 << UCSZ2) : 0);
+    rtn = 0;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_write
+/// @brief Queues a word to send.
+/// @param[in]  idx   Port
+/// @param[in]  data  Word, bit 8 used with 9 bit words
+/// @return The word, or -1 if the transmit ring is full.
+//////////////////////////////////////////////////////////////////////////////
+int SERIAL_write(uint8_t idx, int data)
+{
+  int rtn = -1;
+  if(idx < SERIAL_PORTS)
+  {
+    port_t *p = &ports[idx];
+    uint8_t h = p->tx_head;
+    uint8_t next = (h + 1) & TX_MASK;
+    if(next != p->tx_tail)
+    {
+      p->tx[h] = (uint8_t)data;
+      rtn = data & 0xff;
+      if(p->nine)
+      {
+        uint8_t bit = 1 << (h & 0x07);
+        if(data & 0x100)
+        {
+          p->tx9[h >> 3] |= bit;
+          rtn |= 0x100;
+        }
+        else
+        {
+          p->tx9[h >> 3] &= ~bit;
+        }
+      }
+      p->tx_head = next;
+      // The ISR changes TXB8 in the same register for 9 bit words.  An
+      // ISR between the read and the write here would have it put back.
+      uint8_t sreg = SREG;
+      cli();
+      REG(idx, CSRB) |= (1 << UDRIE);
+      SREG = sreg;
+    }
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn write_block
+/// @brief STATIC Queues a block for the ISR.
+/// @param[in]  flash  Nonzero if buf is in PROGMEM
+/// @return Zero, or -1 if a block is still going or len is out of range.
+//////////////////////////////////////////////////////////////////////////////
+static int write_block(uint8_t idx, const uint8_t *buf, uint16_t len,
+                       uint8_t flash, serial_callback_t done)
+{
+  int rtn = -1;
+  if(idx < SERIAL_PORTS && len != 0 && len <= SERIAL_BLOCK_MAX)
+  {
+    port_t *p = &ports[idx];
+    uint8_t sreg = SREG;
+    cli();
+    if(p->blk_len == 0)
+    {
+      p->blk = buf;
+      p->blk_flash = flash;
+      p->blk_done = done;
+      p->blk_at = p->tx_head;
+      p->blk_len = len;
+      REG(idx, CSRB) |= (1 << UDRIE);
+      rtn = 0;
+    }
+    SREG = sreg;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_write_buffer
+/// @brief Sends a block straight from the caller's memory.
+/// @param[in]  idx   Port
+/// @param[in]  buf   Bytes to send.  Leave them alone until done runs.
+/// @param[in]  len   Number of bytes, 1 to SERIAL_BLOCK_MAX
+/// @param[in]  done  Called from the ISR once the last byte is in the
+///                   USART, can be NULL.  It may start the next block.
+/// @return Zero, or -1 if a block is still going or len is out of range.
+//////////////////////////////////////////////////////////////////////////////
+int SERIAL_write_buffer(uint8_t idx, const uint8_t *buf, uint16_t len,
+                        serial_callback_t done)
+{
+  return write_block(idx, buf, len, 0, done);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_write_buffer_P
+/// @brief SERIAL_write_buffer for a block in PROGMEM.
+//////////////////////////////////////////////////////////////////////////////
+int SERIAL_write_buffer_P(uint8_t idx, const uint8_t *buf, uint16_t len,
+                          serial_callback_t done)
+{
+  return write_block(idx, buf, len, 1, done);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_read
+/// @brief Takes the oldest received word.
+/// @param[in]  idx   Port
+/// @return The word, or -1 if nothing has arrived.
+//////////////////////////////////////////////////////////////////////////////
+int SERIAL_read(uint8_t idx)
+{
+  int rtn = -1;
+  if(idx < SERIAL_PORTS)
+  {
+    port_t *p = &ports[idx];
+    uint8_t t = p->rx_tail;
+    if(t != p->rx_head)
+    {
+      rtn = p->rx[t];
+      if(p->nine && (p->rx9[t >> 3] & (1 << (t & 0x07))))
+      {
+        rtn |= 0x100;
+      }
+      p->rx_tail = (t + 1) & RX_MASK;
+    }
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_received
+/// @brief Counts words waiting to be read.
+/// @param[in]  idx   Port
+/// @return Words in the receive ring, -1 for a bad port.
+//////////////////////////////////////////////////////////////////////////////
+int SERIAL_received(uint8_t idx)
+{
+  int rtn = -1;
+  if(idx < SERIAL_PORTS)
+  {
+    rtn = (ports[idx].rx_head - ports[idx].rx_tail) & RX_MASK;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_sending
+/// @brief Counts words not yet handed to the USART.
+/// @param[in]  idx   Port
+/// @return Words in the transmit ring plus what is left of a block, -1
+///   for a bad port.
+//////////////////////////////////////////////////////////////////////////////
+int SERIAL_sending(uint8_t idx)
+{
+  int rtn = -1;
+  if(idx < SERIAL_PORTS)
+  {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t left = ports[idx].blk_len;
+    SREG = sreg;
+    rtn = ((ports[idx].tx_head - ports[idx].tx_tail) & TX_MASK) + left;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_status
+/// @brief Reports receive errors since the last call, then clears them.
+/// @param[in]  idx   Port
+/// @return SERIAL_STATUS_ bits, -1 for a bad port.
+//////////////////////////////////////////////////////////////////////////////
+int SERIAL_status(uint8_t idx)
+{
+  int rtn = -1;
+  if(idx < SERIAL_PORTS)
+  {
+    uint8_t sreg = SREG;
+    cli();
+    rtn = ports[idx].status;
+    ports[idx].status = 0;
+    SREG = sreg;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_get_stats
+/// @brief Copies the error counters.
+/// @param[in]  idx    Port
+/// @param[out] stats  Where to put them.
+//////////////////////////////////////////////////////////////////////////////
+void SERIAL_get_stats(uint8_t idx, serial_stats_t *stats)
+{
+  if(idx < SERIAL_PORTS)
+  {
+    uint8_t sreg = SREG;
+    cli();
+    *stats = ports[idx].stats;
+    SREG = sreg;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_clear_stats
+/// @brief Zeroes the error counters.
+/// @param[in]  idx    Port
+//////////////////////////////////////////////////////////////////////////////
+void SERIAL_clear_stats(uint8_t idx)
+{
+  if(idx < SERIAL_PORTS)
+  {
+    uint8_t sreg = SREG;
+    cli();
+    ports[idx].stats.overruns = 0;
+    ports[idx].stats.frame_errors = 0;
+    ports[idx].stats.parity_errors = 0;
+    ports[idx].stats.dropped = 0;
+    SREG = sreg;
+  }
+}
+
+#endif  // SERIAL_PORTS > 0
@@ -9,7 +9,7 @@
 //////////////////////////////////////////////////////////////////////////////
 
 #ifndef SERIAL_H
-#define SERIALS_H
+#define SERIAL_H
 
 #ifdef __cplusplus
 extern "C"
@@ -19,45 +19,197 @@ extern "C"
   #include <stdint.h>
   #include <avr/interrupt.h>
   #include <avr/io.h>
-  
+
 #include "config.h"
 #include "gpio.h"
 
 #define SERIAL_VERSION_MAJOR     0
-#define SERIAL_VERSION_MINOR     1
+#define SERIAL_VERSION_MINOR     4
 #define SERIAL_VERSION_BUILD     0
-#define SERIAL_VERSION_DATE      (20230608L)
+#define SERIAL_VERSION_DATE      (20230705L)
+
+  // USARTs on this part.  The ATmega8 and the 48/88/168/328 have one,
+  // the 164P/324P/644P/1284P two.
+#if defined(UCSR1A)
+#define SERIAL_PORTS             2
+#elif defined(UCSR0A) || defined(UCSRA)
+#define SERIAL_PORTS             1
+#else
+#define SERIAL_PORTS             0
+#endif
+
+  // Baud rate solver, all constant expressions for a constant bps.  u2x
+  // is 0 for normal speed, 16 clocks a bit, or 1 for double, 8 clocks.
+  // Divisor UBRR + 1, rounded, at least 1
+#define SERIAL_DIV_(bps, u2x) \
+  ((F_CPU + (8UL >> (u2x)) * (bps)) / ((16UL >> (u2x)) * (bps)) > 0 \
+   ? (F_CPU + (8UL >> (u2x)) * (bps)) / ((16UL >> (u2x)) * (bps)) : 1)
+#define SERIAL_RATE_(bps, u2x) \
+  (F_CPU / ((16UL >> (u2x)) * SERIAL_DIV_(bps, u2x)))
+#define SERIAL_UBRR(bps, u2x)    (SERIAL_DIV_(bps, u2x) - 1)
+  // Error of the rate that comes out, tenths of a percent, rounded.
+  // 1000 if UBRR does not fit its 12 bits.
+#define SERIAL_ERROR(bps, u2x) \
+  (SERIAL_DIV_(bps, u2x) > 4096 ? 1000UL \
+   : ((SERIAL_RATE_(bps, u2x) > (bps) ? SERIAL_RATE_(bps, u2x) - (bps) \
+       : (bps) - SERIAL_RATE_(bps, u2x)) * 1000 + (bps) / 2) / (bps))
+  // Double speed only if it is closer:  normal speed samples more
+#define SERIAL_U2X(bps) \
+  (SERIAL_ERROR(bps, 1) < SERIAL_ERROR(bps, 0) ? 1 : 0)
+
+//////////////////////////////////////////////////////////////////////////////
+/// @def SERIAL_INIT
+/// @brief SERIAL_init for a constant rate, worked out by the compiler.
+/// @remark Fails to build if the rate is more than SERIAL_BAUD_TOLERANCE
+///   off at this F_CPU.  Leaves no divide in the program.
+//////////////////////////////////////////////////////////////////////////////
+#define SERIAL_INIT(idx, bps, parity, stop, bits) \
+  ((void)sizeof(struct { \
+     _Static_assert(SERIAL_ERROR(bps, SERIAL_U2X(bps)) \
+                    <= SERIAL_BAUD_TOLERANCE, \
+                    "Baud rate too far off at this F_CPU"); \
+     char c; }), \
+   SERIAL_init_ubrr((idx), SERIAL_UBRR(bps, SERIAL_U2X(bps)), \
+                    SERIAL_U2X(bps), (parity), (stop), (bits)))
+
+  // Bits returned by SERIAL_status
+#define SERIAL_STATUS_OVERRUN    0x01   // USART lost a byte:  ISR too late
+#define SERIAL_STATUS_FRAME      0x02   // stop bit was low
+#define SERIAL_STATUS_PARITY     0x04
+#define SERIAL_STATUS_RX_FULL    0x08   // receive ring full, byte dropped
 
+  // Longest block for SERIAL_write_buffer, so SERIAL_sending fits an int
+#define SERIAL_BLOCK_MAX         0x7f00
+
+  // Called from the transmit ISR when a block has been handed over
+  typedef void (*serial_callback_t)(uint8_t idx);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @struct serial_stats
+/// @brief Error counters since SERIAL_init or SERIAL_clear_stats.
+//////////////////////////////////////////////////////////////////////////////
+  typedef struct serial_stats
+  {
+    uint16_t  overruns;       // Data overrun flags seen
+    uint16_t  frame_errors;   // Bytes with a bad stop bit
+    uint16_t  parity_errors;  // Bytes with bad parity
+    uint16_t  dropped;        // Bytes lost because the receive ring was full
+  } serial_stats_t;
 
-  
-  //static button_t btns[NUMBER_OF_BUTTONS];
-  // static uint8_t pressed[99];   //FIFO of pressed buttons (press and release?) TODO
-  //static uint8_t fifo[BUTTONS_FIFO_SIZE];
-  
 //////////////////////////////////////////////////////////////////////////////
 /// @function SERIAL_init
 /// @brief Initialize hardware serial port.
 /// @param[in]  idx Index of serial port number (0 if only one.)
 /// @param[in]  bps Bits per second
-/// @param[in]  parity Indicates type of parity: E,O,N,0,1
+/// @param[in]  parity Indicates type of parity: E,O,N
 /// @param[in]  stop  Number of stop bits (1 or 2)
 /// @param[in]  bits  Number of bits in word (5 to 9)
-///
-/// @return
+/// @remark Empties both rings and turns on the receive interrupt.
+///   Interrupts must be on for anything to move.  Uses double speed when
+///   that gets closer to bps.  SERIAL_INIT does the same sums at compile
+///   time for a constant rate.
+///   At 1 Mbaud on 16 MHz a frame is 160 cycles:  enough to receive or
+///   to send at line rate, one direction at a time, but not to echo every
+///   byte back, which drops some.  Echo holds up at 500 kbaud.  These are
+///   estimates from host/serial_bench against a model, not measured on a
+///   part.
+/// @return Zero on success, -1 if an argument is out of range or bps is
+///   more than SERIAL_BAUD_TOLERANCE off.
 /////////////////////////////////////////////////////////////////////////////
 int SERIAL_init(uint8_t idx, uint32_t bps, char parity, uint8_t stop, uint8_t bits);
 
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_init_ubrr
+/// @brief SERIAL_init with the baud rate register already worked out.
+/// @param[in]  idx   Port
+/// @param[in]  ubrr  Baud rate register, 0 to 4095
+/// @param[in]  u2x   1 for double speed
+/// @param[in]  parity, stop, bits  As SERIAL_init
+/// @return Zero on success, -1 if an argument is out of range.
+//////////////////////////////////////////////////////////////////////////////
+  int SERIAL_init_ubrr(uint8_t idx, uint16_t ubrr, uint8_t u2x, char parity,
+                       uint8_t stop, uint8_t bits);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_write
+/// @brief Queues a word to send.
+/// @param[in]  idx   Port
+/// @param[in]  data  Word, bit 8 used with 9 bit words
+/// @return The word, or -1 if the transmit ring is full.
+//////////////////////////////////////////////////////////////////////////////
   int SERIAL_write(uint8_t idx, int data);
 
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_write_buffer
+/// @brief Sends a block straight from the caller's memory.
+/// @param[in]  idx   Port
+/// @param[in]  buf   Bytes to send.  Leave them alone until done runs.
+/// @param[in]  len   Number of bytes, 1 to SERIAL_BLOCK_MAX
+/// @param[in]  done  Called from the ISR once the last byte is in the
+///                   USART, can be NULL.  It may start the next block.
+/// @remark The block goes out after the words already written and before
+///   any written after this call, which wait in the ring.  One block per
+///   port at a time.  With 9 bit words bit 8 is sent as 0.
+/// @return Zero, or -1 if a block is still going or len is out of range.
+//////////////////////////////////////////////////////////////////////////////
+  int SERIAL_write_buffer(uint8_t idx, const uint8_t *buf, uint16_t len,
+                          serial_callback_t done);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_write_buffer_P
+/// @brief SERIAL_write_buffer for a block in PROGMEM.
+//////////////////////////////////////////////////////////////////////////////
+  int SERIAL_write_buffer_P(uint8_t idx, const uint8_t *buf, uint16_t len,
+                            serial_callback_t done);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_read
+/// @brief Takes the oldest received word.
+/// @param[in]  idx   Port
+/// @return The word, or -1 if nothing has arrived.
+//////////////////////////////////////////////////////////////////////////////
   int SERIAL_read(uint8_t idx);
 
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_received
+/// @brief Counts words waiting to be read.
+/// @param[in]  idx   Port
+/// @return Words in the receive ring, -1 for a bad port.
+//////////////////////////////////////////////////////////////////////////////
   int SERIAL_received(uint8_t idx);
 
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_sending
+/// @brief Counts words not yet handed to the USART.
+/// @param[in]  idx   Port
+/// @return Words in the transmit ring plus what is left of a block, -1
+///   for a bad port.
+//////////////////////////////////////////////////////////////////////////////
   int SERIAL_sending(uint8_t idx);
 
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_status
+/// @brief Reports receive errors since the last call, then clears them.
+/// @param[in]  idx   Port
+/// @return SERIAL_STATUS_ bits, -1 for a bad port.
+//////////////////////////////////////////////////////////////////////////////
   int SERIAL_status(uint8_t idx);
 
-  
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_get_stats
+/// @brief Copies the error counters.
+/// @param[in]  idx    Port
+/// @param[out] stats  Where to put them.
+//////////////////////////////////////////////////////////////////////////////
+  void SERIAL_get_stats(uint8_t idx, serial_stats_t *stats);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SERIAL_clear_stats
+/// @brief Zeroes the error counters.
+/// @param[in]  idx    Port
+//////////////////////////////////////////////////////////////////////////////
+  void SERIAL_clear_stats(uint8_t idx);
+
 #ifdef __cplusplus
 }
 #endif  // __cplusplus
@@ -17,31 +17,595 @@ extern "C"
 #warning Remove extra brace from extern "C" in softspi.c line 14
 
 #include <stdint.h>
+#include <stddef.h>   // for NULL, offsetof
 #include "config.h"
 #include <avr/io.h>
   
 //#include "avrlib_config.h"
 #include <util/delay_basic.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include "gpio.h"
 #include "softspi.h"
+#include "spi.h"
+#include "spi_usart.h"
+#include "spi_usi.h"
   
 
 static uint8_t sclk_pin;
-static int8_t mosi_pin;
-static int8_t miso_pin;
+static uint8_t mosi_pin;   // GPIO_PIN_NONE (or -1) if not used
+static uint8_t miso_pin;   // GPIO_PIN_NONE (or -1) if not used
+
+// Port registers and masks for the bus pins, found once at init so the
+// kernels can skip GPIO_write_pin.  Unused MOSI writes go to sink and
+// unused MISO reads come from sink, so the kernels never test for them.
+static volatile uint8_t sink = 0;
+static volatile uint8_t *sclk_port = &sink;
+static uint8_t sclk_mask = 0;
+static volatile uint8_t *mosi_port = &sink;
+static uint8_t mosi_mask = 0;
+static volatile uint8_t *miso_port = &sink;
+static uint8_t miso_mask = 0;
+
+// Without a MISO pin the write-only kernels are built instead.
+#define DUPLEX   (SOFTSPI_MISO != GPIO_PIN_NONE)
+
+#ifdef SOFTSPI_LANE_PINS
+// Extra MOSI pins for multi-lane writes, all on one port.
+static const uint8_t lane_pins[] = { SOFTSPI_LANE_PINS };
+#define NUMBER_LANES  ( sizeof(lane_pins) / sizeof(lane_pins[0]) )
+static uint8_t lane_masks[NUMBER_LANES];
+static uint8_t lane_all = 0;               // every lane bit, 0 if unusable
+static volatile uint8_t *lane_port = &sink;
+#endif
   
-typedef struct softspi
+// The interface table lives in flash (softspi_desc_t in softspi.h).
+// Only what init works out is kept in RAM.
+typedef struct softspi_state
 {
-  uint32_t        bits_per_second;  // Max speed in bps, 0 fast as possible.
-  int8_t          ss_pin;    // Slave Select Pin, -1 if not used
-  uint8_t         delay_ticks;  // Optional delay between bits: calc from bps.
-  softspi_mode_t  mode;      // Clock phase and polarity
-  uint8_t         bits;      // How many bits to transfer per cycle
-} softspi_t;
+  uint8_t         backend;   // softspi_backend_t chosen at init
+  uint16_t        clock;     // SPR/SPI2X, UBRR or USI delay for hardware,
+                             // _delay_loop_2 count per half bit for soft
+#ifdef SOFTSPI_LANE_PINS
+  uint16_t        lanes;     // _delay_loop_2 count per half bit, lanes
+#endif
+} softspi_state_t;
 
-//  static softspi_t spis[ SOFTSPI_INTERFACES];
-static softspi_t spis[] = { SOFTSPI_INTERFACES };
+static const softspi_desc_t spis[] PROGMEM = { SOFTSPI_INTERFACES };
 #define NUMBER_INTERFACES  ( sizeof(spis) / sizeof(spis[0]) )
+static softspi_state_t state[NUMBER_INTERFACES];
+
+#ifdef SOFTSPI_CHAINS
+// Shadow copy of every device on every chain.  SOFTSPI_CHAINS is
+// expanded twice:  here as one array per chain, named for its
+// interface, then below as the chain table with each array's offset.
+#define SOFTSPI_CHAIN(idx, len, bytes)   chain_##idx[(len) * (bytes)]
+static struct chain_shadow
+{
+  uint8_t SOFTSPI_CHAINS;
+} shadow;
+#undef SOFTSPI_CHAIN
+
+typedef struct softspi_chain
+{
+  uint8_t         idx;       // Interface the chain hangs off
+  uint8_t         len;       // Devices on the chain
+  uint8_t         bytes;     // Bytes per device
+  uint16_t        offset;    // Start of the chain in shadow
+} softspi_chain_t;
+
+#define SOFTSPI_CHAIN(idx, len, bytes)                                \
+  { (idx), (len), (bytes), offsetof(struct chain_shadow, chain_##idx) }
+static const softspi_chain_t chains[] PROGMEM = { SOFTSPI_CHAINS };
+#undef SOFTSPI_CHAIN
+#define NUMBER_CHAINS  ( sizeof(chains) / sizeof(chains[0]) )
+static uint8_t chain_dirty[NUMBER_CHAINS];
+#endif
+
+// Reads of the flash table
+#define DESC_BYTE(idx, field)   pgm_read_byte(&spis[idx].field)
+#define DESC_WORD(idx, field)   pgm_read_word(&spis[idx].field)
+#define DESC_DWORD(idx, field)  pgm_read_dword(&spis[idx].field)
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn write_ss
+/// @brief STATIC Drives an interface's slave select straight on its port.
+/// @param[in] idx  Interface index
+/// @param[in] val  Level, zero selects
+//////////////////////////////////////////////////////////////////////////////
+static inline void write_ss(uint8_t idx, uint8_t val)
+{
+  volatile uint8_t *port = (volatile uint8_t *)pgm_read_ptr(&spis[idx].ss_port);
+  uint8_t mask = DESC_BYTE(idx, ss_mask);
+  if(port != NULL)
+  {
+    if(val) *port |= mask; else *port &= ~mask;
+  }
+}
+
+// The kernels are timed with a 16 bit timer 1.  Parts without one,
+// such as the ATtiny85, keep the table's delays and measure nothing.
+#if defined(TCCR1A) && defined(TCNT1)
+#define SOFTSPI_TIMER1 1
+#if defined(TIFR1)
+#define TIMER1_FLAGS   TIFR1
+#else
+#define TIMER1_FLAGS   TIFR
+#endif
+#else
+#define SOFTSPI_TIMER1 0
+#endif
+
+static void calibrate(uint8_t idx);
+#ifdef SOFTSPI_LANE_PINS
+static void calibrate_lanes(uint8_t idx);
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn resolve_ports
+/// @brief STATIC Looks up port registers and masks for the bus pins.
+//////////////////////////////////////////////////////////////////////////////
+static void resolve_ports(void)
+{
+  volatile uint8_t *reg;
+
+  reg = GPIO_output_register(sclk_pin);
+  sclk_port = reg ? reg : &sink;
+  sclk_mask = GPIO_PIN_MASK(sclk_pin);
+  reg = GPIO_output_register(mosi_pin);
+  mosi_port = reg ? reg : &sink;
+  mosi_mask = GPIO_PIN_MASK(mosi_pin);
+  reg = GPIO_input_register(miso_pin);
+  miso_port = reg ? reg : &sink;
+  miso_mask = reg ? GPIO_PIN_MASK(miso_pin) : 0;
+}
+
+// Top bit of an n bit byte, for shift_byte
+static const uint8_t top_bit[9] PROGMEM =
+  { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn shift_byte
+/// @brief STATIC Bit-bang kernel for up to 8 bits, all in 8-bit registers.
+/// @param[in] out   Data (in low bits) to write
+/// @param[in] n     Number of bits, 1 to 8
+/// @param[in] mode  Constant mode so the tests below fold away
+/// @param[in] dly   _delay_loop_2 count for each half bit, _SLOW modes
+/// @return Bits read, aligned to the low bits
+/// @remark A mask walks the bits, so every bit costs the same whatever n
+///   is and a bit is timed by running 2 and 1 of them.
+///   Leading-edge modes set MOSI, make the leading edge, then
+///   sample.  Trailing-edge modes make the leading edge, set MOSI, make
+///   the trailing edge, then sample.  Either way MISO is read just after
+///   the edge the slave expects us to sample on.  The _SLOW modes wait
+///   dly once with the clock idle and once with it active, so SCLK
+///   runs near 50% duty whatever the rate.
+//////////////////////////////////////////////////////////////////////////////
+static inline uint8_t shift_byte(uint8_t out, uint8_t n,
+                                 const uint8_t mode, uint16_t dly)
+  __attribute__((always_inline));
+static inline uint8_t shift_byte(uint8_t out, uint8_t n,
+                                 const uint8_t mode, uint16_t dly)
+{
+  // mode is  [ slow | cpol | cpha | lsb first ]
+  const uint8_t lsb = mode & 0x01;
+  const uint8_t cpha = mode & 0x02;
+  const uint8_t cpol = mode & 0x04;
+  const uint8_t slow = mode & 0x08;
+  volatile uint8_t *clk = sclk_port;
+  volatile uint8_t *mosi = mosi_port;
+  volatile uint8_t *miso = miso_port;
+  const uint8_t cm = sclk_mask;
+  const uint8_t om = mosi_mask;
+  const uint8_t im = miso_mask;
+  uint8_t rtn = 0;
+  // First bit out, and where the first bit in goes
+  uint8_t m = lsb ? 0x01 : pgm_read_byte(&top_bit[n]);
+
+  for(uint8_t b = n; b > 0; b--)
+  {
+    uint8_t bit = out & m;
+    uint8_t in = 0;
+
+    if(cpha)
+    {
+      if(cpol) *clk &= ~cm; else *clk |= cm;      // leading edge
+    }
+    if(bit) *mosi |= om; else *mosi &= ~om;
+    if(slow)
+    {
+      _delay_loop_2(dly);                         // first half
+    }
+    if(!cpha)
+    {
+      if(cpol) *clk &= ~cm; else *clk |= cm;      // leading edge
+      if(DUPLEX)
+      {
+        in = *miso & im;
+      }
+      if(slow)
+      {
+        _delay_loop_2(dly);                       // second half
+      }
+      if(cpol) *clk |= cm; else *clk &= ~cm;      // trailing edge
+    }
+    else
+    {
+      if(cpol) *clk |= cm; else *clk &= ~cm;      // trailing edge
+      if(DUPLEX)
+      {
+        in = *miso & im;
+      }
+      if(slow)
+      {
+        _delay_loop_2(dly);                       // second half
+      }
+    }
+
+    if(DUPLEX && in)
+    {
+      rtn |= m;
+    }
+    if(lsb)
+    {
+      m <<= 1;
+    }
+    else
+    {
+      m >>= 1;
+    }
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn shift_bits
+/// @brief STATIC Splits a word into bytes for shift_byte, inlined once per
+///        enabled mode.
+/// @param[in] word  Data (in low bits) to write
+/// @param[in] bits  Number of bits, 1 to 32
+/// @param[in] mode  Constant mode so the tests below fold away
+/// @param[in] dly   _delay_loop_2 count for the _SLOW modes
+/// @return Word read, aligned to the low bits
+/// @remark A word that isn't whole bytes has a short top byte:  it goes
+///   first MSB first and last LSB first.  The bytes are picked out of
+///   the word in memory so nothing wider than 8 bits is ever shifted.
+//////////////////////////////////////////////////////////////////////////////
+static inline uint32_t shift_bits(uint32_t word, uint8_t bits,
+                                  const uint8_t mode, uint16_t dly)
+  __attribute__((always_inline));
+static inline uint32_t shift_bits(uint32_t word, uint8_t bits,
+                                  const uint8_t mode, uint16_t dly)
+{
+  union
+  {
+    uint32_t  w;
+    uint8_t   b[4];            // AVR is little endian:  b[0] is the LSB
+  } out, in;
+  const uint8_t top = bits >> 3;           // index of the short byte
+  const uint8_t rem = bits & 0x07;         // bits in it, 0 if none
+  const uint8_t segs = top + (rem != 0);
+
+  out.w = word;
+  in.w = 0;
+  if(mode & 0x01)
+  {
+    for(uint8_t i = 0; i < segs; i++)
+    {
+      in.b[i] = shift_byte(out.b[i], (i == top) ? rem : 8, mode, dly);
+    }
+  }
+  else
+  {
+    uint8_t n = rem ? rem : 8;
+    for(uint8_t i = segs; i > 0; i--)
+    {
+      in.b[i - 1] = shift_byte(out.b[i - 1], n, mode, dly);
+      n = 8;
+    }
+  }
+  return in.w;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn soft_shift
+/// @brief STATIC Runs the kernel built for mode.  SS is left alone.
+/// @param[in] mode  SPI mode; modes not enabled in config.h do nothing
+/// @param[in] word  Data (in low bits) to write
+/// @param[in] bits  Number of bits, 1 to 32
+/// @param[in] dly   _delay_loop_2 count for the _SLOW modes
+/// @return Word read, 0 if no MISO
+//////////////////////////////////////////////////////////////////////////////
+static uint32_t soft_shift(softspi_mode_t mode, uint32_t word, uint8_t bits,
+                           uint16_t dly)
+{
+  uint32_t rtn = 0;
+  switch(mode)
+  {
+#ifdef SOFTSPI_ENABLE_MODE_0_MSB_FIRST
+  case SPI_MODE_0_MSB_FIRST:
+    rtn = shift_bits(word, bits, SPI_MODE_0_MSB_FIRST, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_0_LSB_FIRST
+  case SPI_MODE_0_LSB_FIRST:
+    rtn = shift_bits(word, bits, SPI_MODE_0_LSB_FIRST, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_1_MSB_FIRST
+  case SPI_MODE_1_MSB_FIRST:
+    rtn = shift_bits(word, bits, SPI_MODE_1_MSB_FIRST, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_1_LSB_FIRST
+  case SPI_MODE_1_LSB_FIRST:
+    rtn = shift_bits(word, bits, SPI_MODE_1_LSB_FIRST, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_2_MSB_FIRST
+  case SPI_MODE_2_MSB_FIRST:
+    rtn = shift_bits(word, bits, SPI_MODE_2_MSB_FIRST, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_2_LSB_FIRST
+  case SPI_MODE_2_LSB_FIRST:
+    rtn = shift_bits(word, bits, SPI_MODE_2_LSB_FIRST, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_3_MSB_FIRST
+  case SPI_MODE_3_MSB_FIRST:
+    rtn = shift_bits(word, bits, SPI_MODE_3_MSB_FIRST, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_3_LSB_FIRST
+  case SPI_MODE_3_LSB_FIRST:
+    rtn = shift_bits(word, bits, SPI_MODE_3_LSB_FIRST, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_0_MSB_FIRST_SLOW
+  case SPI_MODE_0_MSB_FIRST_SLOW:
+    rtn = shift_bits(word, bits, SPI_MODE_0_MSB_FIRST_SLOW, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_0_LSB_FIRST_SLOW
+  case SPI_MODE_0_LSB_FIRST_SLOW:
+    rtn = shift_bits(word, bits, SPI_MODE_0_LSB_FIRST_SLOW, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_1_MSB_FIRST_SLOW
+  case SPI_MODE_1_MSB_FIRST_SLOW:
+    rtn = shift_bits(word, bits, SPI_MODE_1_MSB_FIRST_SLOW, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_1_LSB_FIRST_SLOW
+  case SPI_MODE_1_LSB_FIRST_SLOW:
+    rtn = shift_bits(word, bits, SPI_MODE_1_LSB_FIRST_SLOW, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_2_MSB_FIRST_SLOW
+  case SPI_MODE_2_MSB_FIRST_SLOW:
+    rtn = shift_bits(word, bits, SPI_MODE_2_MSB_FIRST_SLOW, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_2_LSB_FIRST_SLOW
+  case SPI_MODE_2_LSB_FIRST_SLOW:
+    rtn = shift_bits(word, bits, SPI_MODE_2_LSB_FIRST_SLOW, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_3_MSB_FIRST_SLOW
+  case SPI_MODE_3_MSB_FIRST_SLOW:
+    rtn = shift_bits(word, bits, SPI_MODE_3_MSB_FIRST_SLOW, dly);
+    break;
+#endif
+
+#ifdef SOFTSPI_ENABLE_MODE_3_LSB_FIRST_SLOW
+  case SPI_MODE_3_LSB_FIRST_SLOW:
+    rtn = shift_bits(word, bits, SPI_MODE_3_LSB_FIRST_SLOW, dly);
+    break;
+#endif
+
+  default:
+    break;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn choose_backend
+/// @brief STATIC Settles the backend requested in the table.
+/// @param[in] idx Interface index
+/// @remark Hardware backends need whole-byte words and a bps they can
+///   reach.  AUTO and SPI use the SPI peripheral when the bus sits on its
+///   SCK/MOSI pins (MISO on its pin or unused).  AUTO and USI do the same
+///   with the USI on the ATtinys.  USART uses MSPIM on its own pins.
+///   Anything that can't be served is bit-banged.
+//////////////////////////////////////////////////////////////////////////////
+static void choose_backend(uint8_t idx)
+{
+  uint8_t want = DESC_BYTE(idx, backend);
+  uint8_t whole_bytes = (DESC_BYTE(idx, bits) & 0x07) == 0;
+  uint32_t bps = DESC_DWORD(idx, bits_per_second);
+
+  state[idx].backend = SOFTSPI_BACKEND_SOFT;
+  state[idx].clock = DESC_WORD(idx, delay_ticks);
+#if SPI_USART_AVAILABLE
+  if(want == SOFTSPI_BACKEND_USART && whole_bytes)
+  {
+    uint16_t ubrr = SPI_USART_clock_setting(bps);
+    if(ubrr != SPI_USART_CLOCK_NONE)
+    {
+      SPI_USART_init();
+      state[idx].clock = ubrr;
+      state[idx].backend = SOFTSPI_BACKEND_USART;
+    }
+  }
+#endif
+#if SPI_AVAILABLE
+  uint8_t miso = miso_pin;
+  if((want == SOFTSPI_BACKEND_AUTO || want == SOFTSPI_BACKEND_SPI)
+     && whole_bytes && sclk_pin == SPI_SCK && mosi_pin == SPI_MOSI
+     && (miso == SPI_MISO || miso == GPIO_PIN_NONE))
+  {
+    uint8_t clock = SPI_clock_setting(bps);
+    if(clock != SPI_CLOCK_NONE)
+    {
+      SPI_init();
+      state[idx].clock = clock;
+      state[idx].backend = SOFTSPI_BACKEND_SPI;
+    }
+  }
+#endif
+#if SPI_USI_AVAILABLE
+  uint8_t di = miso_pin;
+  if((want == SOFTSPI_BACKEND_AUTO || want == SOFTSPI_BACKEND_USI)
+     && whole_bytes && sclk_pin == SPI_USI_USCK && mosi_pin == SPI_USI_DO
+     && (di == SPI_USI_DI || di == GPIO_PIN_NONE))
+  {
+    uint16_t clock = SPI_USI_clock_setting(bps);
+    if(clock != SPI_USI_CLOCK_NONE)
+    {
+      SPI_USI_init();
+      state[idx].clock = clock;
+      state[idx].backend = SOFTSPI_BACKEND_USI;
+    }
+  }
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn bytewise_write
+/// @brief STATIC Transfers a word through a hardware backend a byte at a time.
+/// @param[in] idx Interface index
+/// @param[in] data Data (in low bits) to write
+/// @return Word read from interface
+//////////////////////////////////////////////////////////////////////////////
+static uint32_t bytewise_write(uint8_t idx, uint32_t data)
+{
+  uint32_t rtn = 0;
+  uint8_t bytes = DESC_BYTE(idx, bits) >> 3;
+
+  SOFTSPI_select(idx);
+  if(DESC_BYTE(idx, mode) & 0x01)
+  {
+    // LSB first:  low byte goes out first
+    for(uint8_t b = 0; b < bytes; b++)
+    {
+      rtn |= (uint32_t)SOFTSPI_transfer_byte(idx, (uint8_t)data) << (b * 8);
+      data >>= 8;
+    }
+  }
+  else
+  {
+    for(uint8_t b = bytes; b > 0; b--)
+    {
+      rtn = (rtn << 8)
+        | SOFTSPI_transfer_byte(idx, (uint8_t)(data >> ((b - 1) * 8)));
+    }
+  }
+  SOFTSPI_deselect(idx);
+  return rtn;
+}
+
+#ifdef SOFTSPI_LANE_PINS
+//////////////////////////////////////////////////////////////////////////////
+/// @fn lanes_init
+/// @brief STATIC Makes the lane pins outputs and finds their port.
+/// @return Zero on success, -1 if the lanes are not all on one port.
+//////////////////////////////////////////////////////////////////////////////
+static int lanes_init(void)
+{
+  int rtn = 0;
+  uint8_t all = 0;
+  if(NUMBER_LANES > 8)
+  {
+    rtn = -1;
+  }
+  for(uint8_t k = 0; k < NUMBER_LANES && rtn == 0; k++)
+  {
+    if((lane_pins[k] >> 3) != (lane_pins[0] >> 3)
+       || GPIO_output_register(lane_pins[k]) == NULL)
+    {
+      rtn = -1;
+    }
+    else
+    {
+      GPIO_pin_mode(lane_pins[k], GPIO_PIN_MODE_OUTPUT);
+      lane_masks[k] = GPIO_PIN_MASK(lane_pins[k]);
+      all |= lane_masks[k];
+    }
+  }
+  if(rtn == 0)
+  {
+    lane_port = GPIO_output_register(lane_pins[0]);
+    lane_all = all;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn lanes_shift
+/// @brief STATIC Clocks out lane frames, one port write per bit.
+/// @param[in] frames  Port bits for each clock, from SOFTSPI_lanes_transpose
+/// @param[in] n       Number of frames (bits)
+/// @param[in] mode    SPI mode of the interface
+/// @param[in] dly     _delay_loop_2 count for each half bit, _SLOW modes
+/// @remark Edges and delays fall as in shift_byte.
+//////////////////////////////////////////////////////////////////////////////
+static void lanes_shift(const uint8_t *frames, uint16_t n,
+                        softspi_mode_t mode, uint16_t dly)
+{
+  const uint8_t cpha = mode & 0x02;
+  const uint8_t cpol = mode & 0x04;
+  const uint8_t slow = mode & 0x08;
+  volatile uint8_t *clk = sclk_port;
+  volatile uint8_t *port = lane_port;
+  const uint8_t cm = sclk_mask;
+  const uint8_t keep = ~lane_all;
+
+  for(uint16_t i = 0; i < n; i++)
+  {
+    if(cpha)
+    {
+      if(cpol) *clk &= ~cm; else *clk |= cm;      // leading edge
+    }
+    *port = (*port & keep) | frames[i];           // every lane at once
+    if(slow)
+    {
+      _delay_loop_2(dly);                         // first half
+    }
+    if(cpha)
+    {
+      if(cpol) *clk |= cm; else *clk &= ~cm;      // trailing edge
+    }
+    else
+    {
+      if(cpol) *clk &= ~cm; else *clk |= cm;      // leading edge
+    }
+    if(slow)
+    {
+      _delay_loop_2(dly);                         // second half
+    }
+    if(!cpha)
+    {
+      if(cpol) *clk |= cm; else *clk &= ~cm;      // trailing edge
+    }
+  }
+}
+#endif
 
 //////////////////////////////////////////////////////////////////////////////
 /// @function SOFTSPI_init
@@ -57,33 +621,23 @@ int SOFTSPI_init(uint8_t clk, int8_t mosi, int8_t miso)
   sclk_pin = clk;
   GPIO_pin_mode(clk, GPIO_PIN_MODE_OUTPUT);
   mosi_pin = mosi;
-  //   if(mosi >= 0)
+  if(mosi >= 0)
   {
     GPIO_pin_mode(mosi, GPIO_PIN_MODE_OUTPUT);
   }
-// CONFLICT START
-  
-    
-
-  ////////////////////////////////////////////////////////////////////////////
-  /// @fn SOFTSPI_set_interface
-  /// @brief Set up a softspi's parameters
-  /// @param[in] idx   SoftSPI index 0 to # buttons - 1
-  /// @param[in] ss    GPIO pin for slave select, -1 if not used
-  /// @param[in] bits  Number of bits per transfer
-  /// @param[in] mode  SPI mode to set clock phase and polarity
-  /// @param[in] bps   Max speed in bits per second. 0 for fast as possible.
-  /// @return    Zero on success or error code.
-  ////////////////////////////////////////////////////////////////////////////
-  int SOFTSPI_set_interface(uint8_t idx, int8_t ss, uint8_t bits,
-			    softspi_mode_t mode, uint32_t bps)
-// CONFLICT SEPARATOR
   miso_pin = miso;
   if(miso >= 0)
-// CONFLICT END
   {
     GPIO_pin_mode(miso, GPIO_PIN_MODE_INPUT_PULLUP);
   }
+  resolve_ports();
+  // The backends need SOFTSPI_init2:  bit-bang everything here.
+  for(uint8_t idx = 0; idx < NUMBER_INTERFACES; idx++)
+  {
+    state[idx].backend = SOFTSPI_BACKEND_SOFT;
+    state[idx].clock = DESC_WORD(idx, delay_ticks);
+    calibrate(idx);
+  }
 
   return rtn;
 }
@@ -103,41 +657,35 @@ int SOFTSPI_init2(void)
   {
     GPIO_pin_mode(SOFTSPI_MISO, GPIO_PIN_MODE_INPUT_PULLUP);
   }
-  // TODO calc delay ticks from bit rate
-  #warning Need to add code to calculate delay ticks to softspi.c
+  resolve_ports();
+#ifdef SOFTSPI_LANE_PINS
+  if(lanes_init() < 0)
+  {
+    rtn = -1;
+  }
+#endif
+  // delay_ticks comes from the table, worked out at compile time by
+  // SOFTSPI_INTERFACE(), then calibrate times the _SLOW kernels.
   for(int idx = 0; idx < NUMBER_INTERFACES; idx++)
   {
           // deselect each device
-          if(spis[idx].ss_pin != GPIO_PIN_NONE)
+          uint8_t ss = DESC_BYTE(idx, ss_pin);
+          if(ss != GPIO_PIN_NONE)
           {
-                  GPIO_pin_mode(spis[idx].ss_pin, GPIO_PIN_MODE_OUTPUT);
-                  GPIO_write_pin(spis[idx].ss_pin, 1);
+                  write_ss(idx, 1);
+                  GPIO_pin_mode(ss, GPIO_PIN_MODE_OUTPUT);
           }
-    // The a slow speed is requested, it is handled with _delay_us().
-    // The max speed without any intentional slowing is somewhere
-    // around 1 Mbs;  each bit takes approximately 1000 nS to send.  If
-    // a specific max bit rate is requested, we calculate the time
-    // per bit and use that for a delay loop.  Subtracting
-    // the always-present 1000 nS overhead, we use the result as the
-    // delay time.
-    //
-    // CAUTION!
-    // This is not very accurate,but we try to err on the side
-    // of caution.
-
-    uint32_t bps = spis[idx].bits_per_second;
-    if(bps != 0 )
-    {
-      uint32_t ns = 1000000000L / bps;  // nS between bits
-      ns -= 1000;  // Account for overhead time.
-      uint32_t ns_per_tick = 1000000000L / F_CPU * 3; // per docs, 3 clk / tick.
-      uint32_t ticks = ns / ns_per_tick;
-      if(ticks > 255)
-      {
-        ticks = 0;  // Corresponds to 256 ticks, the max
-      }
-      spis[idx].delay_ticks = (uint8_t) ticks;
+    choose_backend(idx);
+    if(state[idx].backend == SOFTSPI_BACKEND_SOFT)
+    {
+      calibrate(idx);
     }
+#ifdef SOFTSPI_LANE_PINS
+    // The lanes are bit-banged whatever the backend.
+    state[idx].lanes = SOFTSPI_KERNEL_DELAY_TICKS(
+      DESC_DWORD(idx, bits_per_second), SOFTSPI_LANES_KERNEL_CYCLES);
+    calibrate_lanes(idx);
+#endif
   }
   return rtn;
 }
@@ -145,349 +693,764 @@ int SOFTSPI_init2(void)
 
 ////////////////////////////////////////////////////////////////////////////
 /// @fn SOFTSPI_set_interface
-/// @brief Set up a softspi parameters
-/// @param[in] idx   SoftSPI index 0 to # buttons - 1
+/// @brief Checks an interface against the flash table.
+/// @param[in] idx   SoftSPI index 0 to # interfaces - 1
 /// @param[in] ss    GPIO pin for slave select, -1 if not used
 /// @param[in] bits  Number of bits per transfer
 /// @param[in] mode  SPI mode to set clock phase and polarity
 /// @param[in] bps   Max speed in bits per second. 0 for fast as possible.
-/// @return    Zero on success or error code.
+/// @return    Zero if entry idx already matches, -1 if not.
+/// @remark The table is in flash, so interfaces can no longer be
+///   changed at run time:  set them up in SOFTSPI_INTERFACES.
 ////////////////////////////////////////////////////////////////////////////
 int SOFTSPI_set_interface(uint8_t idx, int8_t ss, uint8_t bits,
                           softspi_mode_t mode, uint32_t bps)
 {
-  int rtn = 0;
-  if(idx < NUMBER_INTERFACES)
+  int rtn = -1;
+  if(idx < NUMBER_INTERFACES
+     && DESC_BYTE(idx, ss_pin) == (uint8_t)ss
+     && DESC_BYTE(idx, bits) == bits
+     && DESC_BYTE(idx, mode) == (uint8_t)mode
+     && DESC_DWORD(idx, bits_per_second) == bps)
   {
-    spis[idx].ss_pin = ss;
-    GPIO_write_pin(ss, 1);   // initialize deselected
-    GPIO_pin_mode(ss, GPIO_PIN_MODE_OUTPUT);
-    spis[idx].bits_per_second = bps;
-    spis[idx].mode = mode;
-    spis[idx].bits = bits;
-    spis[idx].delay_ticks = 0;   // For now.  May change if bps is requested.
+    rtn = 0;
   }
-  else
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_get_backend
+/// @brief Tells which engine an interface was given at init.
+/// @param[in] idx Interface index to check.
+/// @return SOFTSPI_BACKEND_SOFT, _SPI, or _USART
+/////////////////////////////////////////////////////////////////////////////
+softspi_backend_t SOFTSPI_get_backend(uint8_t idx)
+{
+  softspi_backend_t rtn = SOFTSPI_BACKEND_SOFT;
+  if(idx < NUMBER_INTERFACES)
   {
-    rtn = -1;
+    rtn = (softspi_backend_t)state[idx].backend;
   }
+  return rtn;
+}
 
-  // The a slow speed is requested, it is handled with _delay_us().
-  // The max speed without any intentional slowing is somewhere
-  // around 1 Mbs;  each bit takes approximately 1000 nS to send.  If
-  // a specific max bit rate is requested, we calculate the time
-  // per bit and use that for a delay loop.  Subtracting
-  // the always-present 1000 nS overhead, we use the result as the
-  // delay time.
-  //
-  // CAUTION!
-  // This is not very accurate,but we try to err on the side
-  // of caution.
-
-  if(bps != 0 )
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_achieved_bps
+/// @brief Works out the bit rate an interface really runs at.
+/// @param[in] idx Interface index to check.
+/// @return Bits per second from the kernel cycle counts or the hardware
+///         divider, 0 for a bad index.
+/////////////////////////////////////////////////////////////////////////////
+uint32_t SOFTSPI_achieved_bps(uint8_t idx)
+{
+  uint32_t rtn = 0;
+  if(idx < NUMBER_INTERFACES)
   {
-    uint32_t ns = 1000000000L / bps;  // nS between bits
-    ns -= 1000;  // Account for overhead time.
-    uint32_t ns_per_tick = 1000000000L / F_CPU * 3; // per docs, 3 clk / tick.
-    uint32_t ticks = ns / ns_per_tick;
-    if(ticks > 255)
+    uint32_t cycles = SOFTSPI_KERNEL_CYCLES;
+    if(state[idx].backend == SOFTSPI_BACKEND_SPI)
+    {
+      // SPR picks /4 /16 /64 /128, SPI2X halves it
+      static const uint8_t shifts[] = { 2, 4, 6, 7 };
+      cycles = 1 << shifts[state[idx].clock & 0x03];
+      if(state[idx].clock & 0x04)
+      {
+        cycles >>= 1;
+      }
+    }
+    else if(state[idx].backend == SOFTSPI_BACKEND_USART)
+    {
+      cycles = 2 * ((uint32_t)state[idx].clock + 1);
+    }
+    else if(state[idx].backend == SOFTSPI_BACKEND_USI)
+    {
+      cycles = 2 * (SPI_USI_LOOP_CYCLES + 3 * (uint32_t)state[idx].clock);
+      if(state[idx].clock == 0 && !(DESC_BYTE(idx, mode) & 0x02))
+      {
+        cycles = 2;      // unrolled strobes
+      }
+    }
+    else if(DESC_BYTE(idx, mode) & 0x08)
     {
-      ticks = 0;  // Corresponds to 256 ticks, the max
+      uint32_t n = state[idx].clock ? state[idx].clock : 65536L;
+      cycles = SOFTSPI_SLOW_KERNEL_CYCLES + 8 * n;     // two halves
     }
-    spis[idx].delay_ticks = (uint8_t) ticks;
+    rtn = F_CPU / cycles;
   }
-
   return rtn;
 }
-  
-    
-  
-  //////////////////////////////////////////////////////////////////////////////
-  /// @fn SOFTSPI_write
-  /// @brief Write (and read) word to/from interface
-  /// @param[in] idx Interface index to use.
-  /// @param[in] data Data (in low bits) to write
-  /// @return Word read from interface
-  /////////////////////////////////////////////////////////////////////////////
-  uint32_t SOFTSPI_write(const uint8_t idx, const uint32_t data)
+
+#if SOFTSPI_TIMER1
+// What time_transfer times
+#define TIME_WORD       0       // SOFTSPI_write, SS and all
+#define TIME_BITS       1       // the bit-bang kernel alone, off the bus
+#define TIME_LANES      2       // the lanes kernel alone, off the bus
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn time_transfer
+/// @brief STATIC Counts CPU cycles for a transfer with timer 1.
+/// @param[in] idx   Interface index to time.
+/// @param[in] what  TIME_WORD, TIME_BITS or TIME_LANES
+/// @param[in] bits  Bits for TIME_BITS and TIME_LANES, 1 to 8
+/// @return Cycles, 0 if it took over 65535.
+/// @remark Sends zeros.  TIME_BITS and TIME_LANES run the kernel with
+///   the bus pins pointed at sink:  the accesses cost the same, nothing
+///   moves on the bus and SS is left alone.  Timer 1 and the interrupt
+///   flag are saved and restored.  Works on the chip or in a simulator.
+//////////////////////////////////////////////////////////////////////////////
+static uint16_t time_transfer(uint8_t idx, uint8_t what, uint8_t bits)
+{
+  softspi_mode_t mode = (softspi_mode_t)DESC_BYTE(idx, mode);
+  uint16_t dly = state[idx].clock;
+  uint8_t sreg = SREG;
+  cli();
+  uint8_t tccr1a = TCCR1A;
+  uint8_t tccr1b = TCCR1B;
+  uint16_t tcnt1 = TCNT1;
+#ifdef SOFTSPI_LANE_PINS
+  static const uint8_t zeros[8];
+  volatile uint8_t *lanes = lane_port;
+#endif
+
+  if(what != TIME_WORD)
   {
-    uint32_t rtn = 0;
-    int8_t ss = spis[idx].ss_pin;
-    uint8_t dly = spis[idx].delay_ticks;
-    softspi_mode_t mode = spis[idx].mode;
-    uint8_t bits = spis[idx].bits;
-    uint32_t word = data;
-
-    switch(mode)
-    {
-    #ifdef SOFTSPI_ENABLE_MODE_0_MSB_FIRST
-    case SPI_MODE_0_MSB_FIRST:      // idle low, sample leading
-        GPIO_write_pin(sclk_pin, 0);  // idle low
-        GPIO_write_pin(ss, 0);
-        word <<= (32 - bits);
-        for(int b = 0; b < bits; b++)
+    sclk_port = &sink;
+    mosi_port = &sink;
+    miso_port = &sink;
+#ifdef SOFTSPI_LANE_PINS
+    lane_port = &sink;
+#endif
+  }
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  TIMER1_FLAGS = (1 << TOV1);       // writing one clears it
+  TCCR1B = 0x01;                    // clk/1
+  if(what == TIME_WORD)
+  {
+    SOFTSPI_write(idx, 0);
+  }
+#ifdef SOFTSPI_LANE_PINS
+  else if(what == TIME_LANES)
+  {
+    lanes_shift(zeros, bits, mode, state[idx].lanes);
+  }
+#endif
+  else
+  {
+    soft_shift(mode, 0, bits, dly);
+  }
+  TCCR1B = 0;
+  uint16_t cycles = TCNT1;
+  if(TIMER1_FLAGS & (1 << TOV1))
+  {
+    cycles = 0;
+  }
+  if(what != TIME_WORD)
+  {
+    resolve_ports();
+#ifdef SOFTSPI_LANE_PINS
+    lane_port = lanes;
+#endif
+  }
+
+  TCNT1 = tcnt1;
+  TCCR1A = tccr1a;
+  TCCR1B = tccr1b;
+  SREG = sreg;
+  return cycles;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn clock_period
+/// @brief STATIC Times one SCLK period of a bit-banged interface.
+/// @param[in] idx   Interface index
+/// @param[in] what  TIME_BITS for its kernel, TIME_LANES for the lanes
+/// @return CPU cycles, 0 if it couldn't be timed.
+/// @remark Two bits less one bit is one trip round the kernel's loop,
+///   without the call, the mode switch or SS.
+//////////////////////////////////////////////////////////////////////////////
+static uint16_t clock_period(uint8_t idx, uint8_t what)
+{
+  uint16_t rtn = 0;
+  uint16_t one = time_transfer(idx, what, 1);
+  uint16_t two = time_transfer(idx, what, 2);
+  if(one != 0 && two > one)
+  {
+    rtn = two - one;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn fit_delay
+/// @brief STATIC Works out a _SLOW kernel's delay from the kernel as
+///   timed on this part.
+/// @param[in]     idx   Interface index
+/// @param[in]     what  TIME_BITS or TIME_LANES
+/// @param[in,out] dly   The delay the kernel runs with, the hand-counted
+///                      one on the way in
+/// @remark The kernel is run with 1 tick each half, which is the kernel
+///   plus 8 cycles, and the ticks for bps follow from that.  dly stays
+///   if the kernel can't be timed.
+//////////////////////////////////////////////////////////////////////////////
+static void fit_delay(uint8_t idx, uint8_t what, uint16_t *dly)
+{
+  uint32_t bps = DESC_DWORD(idx, bits_per_second);
+  if((DESC_BYTE(idx, mode) & 0x08) && bps != 0)
+  {
+    uint16_t table = *dly;
+    *dly = 1;
+    uint16_t period = clock_period(idx, what);
+    *dly = table;
+    if(period > 8)
+    {
+      uint32_t kernel = period - 8;
+      uint32_t want = SOFTSPI_CYCLES_PER_BIT(bps);
+      uint32_t ticks = 1;
+      if(want > kernel + 8)
+      {
+        ticks = (want - kernel + 7) / 8;
+      }
+      *dly = (ticks > 65535) ? 0 : (uint16_t)ticks;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn calibrate
+/// @brief STATIC Works out a bit-banged _SLOW interface's delay from its
+///   kernel as timed on this part.
+/// @param[in] idx Interface index
+/// @remark SOFTSPI_INTERFACE() could only use SOFTSPI_SLOW_KERNEL_CYCLES,
+///   counted by hand.
+//////////////////////////////////////////////////////////////////////////////
+static void calibrate(uint8_t idx)
+{
+  fit_delay(idx, TIME_BITS, &state[idx].clock);
+}
+
+#ifdef SOFTSPI_LANE_PINS
+//////////////////////////////////////////////////////////////////////////////
+/// @fn calibrate_lanes
+/// @brief STATIC Works out an interface's lanes delay from the lanes
+///   kernel as timed on this part.
+/// @param[in] idx Interface index
+/// @remark Starts from SOFTSPI_LANES_KERNEL_CYCLES, counted by hand.
+//////////////////////////////////////////////////////////////////////////////
+static void calibrate_lanes(uint8_t idx)
+{
+  fit_delay(idx, TIME_LANES, &state[idx].lanes);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_measure_bps
+/// @brief Times the clock of an interface.
+/// @param[in] idx Interface index to measure.
+/// @return SCLK rate in bits per second, 0 for a bad index or if a bit
+///         took over 32767 cycles.
+/// @remark Bit-banged interfaces are timed with timer 1 running their
+///   kernel off the bus, so nothing is sent.  The hardware backends clock
+///   at their divider:  that rate is returned.
+/////////////////////////////////////////////////////////////////////////////
+uint32_t SOFTSPI_measure_bps(uint8_t idx)
+{
+  uint32_t rtn = 0;
+  if(idx < NUMBER_INTERFACES)
+  {
+    if(state[idx].backend == SOFTSPI_BACKEND_SOFT)
+    {
+      uint16_t cycles = clock_period(idx, TIME_BITS);
+      if(cycles != 0)
+      {
+        rtn = F_CPU / cycles;
+      }
+    }
+    else
+    {
+      rtn = SOFTSPI_achieved_bps(idx);
+    }
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_measure_write
+/// @brief Times a whole SOFTSPI_write on an interface with timer 1.
+/// @param[in] idx Interface index to measure.
+/// @return Bits per second over the interface's word size, SS included,
+///         0 if the write took over 65535 cycles.
+/// @remark Sends 0 to the device.  Run it on interfaces of different
+///   widths to compare their throughput.
+/////////////////////////////////////////////////////////////////////////////
+uint32_t SOFTSPI_measure_write(uint8_t idx)
+{
+  uint32_t rtn = 0;
+  if(idx < NUMBER_INTERFACES)
+  {
+    uint16_t cycles = time_transfer(idx, TIME_WORD, 0);
+    if(cycles != 0)
+    {
+      rtn = (F_CPU * DESC_BYTE(idx, bits)) / cycles;
+    }
+  }
+  return rtn;
+}
+
+#else
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn calibrate
+/// @brief STATIC No timer 1:  the table's delay stands.
+//////////////////////////////////////////////////////////////////////////////
+static void calibrate(uint8_t idx)
+{
+  (void)idx;
+}
+
+#ifdef SOFTSPI_LANE_PINS
+//////////////////////////////////////////////////////////////////////////////
+/// @fn calibrate_lanes
+/// @brief STATIC No timer 1:  the hand-counted lanes delay stands.
+//////////////////////////////////////////////////////////////////////////////
+static void calibrate_lanes(uint8_t idx)
+{
+  (void)idx;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_measure_bps
+/// @brief No timer 1 to time with.
+/// @return 0
+/////////////////////////////////////////////////////////////////////////////
+uint32_t SOFTSPI_measure_bps(uint8_t idx)
+{
+  (void)idx;
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_measure_write
+/// @brief No timer 1 to time with.
+/// @return 0
+/////////////////////////////////////////////////////////////////////////////
+uint32_t SOFTSPI_measure_write(uint8_t idx)
+{
+  (void)idx;
+  return 0;
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_check_rates
+/// @brief Flags interfaces whose clock runs faster than their requested
+///        max bps.
+/// @return Bit n set if interface n is too fast, on its own or in the
+///         lanes writes.  Interfaces with bps 0 are never flagged.  Only
+///         the first 16 interfaces are checked.
+/// @remark Uses SOFTSPI_measure_bps, so the bit-banged clocks are timed,
+///   not worked out from the same cycle counts that set their delays.
+///   The lanes kernel is timed the same way.  Without timer 1 it can
+///   only use SOFTSPI_achieved_bps and the hand counts.
+/////////////////////////////////////////////////////////////////////////////
+uint16_t SOFTSPI_check_rates(void)
+{
+  uint16_t rtn = 0;
+  for(uint8_t idx = 0; idx < NUMBER_INTERFACES && idx < 16; idx++)
+  {
+    uint32_t bps = DESC_DWORD(idx, bits_per_second);
+#if SOFTSPI_TIMER1
+    uint32_t rate = SOFTSPI_measure_bps(idx);
+#else
+    uint32_t rate = SOFTSPI_achieved_bps(idx);
+#endif
+#ifdef SOFTSPI_LANE_PINS
+    if(lane_all != 0)
+    {
+#if SOFTSPI_TIMER1
+      uint16_t cycles = clock_period(idx, TIME_LANES);
+      uint32_t lanes = cycles ? F_CPU / cycles : 0;
+#else
+      uint32_t n = state[idx].lanes ? state[idx].lanes : 65536L;
+      uint32_t lanes = (DESC_BYTE(idx, mode) & 0x08)
+        ? F_CPU / (SOFTSPI_LANES_KERNEL_CYCLES + 8 * n) : 0;
+#endif
+      if(lanes > rate)
+      {
+        rate = lanes;
+      }
+    }
+#endif
+    if(bps != 0 && rate > bps)
+    {
+      rtn |= (1 << idx);
+    }
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_select
+/// @brief Puts the clock at its idle level and asserts slave select.
+/// @param[in] idx Interface index to select.
+/// @remark For the hardware backend this also enables the peripheral.
+/////////////////////////////////////////////////////////////////////////////
+void SOFTSPI_select(uint8_t idx)
+{
+  if(state[idx].backend == SOFTSPI_BACKEND_SPI)
+  {
+    SPI_configure(DESC_BYTE(idx, mode), (uint8_t)state[idx].clock);
+  }
+  else if(state[idx].backend == SOFTSPI_BACKEND_USART)
+  {
+    SPI_USART_configure(DESC_BYTE(idx, mode), state[idx].clock);
+  }
+  else if(state[idx].backend == SOFTSPI_BACKEND_USI)
+  {
+    SPI_USI_configure(DESC_BYTE(idx, mode), state[idx].clock);
+  }
+  else
+  {
+    // cpol is the idle level
+    GPIO_write_pin(sclk_pin, DESC_BYTE(idx, mode) & 0x04);
+  }
+  write_ss(idx, 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_deselect
+/// @brief Releases slave select (and the hardware backend if in use).
+/// @param[in] idx Interface index to deselect.
+/////////////////////////////////////////////////////////////////////////////
+void SOFTSPI_deselect(uint8_t idx)
+{
+  if(state[idx].backend == SOFTSPI_BACKEND_USART)
+  {
+    SPI_USART_release();   // waits for the last byte to leave
+  }
+  write_ss(idx, 1);
+  if(state[idx].backend == SOFTSPI_BACKEND_SPI)
+  {
+    SPI_release();
+  }
+  else if(state[idx].backend == SOFTSPI_BACKEND_USI)
+  {
+    SPI_USI_release();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_transfer_byte
+/// @brief Clocks one byte in the interface's mode without touching SS.
+/// @param[in] idx  Interface index, already selected.
+/// @param[in] data Byte to write.
+/// @return Byte read, 0 if no MISO.
+/////////////////////////////////////////////////////////////////////////////
+uint8_t SOFTSPI_transfer_byte(uint8_t idx, uint8_t data)
+{
+  uint8_t rtn = 0;
+  if(state[idx].backend == SOFTSPI_BACKEND_SPI)
+  {
+    rtn = SPI_transfer(data);
+  }
+  else if(state[idx].backend == SOFTSPI_BACKEND_USART)
+  {
+    return SPI_USART_transfer(data);   // MISO is RXD, not miso_pin
+  }
+  else if(state[idx].backend == SOFTSPI_BACKEND_USI)
+  {
+    rtn = SPI_USI_transfer(data);
+  }
+  else
+  {
+    rtn = (uint8_t)soft_shift(DESC_BYTE(idx, mode), data, 8,
+                              state[idx].clock);
+  }
+  if(miso_pin == GPIO_PIN_NONE)
+  {
+    rtn = 0;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_transfer_buffer
+/// @brief Selects, clocks len bytes, and deselects.
+/// @param[in]  idx  Interface index to use.
+/// @param[in]  tx   Bytes to send, NULL sends zeros.
+/// @param[out] rx   Bytes read, NULL to discard.
+/// @param[in]  len  Number of bytes.
+/////////////////////////////////////////////////////////////////////////////
+void SOFTSPI_transfer_buffer(uint8_t idx, const uint8_t *tx, uint8_t *rx,
+                             uint16_t len)
+{
+  SOFTSPI_select(idx);
+  if(state[idx].backend == SOFTSPI_BACKEND_USART)
+  {
+    SPI_USART_transfer_buffer(tx, rx, len);
+  }
+  else
+  {
+    for(uint16_t i = 0; i < len; i++)
+    {
+      uint8_t in = SOFTSPI_transfer_byte(idx, (tx != NULL) ? tx[i] : 0);
+      if(rx != NULL)
+      {
+        rx[i] = in;
+      }
+    }
+  }
+  SOFTSPI_deselect(idx);
+}
+
+#ifdef SOFTSPI_LANE_PINS
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_lanes_transpose
+/// @brief Turns one byte per lane into eight port frames, one per clock.
+/// @param[in]  data    SOFTSPI_LANES bytes, data[k] goes out on lane k.
+/// @param[out] frames  Eight port values, in the order they are clocked.
+/// @param[in]  lsb_first  Nonzero to send bit 0 of each byte first.
+/////////////////////////////////////////////////////////////////////////////
+void SOFTSPI_lanes_transpose(const uint8_t *data, uint8_t *frames,
+                             uint8_t lsb_first)
+{
+  for(uint8_t b = 0; b < 8; b++)
+  {
+    uint8_t bit = lsb_first ? (1 << b) : (0x80 >> b);
+    uint8_t frame = 0;
+    for(uint8_t k = 0; k < NUMBER_LANES; k++)
+    {
+      if(data[k] & bit)
+      {
+        frame |= lane_masks[k];
+      }
+    }
+    frames[b] = frame;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_lanes_write_frames
+/// @brief Selects, clocks out pre-transposed frames on every lane, and
+///        deselects.
+/// @param[in] idx     Interface index for SS, mode and bit rate.
+/// @param[in] frames  Port values from SOFTSPI_lanes_transpose.
+/// @param[in] n       Number of frames, 8 per byte on each lane.
+/////////////////////////////////////////////////////////////////////////////
+void SOFTSPI_lanes_write_frames(uint8_t idx, const uint8_t *frames,
+                                uint16_t n)
+{
+  if(idx < NUMBER_INTERFACES && lane_all != 0)
+  {
+    // Always bit-banged, so the hardware backends are left alone.
+    softspi_mode_t mode = (softspi_mode_t)DESC_BYTE(idx, mode);
+    GPIO_write_pin(sclk_pin, mode & 0x04);
+    write_ss(idx, 0);
+    lanes_shift(frames, n, mode, state[idx].lanes);
+    write_ss(idx, 1);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_lanes_write
+/// @brief Sends len bytes down every lane at once.
+/// @param[in] idx   Interface index for SS, mode and bit rate.
+/// @param[in] data  len groups of SOFTSPI_LANES bytes: byte i of lane k
+///                  is data[i * SOFTSPI_LANES + k].
+/// @param[in] len   Bytes per lane.
+/// @remark Transposes a byte at a time on the stack.  To resend the same
+///   data, transpose once and use SOFTSPI_lanes_write_frames.
+/////////////////////////////////////////////////////////////////////////////
+void SOFTSPI_lanes_write(uint8_t idx, const uint8_t *data, uint16_t len)
+{
+  if(idx < NUMBER_INTERFACES && lane_all != 0)
+  {
+    uint8_t frames[8];
+    softspi_mode_t mode = (softspi_mode_t)DESC_BYTE(idx, mode);
+    uint16_t dly = state[idx].lanes;
+    uint8_t lsb = mode & 0x01;
+    GPIO_write_pin(sclk_pin, mode & 0x04);
+    write_ss(idx, 0);
+    for(uint16_t i = 0; i < len; i++)
+    {
+      SOFTSPI_lanes_transpose(data, frames, lsb);
+      lanes_shift(frames, 8, mode, dly);
+      data += NUMBER_LANES;
+    }
+    write_ss(idx, 1);
+  }
+}
+#endif
+  
+    
+  
+#ifdef SOFTSPI_CHAINS
+//////////////////////////////////////////////////////////////////////////////
+/// @fn find_chain
+/// @brief STATIC Finds the chain on an interface.
+/// @param[in] idx  Interface index
+/// @return Index into chains[], NUMBER_CHAINS if there is none.
+//////////////////////////////////////////////////////////////////////////////
+static uint8_t find_chain(uint8_t idx)
+{
+  uint8_t c = 0;
+  while(c < NUMBER_CHAINS && pgm_read_byte(&chains[c].idx) != idx)
+  {
+    c++;
+  }
+  return c;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_chain_set
+/// @brief Updates one device's shadow without sending anything.
+/// @param[in] idx    Interface the chain is on.
+/// @param[in] pos    Device, 0 is the one wired to MOSI.
+/// @param[in] value  Word for the device, in the low bytes.
+/// @return 1 if the shadow changed, 0 if not, -1 for a bad idx or pos.
+/////////////////////////////////////////////////////////////////////////////
+int SOFTSPI_chain_set(uint8_t idx, uint8_t pos, uint32_t value)
+{
+  int rtn = -1;
+  uint8_t c = find_chain(idx);
+  if(c < NUMBER_CHAINS && pos < pgm_read_byte(&chains[c].len))
+  {
+    uint8_t bytes = pgm_read_byte(&chains[c].bytes);
+    uint8_t *p = (uint8_t *)&shadow + pgm_read_word(&chains[c].offset)
+      + pos * bytes;
+    uint8_t lsb = DESC_BYTE(idx, mode) & 0x01;
+    rtn = 0;
+    // Kept in the order the bytes go out, like bytewise_write.
+    for(uint8_t b = 0; b < bytes; b++)
+    {
+      uint8_t v = lsb ? (uint8_t)(value >> (b * 8))
+                      : (uint8_t)(value >> ((bytes - 1 - b) * 8));
+      if(p[b] != v)
+      {
+        p[b] = v;
+        rtn = 1;
+      }
+    }
+    if(rtn)
+    {
+      chain_dirty[c] = 1;
+    }
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_chain_get
+/// @brief Reads back one device's shadow.
+/// @param[in] idx  Interface the chain is on.
+/// @param[in] pos  Device, 0 is the one wired to MOSI.
+/// @return Last word set for the device, 0 for a bad idx or pos.
+/////////////////////////////////////////////////////////////////////////////
+uint32_t SOFTSPI_chain_get(uint8_t idx, uint8_t pos)
+{
+  uint32_t rtn = 0;
+  uint8_t c = find_chain(idx);
+  if(c < NUMBER_CHAINS && pos < pgm_read_byte(&chains[c].len))
+  {
+    uint8_t bytes = pgm_read_byte(&chains[c].bytes);
+    const uint8_t *p = (uint8_t *)&shadow + pgm_read_word(&chains[c].offset)
+      + pos * bytes;
+    uint8_t lsb = DESC_BYTE(idx, mode) & 0x01;
+    for(uint8_t b = 0; b < bytes; b++)
+    {
+      uint8_t v = lsb ? p[bytes - 1 - b] : p[b];
+      rtn = (rtn << 8) | v;
+    }
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_chain_flush
+/// @brief Shifts the whole chain in one SS window so every device
+///        latches together.
+/// @param[in] idx    Interface the chain is on.
+/// @param[in] force  Nonzero to send even if nothing changed.
+/// @return 1 if the chain was sent, 0 if not, -1 for a bad idx.
+/////////////////////////////////////////////////////////////////////////////
+int SOFTSPI_chain_flush(uint8_t idx, uint8_t force)
+{
+  int rtn = -1;
+  uint8_t c = find_chain(idx);
+  if(c < NUMBER_CHAINS)
+  {
+    rtn = 0;
+    if(chain_dirty[c] || force)
+    {
+      uint8_t bytes = pgm_read_byte(&chains[c].bytes);
+      uint16_t n = pgm_read_byte(&chains[c].len) * bytes;
+      const uint8_t *p = (uint8_t *)&shadow + pgm_read_word(&chains[c].offset);
+      chain_dirty[c] = 0;
+      SOFTSPI_select(idx);
+      // The far end goes first so each word shifts through to its device.
+      for(uint16_t dev = n; dev > 0; dev -= bytes)
+      {
+        for(uint8_t b = 0; b < bytes; b++)
         {
-                GPIO_write_pin(mosi_pin, (int)((word >> 16)  & 0x8000));
-          GPIO_write_pin(sclk_pin, 1);
-          GPIO_write_pin(sclk_pin, 0);
-          word <<= 1;
+          SOFTSPI_transfer_byte(idx, p[dev - bytes + b]);
         }
-        GPIO_write_pin(ss, 1);
-        break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_0_LSB_FIRST  
-    case SPI_MODE_0_LSB_FIRST:      // idle low, sample leading
-        GPIO_write_pin(sclk_pin, 0);  // idle low
-        GPIO_write_pin(ss, 0);
-        for(int b = 0; b < bits; b++)
-          {
-                  GPIO_write_pin(mosi_pin, (int)(word & 0x01));
-	    GPIO_write_pin(sclk_pin, 1);
-	    GPIO_write_pin(sclk_pin, 0);
-	    word >>= 1;
-	  }
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_1_MSB_FIRST
-    case SPI_MODE_1_MSB_FIRST:      // idle low, sample trailing
-          GPIO_write_pin(sclk_pin, 0);  // idle low
-          GPIO_write_pin(ss, 0);
-          word <<= (32 - bits);
-          GPIO_write_pin(ss, 0);
-          for(int b = 0; b < bits; b++)
-          {
-                  GPIO_write_pin(mosi_pin, (int)((word >> 16)  & 0x8000));
-            GPIO_write_pin(sclk_pin, 1);
-            GPIO_write_pin(sclk_pin, 0);
-            word <<= 1;
-          }
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_1_LSB_FIRST  
-    case SPI_MODE_1_LSB_FIRST:      // idle low, sample trailing
-          GPIO_write_pin(sclk_pin, 0);  // idle low
-          GPIO_write_pin(ss, 0);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-                  GPIO_write_pin(mosi_pin, (int)(word & 0x01));
-            GPIO_write_pin(sclk_pin, 1);
-            GPIO_write_pin(sclk_pin, 0);
-            word >>= 1;
-          }
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_2_MSB_FIRST
-    case SPI_MODE_2_MSB_FIRST:      // idle high, sample leading
-          GPIO_write_pin(sclk_pin, 1);  // idle high
-          word <<= (32 - bits);
-          GPIO_write_pin(ss, 0);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-                  GPIO_write_pin(mosi_pin, (int)((word >> 16) & 0x8000));
-            GPIO_write_pin(sclk_pin, 0);
-            GPIO_write_pin(sclk_pin, 1);
-            word <<= 1;
-          }
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_2_LSB_FIRST
-    case SPI_MODE_2_LSB_FIRST:      // idle high, sample leading
-          GPIO_write_pin(sclk_pin, 1);  // idle high
-          GPIO_write_pin(ss, 0);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-                  GPIO_write_pin(mosi_pin, (int)(word & 0x01));
-            GPIO_write_pin(sclk_pin, 0);
-            GPIO_write_pin(sclk_pin, 1);
-            word >>= 1;
-          }
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_3_MSB_FIRST
-    case SPI_MODE_3_MSB_FIRST:      // idle high, sample trailing
-          GPIO_write_pin(sclk_pin, 1);  // idle high
-          GPIO_write_pin(ss, 0);
-          word <<= (sizeof(uint32_t) - bits);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-                  GPIO_write_pin(mosi_pin, (int)((word >> 16) & 0x8000));
-            GPIO_write_pin(sclk_pin, 0);
-            GPIO_write_pin(sclk_pin, 1);
-            word <<= 1;
-          }
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-
-    #ifdef SOFTSPI_ENABLE_MODE_3_LSB_FIRST
-    case SPI_MODE_3_LSB_FIRST:      // idle high, sample trailing
-          GPIO_write_pin(sclk_pin, 1);  // idle high
-          GPIO_write_pin(ss, 0);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-                  GPIO_write_pin(mosi_pin, (int)(word & 0x01));
-            GPIO_write_pin(sclk_pin, 0);
-            GPIO_write_pin(sclk_pin, 1);
-            word >>= 1;
-          }
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_0_MSB_FIRST_SLOW
-    case SPI_MODE_0_MSB_FIRST_SLOW:  // idle low, sample leading
-          GPIO_write_pin(sclk_pin, 0);   // idle low
-          GPIO_write_pin(ss, 0);
-          word <<= (sizeof(uint32_t) - bits);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-            _delay_loop_1(dly);
-            GPIO_write_pin(mosi_pin, (int)((word >> 16) & 0x8000));
-            GPIO_write_pin(sclk_pin, 1);
-            GPIO_write_pin(sclk_pin, 0);
-            word <<= 1;
-          }
-          _delay_loop_1(dly);
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_0_LSB_FIRST_SLOW
-    case SPI_MODE_0_LSB_FIRST_SLOW: // idle low, sample leading
-          GPIO_write_pin(sclk_pin, 0);  // idle low
-          GPIO_write_pin(ss, 0);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-            _delay_loop_1(dly);
-            GPIO_write_pin(mosi_pin, (int)(word & 0x01));
-            GPIO_write_pin(sclk_pin, 1);
-            GPIO_write_pin(sclk_pin, 0);
-            word >>= 1;
-          }
-          _delay_loop_1(dly);
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_1_MSB_FIRST_SLOW
-    case SPI_MODE_1_MSB_FIRST_SLOW:  // idle low, sample trailing
-          GPIO_write_pin(sclk_pin, 0);   // idle low
-          GPIO_write_pin(ss, 0);
-          word <<= (sizeof(uint32_t) - bits);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-            _delay_loop_1(dly);
-            GPIO_write_pin(mosi_pin, (int)((word >> 16) & 0x8000));
-            GPIO_write_pin(sclk_pin, 1);
-            GPIO_write_pin(sclk_pin, 0);
-            word <<= 1;
-          }
-          _delay_loop_1(dly);
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_1_LSB_FIRST_SLOW
-    case SPI_MODE_1_LSB_FIRST_SLOW:  // idle low, sample trailing
-          GPIO_write_pin(sclk_pin, 0);  // idle low
-          GPIO_write_pin(ss, 0);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-            _delay_loop_1(dly);
-            GPIO_write_pin(mosi_pin, (int)(word & 0x01));
-            GPIO_write_pin(sclk_pin, 1);
-            GPIO_write_pin(sclk_pin, 0);
-            word >>= 1;
-          }
-          _delay_loop_1(dly);
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_2_MSB_FIRST_SLOW
-    case SPI_MODE_2_MSB_FIRST_SLOW: // idle high, sample leading
-          GPIO_write_pin(sclk_pin, 1);  // idle high
-          GPIO_write_pin(ss, 0);
-          word <<= (sizeof(uint32_t) - bits);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-            _delay_loop_1(dly);
-            GPIO_write_pin(mosi_pin, (int)((word >> 16) & 0x8000));
-            GPIO_write_pin(sclk_pin, 0);
-            GPIO_write_pin(sclk_pin, 1);
-            word <<= 1;
-          }
-          _delay_loop_1(dly);
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_2_LSB_FIRST_SLOW
-    case SPI_MODE_2_LSB_FIRST_SLOW: // idle high, sample leading
-          GPIO_write_pin(sclk_pin, 1);  // idle high
-          GPIO_write_pin(ss, 0);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-            _delay_loop_1(dly);
-            GPIO_write_pin(mosi_pin, (int)(word & 0x01));
-            GPIO_write_pin(sclk_pin, 0);
-            GPIO_write_pin(sclk_pin, 1);
-            word >>= 1;
-          }
-          _delay_loop_1(dly);
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_3_MSB_FIRST_SLOW
-    case SPI_MODE_3_MSB_FIRST_SLOW: // idle high, sample trailing
-          GPIO_write_pin(sclk_pin, 1);  // idle high
-          GPIO_write_pin(ss, 0);
-          word <<= (sizeof(uint32_t) - bits);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-            _delay_loop_1(dly);
-            GPIO_write_pin(mosi_pin, (int)((word >> 16) & 0x8000));
-            GPIO_write_pin(sclk_pin, 0);
-            GPIO_write_pin(sclk_pin, 1);
-            word <<= 1;
-          }
-          _delay_loop_1(dly);
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif
-            
-    #ifdef SOFTSPI_ENABLE_MODE_3_LSB_FIRST_SLOW
-    case SPI_MODE_3_LSB_FIRST_SLOW: // idle high, sample trailing
-          GPIO_write_pin(sclk_pin, 1);  // idle high
-          GPIO_write_pin(ss, 0);
-          for(uint8_t b = 0; b < bits; b++)
-          {
-            _delay_loop_1(dly);
-            GPIO_write_pin(mosi_pin, (int)(word & 0x01));
-            GPIO_write_pin(sclk_pin, 0);
-            GPIO_write_pin(sclk_pin, 1);
-            word >>= 1;
-          }
-          _delay_loop_1(dly);
-          GPIO_write_pin(ss, 1);
-          break;
-    #endif            
-
-	default:
-	  break;
-	}
+      }
+      SOFTSPI_deselect(idx);
+      rtn = 1;
+    }
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SOFTSPI_chain_write
+/// @brief Sets one device and resends the chain if it changed.
+/// @param[in] idx    Interface the chain is on.
+/// @param[in] pos    Device, 0 is the one wired to MOSI.
+/// @param[in] value  Word for the device, in the low bytes.
+/// @return 1 if the chain was sent, 0 if not, -1 for a bad idx or pos.
+/////////////////////////////////////////////////////////////////////////////
+int SOFTSPI_chain_write(uint8_t idx, uint8_t pos, uint32_t value)
+{
+  int rtn = SOFTSPI_chain_set(idx, pos, value);
+  if(rtn > 0)
+  {
+    rtn = SOFTSPI_chain_flush(idx, 0);
+  }
+  return rtn;
+}
+#endif
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_write
+  /// @brief Write (and read) word to/from interface
+  /// @param[in] idx Interface index to use.
+  /// @param[in] data Data (in low bits) to write
+  /// @return Word read from interface
+  /////////////////////////////////////////////////////////////////////////////
+  uint32_t SOFTSPI_write(const uint8_t idx, const uint32_t data)
+  {
+    uint32_t rtn = 0;
+    uint8_t bits = DESC_BYTE(idx, bits);
+
+    if(state[idx].backend != SOFTSPI_BACKEND_SOFT)
+    {
+      rtn = bytewise_write(idx, data);
+    }
+    else if(bits != 0)
+    {
+      softspi_mode_t mode = (softspi_mode_t)DESC_BYTE(idx, mode);
+      uint16_t dly = state[idx].clock;
+      SOFTSPI_select(idx);       // clock to idle, then SS low
+      rtn = soft_shift(mode, data, bits, dly);
+      if(mode & 0x08)
+      {
+        _delay_loop_2(dly);      // SS hold, half a bit
+      }
+      SOFTSPI_deselect(idx);
+    }
 	
     return rtn;
   }
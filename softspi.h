@@ -17,6 +17,7 @@ extern "C"
 #endif
 
 
+#include "config.h"
 #include "gpio.h"
 
 #define SOFTSPI_VERSION_MAJOR     0
@@ -48,6 +49,82 @@ extern "C"
       SPI_MODE_3_LSB_FIRST_SLOW         = 15, // idle high, sample on trailing
 
     } softspi_mode_t;
+
+  // Which engine moves the bits for an interface.  AUTO picks the
+  // hardware SPI, or the USI on the ATtinys, when the bus pins, word
+  // size, and bps allow it.  USART must be asked for:  it runs on its
+  // own XCK/TXD/RXD pins.  SOFT is zero so an interface nothing was
+  // chosen for is bit-banged.
+  typedef enum SOFTSPI_BACKEND
+    {
+      SOFTSPI_BACKEND_SOFT              =  0, // bit-banged on GPIO pins
+      SOFTSPI_BACKEND_AUTO              =  1, // hardware SPI if possible
+      SOFTSPI_BACKEND_SPI               =  2, // hardware SPI peripheral
+      SOFTSPI_BACKEND_USART             =  3, // USART in master SPI mode
+      SOFTSPI_BACKEND_USI               =  4, // USI three-wire mode
+    } softspi_backend_t;
+
+  // Cycles per bit of the bit-bang kernels, counted from the kernel's
+  // instructions.  They set SOFTSPI_MAX_BPS, the compile-time delays and
+  // SOFTSPI_achieved_bps.  Erring low makes the delays longer, so an
+  // interface never runs faster than asked.  The _SLOW kernels wait
+  // twice a bit, each call loading the count (1 cycle) and looping 4
+  // cycles a count less 1.
+  //
+  // SOFTSPI_init and SOFTSPI_init2 time each _SLOW kernel with timer 1
+  // (two bits less one bit is one SCLK period, run off the bus) and
+  // work its delay out again, so SOFTSPI_SLOW_KERNEL_CYCLES only counts
+  // on parts without timer 1.  To check either figure on a build, call
+  // SOFTSPI_measure_bps():  F_CPU / rate is SOFTSPI_KERNEL_CYCLES on a
+  // fast interface, and F_CPU / rate less 8 per delay tick is the _SLOW
+  // kernel.  The lanes kernel picks its edges at run time and writes a
+  // whole port, so it has a count of its own, timed the same way.
+#define SOFTSPI_KERNEL_CYCLES         20   // fast modes, no delay
+#define SOFTSPI_SLOW_KERNEL_CYCLES    25   // _SLOW modes, less the loops
+#define SOFTSPI_LANES_KERNEL_CYCLES   40   // lanes, _SLOW, less the loops
+
+  // Fastest the fast kernels go.  Any lower bps needs a _SLOW mode.
+#define SOFTSPI_MAX_BPS   (F_CPU / SOFTSPI_KERNEL_CYCLES)
+
+  // CPU cycles in one bit at bps, rounded up.
+#define SOFTSPI_CYCLES_PER_BIT(bps)                                    \
+  ((F_CPU + (bps) - 1) / ((bps) ? (bps) : 1))
+
+  // _delay_loop_2 count (4 cycles each) for each half of a _SLOW bit,
+  // so a kernel of that many cycles stays at or below bps.  At least 1;
+  // 0 means 65536, the slowest.  Folds to a constant when bps is one.
+#define SOFTSPI_KERNEL_DELAY_TICKS(bps, kernel)                        \
+  ((uint16_t)(((bps) == 0                                              \
+               || SOFTSPI_CYCLES_PER_BIT(bps) <= (kernel) + 8) ? 1 :   \
+              ((SOFTSPI_CYCLES_PER_BIT(bps) - (kernel) + 7) / 8        \
+               > 65535) ? 0 :                                          \
+              (SOFTSPI_CYCLES_PER_BIT(bps) - (kernel) + 7) / 8))
+
+  // The same for the _SLOW shift kernels.
+#define SOFTSPI_DELAY_TICKS(bps)                                       \
+  SOFTSPI_KERNEL_DELAY_TICKS(bps, SOFTSPI_SLOW_KERNEL_CYCLES)
+
+//////////////////////////////////////////////////////////////////////////////
+/// @struct softspi_desc
+/// @brief One interface, kept in flash.  Build with SOFTSPI_INTERFACE().
+//////////////////////////////////////////////////////////////////////////////
+  typedef struct softspi_desc
+  {
+    volatile uint8_t *ss_port;         // PORTx of SS, NULL if not used
+    uint8_t           ss_mask;         // SS bit in ss_port
+    uint8_t           ss_pin;          // SS pin, GPIO_PIN_NONE if not used
+    uint8_t           mode;            // softspi_mode_t
+    uint8_t           bits;            // How many bits to transfer per cycle
+    uint8_t           backend;         // softspi_backend_t asked for
+    uint16_t          delay_ticks;     // _delay_loop_2 count per half bit, _SLOW
+    uint32_t          bits_per_second; // Max speed in bps, 0 fast as possible
+  } softspi_desc_t;
+
+  // One row of SOFTSPI_INTERFACES in config.h.  The SS port, mask and
+  // delay are all worked out here.
+#define SOFTSPI_INTERFACE(bps, ss, mode, bits, backend)                \
+  { GPIO_OUTPUT_REGISTER(ss), GPIO_PIN_MASK(ss), (uint8_t)(ss),        \
+    (mode), (bits), (backend), SOFTSPI_DELAY_TICKS(bps), (bps) }
   
   
   
@@ -65,13 +142,14 @@ extern "C"
         
   ////////////////////////////////////////////////////////////////////////////
   /// @fn SOFTSPI_set_interface
-  /// @brief Set up a softspi parameters
+  /// @brief Checks an interface against the flash table.
   /// @param[in] idx  SoftSPI index 0 to # buttons - 1
   /// @param[in] ss    GPIO pin for slave select, -1 if not used
   /// @param[in] bits  Number of bits per transfer
   /// @param[in] mode  SPI mode to set clock phase and polarity
   /// @param[in] bps   Max speed in bits per second: 0 for fast as possible.
-  /// @return    TODO
+  /// @return    Zero if entry idx already matches, -1 if not.
+  /// @remark The table is in flash:  set interfaces up in config.h.
   ////////////////////////////////////////////////////////////////////////////
   int SOFTSPI_set_interface(uint8_t idx, int8_t ss, uint8_t bits,
 			    softspi_mode_t mode,  uint32_t bps);
@@ -85,6 +163,169 @@ extern "C"
   /// @return Word read from interface
   /////////////////////////////////////////////////////////////////////////////
   uint32_t SOFTSPI_write(uint8_t idx, uint32_t data);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_get_backend
+  /// @brief Tells which engine an interface was given at init.
+  /// @param[in] idx Interface index to check.
+  /// @return SOFTSPI_BACKEND_SOFT, _SPI, or _USART
+  /////////////////////////////////////////////////////////////////////////////
+  softspi_backend_t SOFTSPI_get_backend(uint8_t idx);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_select
+  /// @brief Puts the clock at its idle level and asserts slave select.
+  /// @param[in] idx Interface index to select.
+  /////////////////////////////////////////////////////////////////////////////
+  void SOFTSPI_select(uint8_t idx);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_achieved_bps
+  /// @brief Works out the bit rate an interface really runs at.
+  /// @param[in] idx Interface index to check.
+  /// @return Bits per second, 0 for a bad index.
+  /////////////////////////////////////////////////////////////////////////////
+  uint32_t SOFTSPI_achieved_bps(uint8_t idx);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_measure_bps
+  /// @brief Times the SCLK period of an interface with timer 1.
+  /// @param[in] idx Interface index to measure.
+  /// @return SCLK rate in bits per second, 0 for a bad index or if it
+  ///         couldn't be timed.
+  /// @remark Bit-banged interfaces run their kernel off the bus, so
+  ///   nothing is sent.  Hardware backends report their divider's rate.
+  /////////////////////////////////////////////////////////////////////////////
+  uint32_t SOFTSPI_measure_bps(uint8_t idx);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_measure_write
+  /// @brief Times a whole SOFTSPI_write on an interface with timer 1.
+  /// @param[in] idx Interface index to measure.
+  /// @return Bits per second over the interface's word size, SS included,
+  ///         0 if the write took over 65535 cycles.
+  /////////////////////////////////////////////////////////////////////////////
+  uint32_t SOFTSPI_measure_write(uint8_t idx);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_check_rates
+  /// @brief Flags interfaces whose SCLK runs faster than their requested
+  ///        max bps, as timed by SOFTSPI_measure_bps.
+  /// @return Bit n set if interface n is too fast, on its own or, with
+  ///         SOFTSPI_LANE_PINS, in the lanes writes.
+  /////////////////////////////////////////////////////////////////////////////
+  uint16_t SOFTSPI_check_rates(void);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_deselect
+  /// @brief Releases slave select (and the hardware SPI if in use).
+  /// @param[in] idx Interface index to deselect.
+  /////////////////////////////////////////////////////////////////////////////
+  void SOFTSPI_deselect(uint8_t idx);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_transfer_byte
+  /// @brief Clocks one byte in the interface's mode without touching SS.
+  /// @param[in] idx  Interface index, already selected.
+  /// @param[in] data Byte to write.
+  /// @return Byte read, 0 if no MISO.
+  /////////////////////////////////////////////////////////////////////////////
+  uint8_t SOFTSPI_transfer_byte(uint8_t idx, uint8_t data);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_transfer_buffer
+  /// @brief Selects, clocks len bytes, and deselects.
+  /// @param[in]  idx  Interface index to use.
+  /// @param[in]  tx   Bytes to send, NULL sends zeros.
+  /// @param[out] rx   Bytes read, NULL to discard.
+  /// @param[in]  len  Number of bytes.
+  /// @remark On the USART backend the bytes stream with no gap.
+  /////////////////////////////////////////////////////////////////////////////
+  void SOFTSPI_transfer_buffer(uint8_t idx, const uint8_t *tx, uint8_t *rx,
+                               uint16_t len);
+
+#ifdef SOFTSPI_LANE_PINS
+  // Number of MOSI lanes for the multi-lane writes.
+#define SOFTSPI_LANES   ( sizeof((uint8_t[]){ SOFTSPI_LANE_PINS }) )
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_lanes_transpose
+  /// @brief Turns one byte per lane into eight port frames, one per clock.
+  /// @param[in]  data    SOFTSPI_LANES bytes, data[k] goes out on lane k.
+  /// @param[out] frames  Eight port values, in the order they are clocked.
+  /// @param[in]  lsb_first  Nonzero to send bit 0 of each byte first.
+  /////////////////////////////////////////////////////////////////////////////
+  void SOFTSPI_lanes_transpose(const uint8_t *data, uint8_t *frames,
+                               uint8_t lsb_first);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_lanes_write_frames
+  /// @brief Selects, clocks out pre-transposed frames on every lane, and
+  ///        deselects.
+  /// @param[in] idx     Interface index for SS, mode and bit rate.
+  /// @param[in] frames  Port values from SOFTSPI_lanes_transpose.
+  /// @param[in] n       Number of frames, 8 per byte on each lane.
+  /////////////////////////////////////////////////////////////////////////////
+  void SOFTSPI_lanes_write_frames(uint8_t idx, const uint8_t *frames,
+                                  uint16_t n);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_lanes_write
+  /// @brief Sends len bytes down every lane at once.
+  /// @param[in] idx   Interface index for SS, mode and bit rate.
+  /// @param[in] data  len groups of SOFTSPI_LANES bytes: byte i of lane k
+  ///                  is data[i * SOFTSPI_LANES + k].
+  /// @param[in] len   Bytes per lane.
+  /// @remark Each lane gets the whole clock, so N devices take the time
+  ///   of one plus the transpose.  MISO is not read.  The lanes kernel
+  ///   has its own delay, timed at SOFTSPI_init2 like the _SLOW kernels,
+  ///   so the lanes run at or below the interface's bps too.
+  /////////////////////////////////////////////////////////////////////////////
+  void SOFTSPI_lanes_write(uint8_t idx, const uint8_t *data, uint16_t len);
+#endif
+
+#ifdef SOFTSPI_CHAINS
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_chain_set
+  /// @brief Updates one device's shadow without sending anything.
+  /// @param[in] idx    Interface the chain is on.
+  /// @param[in] pos    Device, 0 is the one wired to MOSI.
+  /// @param[in] value  Word for the device, in the low bytes.
+  /// @return 1 if the shadow changed, 0 if not, -1 for a bad idx or pos.
+  /////////////////////////////////////////////////////////////////////////////
+  int SOFTSPI_chain_set(uint8_t idx, uint8_t pos, uint32_t value);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_chain_get
+  /// @brief Reads back one device's shadow.
+  /// @param[in] idx  Interface the chain is on.
+  /// @param[in] pos  Device, 0 is the one wired to MOSI.
+  /// @return Last word set for the device, 0 for a bad idx or pos.
+  /////////////////////////////////////////////////////////////////////////////
+  uint32_t SOFTSPI_chain_get(uint8_t idx, uint8_t pos);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_chain_flush
+  /// @brief Shifts the whole chain in one SS window so every device
+  ///        latches together.
+  /// @param[in] idx    Interface the chain is on.
+  /// @param[in] force  Nonzero to send even if nothing changed.
+  /// @return 1 if the chain was sent, 0 if not, -1 for a bad idx.
+  /////////////////////////////////////////////////////////////////////////////
+  int SOFTSPI_chain_flush(uint8_t idx, uint8_t force);
+
+  //////////////////////////////////////////////////////////////////////////////
+  /// @fn SOFTSPI_chain_write
+  /// @brief Sets one device and resends the chain if it changed.
+  /// @param[in] idx    Interface the chain is on.
+  /// @param[in] pos    Device, 0 is the one wired to MOSI.
+  /// @param[in] value  Word for the device, in the low bytes.
+  /// @return 1 if the chain was sent, 0 if not, -1 for a bad idx or pos.
+  /// @remark Several changes can be batched with SOFTSPI_chain_set and
+  ///   one SOFTSPI_chain_flush.
+  /////////////////////////////////////////////////////////////////////////////
+  int SOFTSPI_chain_write(uint8_t idx, uint8_t pos, uint32_t value);
+#endif
   
 #ifdef __cplusplus
 }
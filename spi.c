@@ -0,0 +1,145 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file spi.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Use the hardware SPI peripheral as an SPI master.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include "config.h"
+#include <avr/io.h>
+#include "gpio.h"
+#include "spi.h"
+
+#if SPI_AVAILABLE
+
+// SPR1:SPR0 and SPI2X for F_CPU/2, /4, /8, /16, /32, /64, /128.
+static const uint8_t clock_bits[] =
+  {
+    0x04, 0x00, 0x05, 0x01, 0x06, 0x02, 0x03
+  };
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_init
+/// @brief Sets up the SPI pins for master mode.
+/// @return Zero on success, -1 if this part has no usable SPI.
+//////////////////////////////////////////////////////////////////////////////
+int SPI_init(void)
+{
+  GPIO_pin_mode(SPI_SCK, GPIO_PIN_MODE_OUTPUT);
+  GPIO_pin_mode(SPI_MOSI, GPIO_PIN_MODE_OUTPUT);
+  // An input SS pulled low would switch us to slave mode.
+  GPIO_write_pin(SPI_SS, 1);
+  GPIO_pin_mode(SPI_SS, GPIO_PIN_MODE_OUTPUT);
+  SPCR = 0;   // left off until a transfer configures it
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_clock_setting
+/// @brief Finds the fastest SPI clock that does not exceed bps.
+/// @param[in] bps  Max speed in bits per second: 0 for fast as possible.
+/// @return SPR bits and SPI2X, or SPI_CLOCK_NONE if bps is too low.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t SPI_clock_setting(uint32_t bps)
+{
+  uint8_t rtn = SPI_CLOCK_NONE;
+  if(bps == 0)
+  {
+    rtn = clock_bits[0];
+  }
+  else
+  {
+    // Halve the rate until it fits; no divides needed.
+    uint32_t rate = SPI_MAX_BPS;
+    for(uint8_t i = 0; i < sizeof(clock_bits); i++)
+    {
+      if(rate <= bps)
+      {
+        rtn = clock_bits[i];
+        break;
+      }
+      rate >>= 1;
+    }
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_configure
+/// @brief Enables the peripheral with the given mode and clock.
+/// @param[in] mode   SPI mode, the _SLOW variants are treated the same.
+/// @param[in] clock  Value from SPI_clock_setting.
+//////////////////////////////////////////////////////////////////////////////
+void SPI_configure(softspi_mode_t mode, uint8_t clock)
+{
+  // The mode enum is laid out as  [ slow | cpol | cpha | lsb first ]
+  uint8_t ctrl = (1 << SPE) | (1 << MSTR) | (clock & 0x03);
+  if(mode & 0x01)
+  {
+    ctrl |= (1 << DORD);
+  }
+  if(mode & 0x02)
+  {
+    ctrl |= (1 << CPHA);
+  }
+  if(mode & 0x04)
+  {
+    ctrl |= (1 << CPOL);
+  }
+  SPCR = ctrl;
+  SPSR = (clock & 0x04) ? (1 << SPI2X) : 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_release
+/// @brief Disables the peripheral so its pins return to GPIO control.
+//////////////////////////////////////////////////////////////////////////////
+void SPI_release(void)
+{
+  SPCR &= ~(1 << SPE);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_transfer
+/// @brief Sends one byte and returns the byte clocked in.
+/// @param[in] data Byte to write.
+/// @return Byte read.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t SPI_transfer(uint8_t data)
+{
+  SPDR = data;
+  while(!(SPSR & (1 << SPIF)))
+    ;
+  return SPDR;
+}
+
+#else  // SPI_AVAILABLE
+
+int SPI_init(void)
+{
+  return -1;
+}
+
+uint8_t SPI_clock_setting(uint32_t bps)
+{
+  return SPI_CLOCK_NONE;
+}
+
+void SPI_configure(softspi_mode_t mode, uint8_t clock)
+{
+}
+
+void SPI_release(void)
+{
+}
+
+uint8_t SPI_transfer(uint8_t data)
+{
+  return 0;
+}
+
+#endif  // SPI_AVAILABLE
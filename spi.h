@@ -0,0 +1,99 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file spi.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Use the hardware SPI peripheral as an SPI master.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef SPI_H
+#define SPI_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <avr/io.h>
+#include "config.h"
+#include "gpio.h"
+#include "softspi.h"
+
+#define SPI_VERSION_MAJOR     0
+#define SPI_VERSION_MINOR     1
+#define SPI_VERSION_BUILD     0
+#define SPI_VERSION_DATE      (20230615L)
+
+  // Pins used by the SPI peripheral.  Parts without one (or whose SPI
+  // lives on a port gpio.h doesn't know about) get GPIO_PIN_NONE and
+  // every interface stays on the software path.
+#if defined(SPCR) && (defined(__AVR_ATmega8__) || defined(__AVR_ATmega48__) \
+  || defined(__AVR_ATmega88__) || defined(__AVR_ATmega168__)             \
+  || defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__))
+#define SPI_AVAILABLE       1
+#define SPI_SCK             GPIO_PIN_B5
+#define SPI_MOSI            GPIO_PIN_B3
+#define SPI_MISO            GPIO_PIN_B4
+#define SPI_SS              GPIO_PIN_B2
+#else
+#define SPI_AVAILABLE       0
+#define SPI_SCK             GPIO_PIN_NONE
+#define SPI_MOSI            GPIO_PIN_NONE
+#define SPI_MISO            GPIO_PIN_NONE
+#define SPI_SS              GPIO_PIN_NONE
+#endif
+
+  // Fastest clock is F_CPU/2 with SPI2X, slowest is F_CPU/128.
+#define SPI_MAX_BPS         (F_CPU / 2)
+#define SPI_MIN_BPS         (F_CPU / 128)
+
+  // Returned by SPI_clock_setting when the rate can't be reached.
+#define SPI_CLOCK_NONE      0xff
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_init
+/// @brief Sets up the SPI pins for master mode.
+/// @remark The SS pin is made an output:  as an input a low level on it
+///         would drop the peripheral into slave mode.
+/// @return Zero on success, -1 if this part has no usable SPI.
+//////////////////////////////////////////////////////////////////////////////
+  int SPI_init(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_clock_setting
+/// @brief Finds the fastest SPI clock that does not exceed bps.
+/// @param[in] bps  Max speed in bits per second: 0 for fast as possible.
+/// @return SPR1:SPR0 in bits 0-1 and SPI2X in bit 2, or SPI_CLOCK_NONE if
+///         bps is below SPI_MIN_BPS.
+//////////////////////////////////////////////////////////////////////////////
+  uint8_t SPI_clock_setting(uint32_t bps);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_configure
+/// @brief Enables the peripheral with the given mode and clock.
+/// @param[in] mode   SPI mode, the _SLOW variants are treated the same.
+/// @param[in] clock  Value from SPI_clock_setting.
+//////////////////////////////////////////////////////////////////////////////
+  void SPI_configure(softspi_mode_t mode, uint8_t clock);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_release
+/// @brief Disables the peripheral so its pins return to GPIO control.
+//////////////////////////////////////////////////////////////////////////////
+  void SPI_release(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_transfer
+/// @brief Sends one byte and returns the byte clocked in.
+/// @param[in] data Byte to write.
+/// @return Byte read.
+//////////////////////////////////////////////////////////////////////////////
+  uint8_t SPI_transfer(uint8_t data);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // #ifndef SPI_H
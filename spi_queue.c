@@ -0,0 +1,264 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file spi_queue.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Queue SPI transactions and run them from interrupts.
+///
+///  Transactions on hardware SPI interfaces are pumped a byte at a time
+///  from the SPI transfer complete interrupt.  Bit-banged interfaces are
+///  pumped SPI_QUEUE_SOFT_BYTES at a time from a systick timer.  USART
+///  interfaces are streamed whole from the first tick after they start,
+///  back to back as SPI_USART_transfer_buffer does, which leaves the
+///  USART interrupts to serial.c.  Either way the main loop only pays for
+///  the enqueue.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stddef.h>   // for NULL
+#include "config.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "systick.h"
+#include "softspi.h"
+#include "spi.h"
+#include "spi_usart.h"
+#include "spi_queue.h"
+
+#if (SPI_QUEUE_SIZE & (SPI_QUEUE_SIZE - 1)) != 0
+#error SPI_QUEUE_SIZE must be a power of two
+#endif
+#define RING_MASK   (SPI_QUEUE_SIZE - 1)
+
+//////////////////////////////////////////////////////////////////////////////
+/// @array ring
+/// @brief Queued transactions.  ring[tail] is the one on the bus.
+/// @remark Only touched with interrupts off or from the pumping ISR.
+//////////////////////////////////////////////////////////////////////////////
+static spi_queue_desc_t ring[SPI_QUEUE_SIZE];
+static volatile uint8_t head = 0;      // next free slot
+static volatile uint8_t tail = 0;      // running transaction
+static volatile uint8_t active = 0;    // nonzero while ring[tail] runs
+static volatile uint8_t pos = 0;       // next byte of ring[tail]
+
+static spi_queue_stats_t stats;
+static uint32_t stats_start = 0;
+
+static void start_next(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn finish
+/// @brief STATIC Ends the running transaction and starts the next one.
+/// @remark Called from interrupt context.  The next transaction is started
+///         before the callback so the bus doesn't wait on it.
+//////////////////////////////////////////////////////////////////////////////
+static void finish(void)
+{
+  spi_queue_desc_t *d = &ring[tail];
+  spi_queue_callback_t cb = d->callback;
+  void *arg = d->arg;
+
+  SOFTSPI_deselect(d->idx);
+  stats.bytes += d->len;
+  stats.transfers++;
+  tail = (tail + 1) & RING_MASK;
+  start_next();
+  if(cb != NULL)
+  {
+    cb(arg);
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn start_next
+/// @brief STATIC Selects the device for ring[tail] and sends the first byte.
+/// @remark Interrupts must be off.
+//////////////////////////////////////////////////////////////////////////////
+static void start_next(void)
+{
+  active = 0;
+  if(tail != head)
+  {
+    spi_queue_desc_t *d = &ring[tail];
+    active = 1;
+    pos = 0;
+    SOFTSPI_select(d->idx);
+#if SPI_AVAILABLE
+    if(SOFTSPI_get_backend(d->idx) == SOFTSPI_BACKEND_SPI)
+    {
+      SPCR |= (1 << SPIE);
+      SPDR = (d->tx != NULL) ? d->tx[0] : 0;
+    }
+#endif
+    // Everything else waits for the next pump tick.
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn pump
+/// @brief STATIC Systick callback that clocks bytes for non-SPI interfaces.
+/// @remark A USART transaction goes out whole:  at the top MSPIM clock
+///   that is 1 uS a byte, so the longest one holds the tick for about a
+///   quarter of a mS.  Slower clocks hold it longer.
+//////////////////////////////////////////////////////////////////////////////
+static void pump(void)
+{
+  if(active)
+  {
+    spi_queue_desc_t *d = &ring[tail];
+    uint8_t backend = SOFTSPI_get_backend(d->idx);
+#if SPI_USART_AVAILABLE
+    if(backend == SOFTSPI_BACKEND_USART)
+    {
+      SPI_USART_transfer_buffer(d->tx, d->rx, d->len);
+      pos = d->len;
+      finish();
+    }
+    else
+#endif
+    if(backend != SOFTSPI_BACKEND_SPI)
+    {
+      uint8_t p = pos;
+      for(uint8_t n = 0; n < SPI_QUEUE_SOFT_BYTES && p < d->len; n++)
+      {
+        uint8_t in = SOFTSPI_transfer_byte(d->idx,
+                                           (d->tx != NULL) ? d->tx[p] : 0);
+        if(d->rx != NULL)
+        {
+          d->rx[p] = in;
+        }
+        p++;
+      }
+      pos = p;
+      if(p >= d->len)
+      {
+        finish();
+      }
+    }
+  }
+}
+
+#if SPI_AVAILABLE
+//////////////////////////////////////////////////////////////////////////////
+/// @brief SPI transfer complete:  store the byte read, send the next.
+//////////////////////////////////////////////////////////////////////////////
+ISR(SPI_STC_vect)
+{
+  spi_queue_desc_t *d = &ring[tail];
+  uint8_t p = pos;
+  uint8_t in = SPDR;
+  if(d->rx != NULL)
+  {
+    d->rx[p] = in;
+  }
+  p++;
+  pos = p;
+  if(p < d->len)
+  {
+    SPDR = (d->tx != NULL) ? d->tx[p] : 0;
+  }
+  else
+  {
+    SPCR &= ~(1 << SPIE);
+    finish();
+  }
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_QUEUE_init
+/// @brief Empties the queue and starts the systick pump for soft interfaces.
+/// @return Zero on success, -1 if no systick timer was free.
+//////////////////////////////////////////////////////////////////////////////
+int SPI_QUEUE_init(void)
+{
+  int rtn = 0;
+  head = 0;
+  tail = 0;
+  active = 0;
+  SPI_QUEUE_clear_stats();
+  //                         ticks rpt callback
+  if(SYSTICK_set_timer_ticks(1,    0,  pump) < 0)
+  {
+    rtn = -1;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_QUEUE_enqueue
+/// @brief Copies a descriptor into the ring and starts it if the bus is idle.
+/// @param[in] desc  Transaction to run.
+/// @return Zero on success, -1 if the ring is full or len is 0.
+//////////////////////////////////////////////////////////////////////////////
+int SPI_QUEUE_enqueue(const spi_queue_desc_t *desc)
+{
+  int rtn = -1;
+  uint8_t sreg = SREG;
+  cli();
+  uint8_t next = (head + 1) & RING_MASK;
+  if(desc->len != 0 && next != tail)
+  {
+    ring[head] = *desc;
+    head = next;
+    uint8_t depth = (head - tail) & RING_MASK;
+    if(depth > stats.max_depth)
+    {
+      stats.max_depth = depth;
+    }
+    if(!active)
+    {
+      start_next();
+    }
+    rtn = 0;
+  }
+  else
+  {
+    stats.rejected++;
+  }
+  SREG = sreg;
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_QUEUE_depth
+/// @brief Number of transactions waiting or running.
+/// @return Queue depth, 0 when idle.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t SPI_QUEUE_depth(void)
+{
+  return (head - tail) & RING_MASK;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_QUEUE_get_stats
+/// @brief Copies the statistics counters.
+/// @param[out] s  Where to put them.
+//////////////////////////////////////////////////////////////////////////////
+void SPI_QUEUE_get_stats(spi_queue_stats_t *s)
+{
+  uint8_t sreg = SREG;
+  cli();
+  *s = stats;
+  s->depth = (head - tail) & RING_MASK;
+  s->ticks = SYSTICK_get_ticks() - stats_start;
+  SREG = sreg;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_QUEUE_clear_stats
+/// @brief Zeroes the counters and restarts the tick count.
+//////////////////////////////////////////////////////////////////////////////
+void SPI_QUEUE_clear_stats(void)
+{
+  uint8_t sreg = SREG;
+  cli();
+  stats.bytes = 0;
+  stats.transfers = 0;
+  stats.rejected = 0;
+  stats.max_depth = 0;
+  stats_start = SYSTICK_get_ticks();
+  SREG = sreg;
+}
@@ -0,0 +1,110 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file spi_queue.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Queue SPI transactions and run them from interrupts.
+///
+///  Hardware SPI interfaces move a byte per SPI_STC_vect, as fast as
+///  the peripheral goes.  Bit-banged ones move SPI_QUEUE_SOFT_BYTES per
+///  systick tick:  with the default 4 and SYSTICK_init(CLK_DIV_64) at
+///  16 MHz, a tick of 1.024 mS, that is about 3.9 kB/s however fast the
+///  interface clocks.  Raise SPI_QUEUE_SOFT_BYTES for more, at the cost
+///  of a longer systick interrupt.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef SPI_QUEUE_H
+#define SPI_QUEUE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include "config.h"
+#include "softspi.h"
+
+#define SPI_QUEUE_VERSION_MAJOR     0
+#define SPI_QUEUE_VERSION_MINOR     1
+#define SPI_QUEUE_VERSION_BUILD     0
+#define SPI_QUEUE_VERSION_DATE      (20230616L)
+
+  // Runs in interrupt context, with interrupts off:  from SPI_STC_vect
+  // for a hardware SPI transaction, from the systick interrupt
+  // (TIMER0_OVF_vect) for the others.  The next transaction has already
+  // started.  Keep it short; it may call SPI_QUEUE_enqueue.
+  typedef void (*spi_queue_callback_t)(void *arg);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @struct spi_queue_desc
+/// @brief One transaction:  SS is held low for all len bytes.
+/// @remark The buffers belong to the caller and must stay valid until
+///         the callback runs.
+//////////////////////////////////////////////////////////////////////////////
+  typedef struct spi_queue_desc
+  {
+    uint8_t               idx;       // SoftSPI interface index
+    const uint8_t        *tx;        // Bytes to send, NULL sends zeros
+    uint8_t              *rx;        // Bytes read, NULL to discard
+    uint8_t               len;       // Number of bytes
+    spi_queue_callback_t  callback;  // Called when done from an ISR, or NULL
+    void                 *arg;       // Passed to callback
+  } spi_queue_desc_t;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @struct spi_queue_stats
+/// @brief Counters since the last SPI_QUEUE_clear_stats.
+//////////////////////////////////////////////////////////////////////////////
+  typedef struct spi_queue_stats
+  {
+    uint32_t  bytes;        // Bytes transferred
+    uint32_t  ticks;        // Systick ticks elapsed, for bytes per tick
+    uint16_t  transfers;    // Transactions completed
+    uint16_t  rejected;     // Enqueues refused because the ring was full
+    uint8_t   depth;        // Transactions waiting or running now
+    uint8_t   max_depth;    // Most ever waiting or running at once
+  } spi_queue_stats_t;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_QUEUE_init
+/// @brief Empties the queue and starts the systick pump for soft interfaces.
+/// @remark SOFTSPI_init2 and SYSTICK_init must already have run.
+/// @return Zero on success, -1 if no systick timer was free.
+//////////////////////////////////////////////////////////////////////////////
+  int SPI_QUEUE_init(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_QUEUE_enqueue
+/// @brief Copies a descriptor into the ring and starts it if the bus is idle.
+/// @param[in] desc  Transaction to run.
+/// @return Zero on success, -1 if the ring is full.
+//////////////////////////////////////////////////////////////////////////////
+  int SPI_QUEUE_enqueue(const spi_queue_desc_t *desc);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_QUEUE_depth
+/// @brief Number of transactions waiting or running.
+/// @return Queue depth, 0 when idle.
+//////////////////////////////////////////////////////////////////////////////
+  uint8_t SPI_QUEUE_depth(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_QUEUE_get_stats
+/// @brief Copies the statistics counters.
+/// @param[out] stats  Where to put them.
+//////////////////////////////////////////////////////////////////////////////
+  void SPI_QUEUE_get_stats(spi_queue_stats_t *stats);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_QUEUE_clear_stats
+/// @brief Zeroes the counters and restarts the tick count.
+//////////////////////////////////////////////////////////////////////////////
+  void SPI_QUEUE_clear_stats(void);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // #ifndef SPI_QUEUE_H
@@ -0,0 +1,194 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file spi_usart.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Use the USART in master SPI mode (MSPIM) as a second SPI bus.
+///
+///  Unlike the SPI peripheral the USART double buffers its transmitter,
+///  so the next byte can be loaded while the current one shifts out and
+///  SCK never pauses between bytes.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stddef.h>   // for NULL
+#include "config.h"
+#include <avr/io.h>
+#include "gpio.h"
+#include "spi_usart.h"
+
+#if SPI_USART_AVAILABLE
+
+// Set once a byte goes into UDR0.  TXC0 only comes up after one has,
+// so SPI_USART_release must not wait for it otherwise.
+static uint8_t written = 0;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USART_init
+/// @brief Makes XCK and TXD outputs for master SPI.
+/// @return Zero on success, -1 if this part has no MSPIM.
+//////////////////////////////////////////////////////////////////////////////
+int SPI_USART_init(void)
+{
+  UBRR0 = 0;
+  // XCK as output is what makes the USART a master.
+  GPIO_pin_mode(SPI_USART_XCK, GPIO_PIN_MODE_OUTPUT);
+  GPIO_pin_mode(SPI_USART_MOSI, GPIO_PIN_MODE_OUTPUT);
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USART_clock_setting
+/// @brief Finds the fastest MSPIM clock that does not exceed bps.
+/// @param[in] bps  Max speed in bits per second: 0 for fast as possible.
+/// @return UBRR value, or SPI_USART_CLOCK_NONE if bps is too low.
+//////////////////////////////////////////////////////////////////////////////
+uint16_t SPI_USART_clock_setting(uint32_t bps)
+{
+  uint16_t rtn = 0;
+  if(bps != 0)
+  {
+    if(bps < SPI_USART_MIN_BPS)
+    {
+      rtn = SPI_USART_CLOCK_NONE;
+    }
+    else
+    {
+      // Round the divisor up so the rate never exceeds bps.
+      uint32_t div = (SPI_USART_MAX_BPS + bps - 1) / bps;
+      rtn = (uint16_t)(div - 1);
+    }
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USART_configure
+/// @brief Switches the USART to MSPIM with the given mode and clock.
+/// @param[in] mode   SPI mode, the _SLOW variants are treated the same.
+/// @param[in] ubrr   Value from SPI_USART_clock_setting.
+//////////////////////////////////////////////////////////////////////////////
+void SPI_USART_configure(softspi_mode_t mode, uint16_t ubrr)
+{
+  // The mode enum is laid out as  [ slow | cpol | cpha | lsb first ]
+  uint8_t ctrl = (1 << UMSEL01) | (1 << UMSEL00);
+  if(mode & 0x01)
+  {
+    ctrl |= (1 << UDORD0);
+  }
+  if(mode & 0x02)
+  {
+    ctrl |= (1 << UCPHA0);
+  }
+  if(mode & 0x04)
+  {
+    ctrl |= (1 << UCPOL0);
+  }
+  // Datasheet order:  clear UBRR, set mode, enable, then set the rate.
+  UBRR0 = 0;
+  UCSR0C = ctrl;
+  UCSR0B = (1 << RXEN0) | (1 << TXEN0);
+  UBRR0 = ubrr;
+  written = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USART_release
+/// @brief Turns off the USART so its pins return to GPIO control.
+//////////////////////////////////////////////////////////////////////////////
+void SPI_USART_release(void)
+{
+  // Let the last byte finish shifting before the transmitter goes away.
+  if(written)
+  {
+    while(!(UCSR0A & (1 << TXC0)))
+      ;
+  }
+  written = 0;
+  UCSR0B = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USART_transfer
+/// @brief Sends one byte and returns the byte clocked in.
+/// @param[in] data Byte to write.
+/// @return Byte read.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t SPI_USART_transfer(uint8_t data)
+{
+  while(!(UCSR0A & (1 << UDRE0)))
+    ;
+  UCSR0A = (1 << TXC0);   // writing one clears it
+  UDR0 = data;
+  written = 1;
+  while(!(UCSR0A & (1 << RXC0)))
+    ;
+  return UDR0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USART_transfer_buffer
+/// @brief Streams a buffer with no gap between bytes.
+/// @param[in]  tx   Bytes to send, NULL sends zeros.
+/// @param[out] rx   Bytes read, NULL to discard.
+/// @param[in]  len  Number of bytes.
+//////////////////////////////////////////////////////////////////////////////
+void SPI_USART_transfer_buffer(const uint8_t *tx, uint8_t *rx, uint16_t len)
+{
+  uint16_t sent = 0;
+  uint16_t recv = 0;
+  while(recv < len)
+  {
+    // At most two bytes in flight:  the receiver is only two deep.
+    if(sent < len && (uint16_t)(sent - recv) < 2
+       && (UCSR0A & (1 << UDRE0)))
+    {
+      UCSR0A = (1 << TXC0);
+      UDR0 = (tx != NULL) ? tx[sent] : 0;
+      written = 1;
+      sent++;
+    }
+    if(UCSR0A & (1 << RXC0))
+    {
+      uint8_t in = UDR0;
+      if(rx != NULL)
+      {
+        rx[recv] = in;
+      }
+      recv++;
+    }
+  }
+}
+
+#else  // SPI_USART_AVAILABLE
+
+int SPI_USART_init(void)
+{
+  return -1;
+}
+
+uint16_t SPI_USART_clock_setting(uint32_t bps)
+{
+  return SPI_USART_CLOCK_NONE;
+}
+
+void SPI_USART_configure(softspi_mode_t mode, uint16_t ubrr)
+{
+}
+
+void SPI_USART_release(void)
+{
+}
+
+uint8_t SPI_USART_transfer(uint8_t data)
+{
+  return 0;
+}
+
+void SPI_USART_transfer_buffer(const uint8_t *tx, uint8_t *rx, uint16_t len)
+{
+}
+
+#endif  // SPI_USART_AVAILABLE
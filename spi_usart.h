@@ -0,0 +1,106 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file spi_usart.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Use the USART in master SPI mode (MSPIM) as a second SPI bus.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef SPI_USART_H
+#define SPI_USART_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <avr/io.h>
+#include "config.h"
+#include "gpio.h"
+#include "softspi.h"
+
+#define SPI_USART_VERSION_MAJOR     0
+#define SPI_USART_VERSION_MINOR     1
+#define SPI_USART_VERSION_BUILD     0
+#define SPI_USART_VERSION_DATE      (20230617L)
+
+  // MSPIM is on the USART of the ATmega48/88/168/328 family.  The
+  // ATmega8 USART can't do it.  XCK is the clock, TXD is MOSI, RXD MISO.
+  // Other parts with MSPIM (ATmega164P..1284P, 640..2560) have USART0
+  // on other pins and are not supported yet.
+#if defined(UMSEL01) && (defined(__AVR_ATmega48__)                           \
+  || defined(__AVR_ATmega88__) || defined(__AVR_ATmega168__)                 \
+  || defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__))
+#define SPI_USART_AVAILABLE   1
+#define SPI_USART_XCK         GPIO_PIN_D4
+#define SPI_USART_MOSI        GPIO_PIN_D1
+#define SPI_USART_MISO        GPIO_PIN_D0
+#else
+#define SPI_USART_AVAILABLE   0
+#define SPI_USART_XCK         GPIO_PIN_NONE
+#define SPI_USART_MOSI        GPIO_PIN_NONE
+#define SPI_USART_MISO        GPIO_PIN_NONE
+#endif
+
+  // Rate is F_CPU / (2 * (UBRR + 1)), UBRR 0 to 4095.
+#define SPI_USART_MAX_BPS     (F_CPU / 2)
+#define SPI_USART_MIN_BPS     (F_CPU / 8192)
+
+  // Returned by SPI_USART_clock_setting when the rate can't be reached.
+#define SPI_USART_CLOCK_NONE  0xffff
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USART_init
+/// @brief Makes XCK and TXD outputs for master SPI.
+/// @remark The USART is then unavailable to serial.c.
+/// @return Zero on success, -1 if this part has no MSPIM.
+//////////////////////////////////////////////////////////////////////////////
+  int SPI_USART_init(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USART_clock_setting
+/// @brief Finds the fastest MSPIM clock that does not exceed bps.
+/// @param[in] bps  Max speed in bits per second: 0 for fast as possible.
+/// @return UBRR value, or SPI_USART_CLOCK_NONE if bps is too low.
+//////////////////////////////////////////////////////////////////////////////
+  uint16_t SPI_USART_clock_setting(uint32_t bps);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USART_configure
+/// @brief Switches the USART to MSPIM with the given mode and clock.
+/// @param[in] mode   SPI mode, the _SLOW variants are treated the same.
+/// @param[in] ubrr   Value from SPI_USART_clock_setting.
+//////////////////////////////////////////////////////////////////////////////
+  void SPI_USART_configure(softspi_mode_t mode, uint16_t ubrr);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USART_release
+/// @brief Turns off the USART so its pins return to GPIO control.
+//////////////////////////////////////////////////////////////////////////////
+  void SPI_USART_release(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USART_transfer
+/// @brief Sends one byte and returns the byte clocked in.
+/// @param[in] data Byte to write.
+/// @return Byte read.
+//////////////////////////////////////////////////////////////////////////////
+  uint8_t SPI_USART_transfer(uint8_t data);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USART_transfer_buffer
+/// @brief Streams a buffer with no gap between bytes.
+/// @param[in]  tx   Bytes to send, NULL sends zeros.
+/// @param[out] rx   Bytes read, NULL to discard.
+/// @param[in]  len  Number of bytes.
+/// @remark The transmit buffer is kept full so SCK runs continuously.
+//////////////////////////////////////////////////////////////////////////////
+  void SPI_USART_transfer_buffer(const uint8_t *tx, uint8_t *rx, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // #ifndef SPI_USART_H
@@ -0,0 +1,196 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file spi_usi.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Use the USI in three-wire mode as an SPI master on the ATtinys.
+///
+///  The ATtinys have no SPI peripheral, but the USI shift register and
+///  its 4-bit counter do most of the work.  Each write of USITC toggles
+///  USCK;  sixteen toggles move a byte.  At full speed the writes are
+///  unrolled for F_CPU/2, otherwise a loop with a delay paces them.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include "config.h"
+#include <avr/io.h>
+#include <util/delay_basic.h>
+#include "gpio.h"
+#include "spi_usi.h"
+
+#if SPI_USI_AVAILABLE
+
+static uint8_t strobe;      // USICR value for one toggle in the loop
+static uint8_t half_delay;  // _delay_loop_1 count per half clock
+static uint8_t unrolled;    // nonzero for the unrolled strobes
+static uint8_t lsb_first;   // USI only shifts MSB first
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn reverse
+/// @brief STATIC Reverses the bits of a byte for LSB first modes.
+//////////////////////////////////////////////////////////////////////////////
+static uint8_t reverse(uint8_t b)
+{
+  b = (uint8_t)((b >> 4) | (b << 4));
+  b = (uint8_t)(((b & 0xcc) >> 2) | ((b & 0x33) << 2));
+  b = (uint8_t)(((b & 0xaa) >> 1) | ((b & 0x55) << 1));
+  return b;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USI_init
+/// @brief Makes USCK and DO outputs for master SPI.
+/// @return Zero on success, -1 if this part has no usable USI.
+//////////////////////////////////////////////////////////////////////////////
+int SPI_USI_init(void)
+{
+  GPIO_pin_mode(SPI_USI_USCK, GPIO_PIN_MODE_OUTPUT);
+  GPIO_pin_mode(SPI_USI_DO, GPIO_PIN_MODE_OUTPUT);
+  GPIO_pin_mode(SPI_USI_DI, GPIO_PIN_MODE_INPUT_PULLUP);
+  USICR = 0;
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USI_clock_setting
+/// @brief Finds the fastest USI clock that does not exceed bps.
+/// @param[in] bps  Max speed in bits per second: 0 for fast as possible.
+/// @return _delay_loop_1 count per half clock, 0 for none, or
+///         SPI_USI_CLOCK_NONE if bps is too low.
+//////////////////////////////////////////////////////////////////////////////
+uint16_t SPI_USI_clock_setting(uint32_t bps)
+{
+  uint16_t rtn = 0;
+  if(bps != 0 && bps < SPI_USI_MAX_BPS)
+  {
+    if(bps < SPI_USI_MIN_BPS)
+    {
+      rtn = SPI_USI_CLOCK_NONE;
+    }
+    else
+    {
+      // Half clock in cycles, rounded up, less the loop itself.
+      uint32_t half = (F_CPU + 2 * bps - 1) / (2 * bps);
+      rtn = 1;
+      if(half > SPI_USI_LOOP_CYCLES + 3)
+      {
+        rtn = (uint16_t)((half - SPI_USI_LOOP_CYCLES + 2) / 3);
+      }
+    }
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USI_configure
+/// @brief Puts the USI in three-wire mode for the given mode and clock.
+/// @param[in] mode   SPI mode, the _SLOW variants are treated the same.
+/// @param[in] clock  Value from SPI_USI_clock_setting.
+/// @remark USCK is left at the idle level for the mode.
+//////////////////////////////////////////////////////////////////////////////
+void SPI_USI_configure(softspi_mode_t mode, uint16_t clock)
+{
+  // The mode enum is laid out as  [ slow | cpol | cpha | lsb first ]
+  uint8_t cpha = (mode & 0x02) != 0;
+  uint8_t cpol = (mode & 0x04) != 0;
+
+  GPIO_write_pin(SPI_USI_USCK, cpol);
+  lsb_first = mode & 0x01;
+  half_delay = (uint8_t)clock;
+  // The software strobe pairs shift on the trailing edge, which only
+  // suits CPHA 0.  Otherwise the shift register follows the USCK pin:
+  // USICS0 picks the edge DI is sampled on.
+  unrolled = (clock == 0 && !cpha);
+  strobe = (1 << USIWM0) | (1 << USICS1) | (1 << USICLK) | (1 << USITC);
+  if(cpol ^ cpha)
+  {
+    strobe |= (1 << USICS0);   // sample on the falling edge
+  }
+  USICR = (1 << USIWM0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USI_release
+/// @brief Turns off the USI so its pins return to GPIO control.
+//////////////////////////////////////////////////////////////////////////////
+void SPI_USI_release(void)
+{
+  USICR = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USI_transfer
+/// @brief Sends one byte and returns the byte clocked in.
+/// @param[in] data Byte to write.
+/// @return Byte read.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t SPI_USI_transfer(uint8_t data)
+{
+  if(lsb_first)
+  {
+    data = reverse(data);
+  }
+  USIDR = data;
+  USISR = (1 << USIOIF);    // clear the flag and the counter
+  if(unrolled)
+  {
+    const uint8_t lo = (1 << USIWM0) | (1 << USITC);
+    const uint8_t hi = (1 << USIWM0) | (1 << USITC) | (1 << USICLK);
+    USICR = lo; USICR = hi;
+    USICR = lo; USICR = hi;
+    USICR = lo; USICR = hi;
+    USICR = lo; USICR = hi;
+    USICR = lo; USICR = hi;
+    USICR = lo; USICR = hi;
+    USICR = lo; USICR = hi;
+    USICR = lo; USICR = hi;
+  }
+  else
+  {
+    const uint8_t s = strobe;
+    const uint8_t dly = half_delay;
+    do
+    {
+      USICR = s;
+      if(dly)
+      {
+        _delay_loop_1(dly);
+      }
+    } while(!(USISR & (1 << USIOIF)));
+  }
+  data = USIDR;
+  if(lsb_first)
+  {
+    data = reverse(data);
+  }
+  return data;
+}
+
+#else  // SPI_USI_AVAILABLE
+
+int SPI_USI_init(void)
+{
+  return -1;
+}
+
+uint16_t SPI_USI_clock_setting(uint32_t bps)
+{
+  return SPI_USI_CLOCK_NONE;
+}
+
+void SPI_USI_configure(softspi_mode_t mode, uint16_t clock)
+{
+}
+
+void SPI_USI_release(void)
+{
+}
+
+uint8_t SPI_USI_transfer(uint8_t data)
+{
+  return 0;
+}
+
+#endif  // SPI_USI_AVAILABLE
@@ -0,0 +1,109 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file spi_usi.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Use the USI in three-wire mode as an SPI master on the ATtinys.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef SPI_USI_H
+#define SPI_USI_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <avr/io.h>
+#include "config.h"
+#include "gpio.h"
+#include "softspi.h"
+
+#define SPI_USI_VERSION_MAJOR     0
+#define SPI_USI_VERSION_MINOR     1
+#define SPI_USI_VERSION_BUILD     0
+#define SPI_USI_VERSION_DATE      (20230619L)
+
+  // USI pins by part.  USCK is the clock, DO is MOSI, DI is MISO.
+#if defined(USICR) && (defined(__AVR_ATtiny25__) || defined(__AVR_ATtiny45__) \
+  || defined(__AVR_ATtiny85__) || defined(__AVR_ATtiny261__)               \
+  || defined(__AVR_ATtiny461__) || defined(__AVR_ATtiny861__))
+#define SPI_USI_AVAILABLE     1
+#define SPI_USI_USCK          GPIO_PIN_B2
+#define SPI_USI_DO            GPIO_PIN_B1
+#define SPI_USI_DI            GPIO_PIN_B0
+#elif defined(USICR) && (defined(__AVR_ATtiny24__) || defined(__AVR_ATtiny44__) \
+  || defined(__AVR_ATtiny84__) || defined(__AVR_ATtiny24A__)               \
+  || defined(__AVR_ATtiny44A__) || defined(__AVR_ATtiny84A__))
+#define SPI_USI_AVAILABLE     1
+#define SPI_USI_USCK          GPIO_PIN_A4
+#define SPI_USI_DO            GPIO_PIN_A5
+#define SPI_USI_DI            GPIO_PIN_A6
+#elif defined(USICR) && (defined(__AVR_ATtiny2313__)                        \
+  || defined(__AVR_ATtiny2313A__) || defined(__AVR_ATtiny4313__))
+#define SPI_USI_AVAILABLE     1
+#define SPI_USI_USCK          GPIO_PIN_B7
+#define SPI_USI_DO            GPIO_PIN_B6
+#define SPI_USI_DI            GPIO_PIN_B5
+#else
+#define SPI_USI_AVAILABLE     0
+#define SPI_USI_USCK          GPIO_PIN_NONE
+#define SPI_USI_DO            GPIO_PIN_NONE
+#define SPI_USI_DI            GPIO_PIN_NONE
+#endif
+
+  // Cycles per half clock of the strobe loop, not counting the delay.
+  // Clock 0 with CPHA 0 uses unrolled strobes instead:  2 cycles a bit.
+#define SPI_USI_LOOP_CYCLES   6
+
+#define SPI_USI_MAX_BPS       (F_CPU / 2)
+#define SPI_USI_MIN_BPS       (F_CPU / (2 * (SPI_USI_LOOP_CYCLES + 3 * 255)))
+
+  // Returned by SPI_USI_clock_setting when the rate can't be reached.
+#define SPI_USI_CLOCK_NONE    0xffff
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USI_init
+/// @brief Makes USCK and DO outputs for master SPI.
+/// @return Zero on success, -1 if this part has no usable USI.
+//////////////////////////////////////////////////////////////////////////////
+  int SPI_USI_init(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USI_clock_setting
+/// @brief Finds the fastest USI clock that does not exceed bps.
+/// @param[in] bps  Max speed in bits per second: 0 for fast as possible.
+/// @return _delay_loop_1 count per half clock, 0 for none, or
+///         SPI_USI_CLOCK_NONE if bps is too low.
+//////////////////////////////////////////////////////////////////////////////
+  uint16_t SPI_USI_clock_setting(uint32_t bps);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USI_configure
+/// @brief Puts the USI in three-wire mode for the given mode and clock.
+/// @param[in] mode   SPI mode, the _SLOW variants are treated the same.
+/// @param[in] clock  Value from SPI_USI_clock_setting.
+//////////////////////////////////////////////////////////////////////////////
+  void SPI_USI_configure(softspi_mode_t mode, uint16_t clock);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USI_release
+/// @brief Turns off the USI so its pins return to GPIO control.
+//////////////////////////////////////////////////////////////////////////////
+  void SPI_USI_release(void);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn SPI_USI_transfer
+/// @brief Sends one byte and returns the byte clocked in.
+/// @param[in] data Byte to write.
+/// @return Byte read.
+//////////////////////////////////////////////////////////////////////////////
+  uint8_t SPI_USI_transfer(uint8_t data);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // #ifndef SPI_USI_H
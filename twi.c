@@ -0,0 +1,218 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file twi.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief I2C master writes on the TWI peripheral, or bit-banged on any
+///         two pins.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include "config.h"
+#include <avr/io.h>
+#include <util/delay_basic.h>
+#include "gpio.h"
+#include "twi.h"
+
+#if TWI_AVAILABLE && TWI_HARDWARE
+
+// TWSR status codes, prescaler bits masked off
+#define STATUS_START      0x08
+#define STATUS_RESTART    0x10
+#define STATUS_SLA_ACK    0x18
+#define STATUS_DATA_ACK   0x28
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn wait
+/// @brief STATIC Waits for the peripheral to finish a step.
+/// @return TWSR status code.
+//////////////////////////////////////////////////////////////////////////////
+static uint8_t wait(void)
+{
+  while(!(TWCR & (1 << TWINT)))
+    ;
+  return TWSR & 0xf8;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn TWI_init
+/// @brief Sets the bus clock and enables the peripheral.
+/// @param[in] bps  SCL rate in bits per second, 0 for 100000.
+/// @return Zero on success, -1 if bps is out of range.
+//////////////////////////////////////////////////////////////////////////////
+int TWI_init(uint32_t bps)
+{
+  int rtn = -1;
+  if(bps == 0)
+  {
+    bps = 100000;
+  }
+  if(bps <= TWI_MAX_BPS && bps >= TWI_MIN_BPS)
+  {
+    // SCL = F_CPU / (16 + 2 * TWBR) with prescale 1
+    TWSR = 0;
+    TWBR = (uint8_t)((F_CPU / bps - 16) / 2);
+    TWCR = (1 << TWEN);
+    rtn = 0;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn TWI_write
+/// @brief Writes bytes to a slave in one transaction.
+/// @param[in] addr  7 bit slave address
+/// @param[in] buf   Bytes to send
+/// @param[in] len   Number of bytes
+/// @return Zero if every byte was acknowledged, -1 if not.
+//////////////////////////////////////////////////////////////////////////////
+int TWI_write(uint8_t addr, const uint8_t *buf, uint8_t len)
+{
+  int rtn = -1;
+  TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
+  uint8_t status = wait();
+  if(status == STATUS_START || status == STATUS_RESTART)
+  {
+    TWDR = addr << 1;           // write
+    TWCR = (1 << TWINT) | (1 << TWEN);
+    status = wait();
+    if(status == STATUS_SLA_ACK)
+    {
+      rtn = 0;
+      for(uint8_t i = 0; i < len && rtn == 0; i++)
+      {
+        TWDR = buf[i];
+        TWCR = (1 << TWINT) | (1 << TWEN);
+        if(wait() != STATUS_DATA_ACK)
+        {
+          rtn = -1;
+        }
+      }
+    }
+  }
+  TWCR = (1 << TWINT) | (1 << TWSTO) | (1 << TWEN);
+  while(TWCR & (1 << TWSTO))
+    ;
+  return rtn;
+}
+
+#elif TWI_AVAILABLE
+
+// Loops of _delay_loop_2, 4 cycles each, in half an SCL period
+static uint16_t half = 1;
+
+// Open drain:  the PORT bits stay 0, so an output pulls low and an
+// input lets the pull-up raise the line.
+static void sda(uint8_t v)
+{
+  GPIO_pin_mode(TWI_SOFT_SDA, v ? GPIO_PIN_MODE_INPUT : GPIO_PIN_MODE_OUTPUT);
+}
+
+static void scl(uint8_t v)
+{
+  GPIO_pin_mode(TWI_SOFT_SCL, v ? GPIO_PIN_MODE_INPUT : GPIO_PIN_MODE_OUTPUT);
+  if(v)
+  {
+    // Let a slave stretch the clock, but not forever.
+    for(uint16_t n = 1000; n != 0 && !GPIO_read_pin(TWI_SOFT_SCL); n--)
+      ;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn put_byte
+/// @brief STATIC Clocks out a byte MSB first and reads the ack.
+/// @param[in] b  Byte to send
+/// @return Zero on ACK, -1 on NACK.
+/// @remark Enters and leaves with SCL low.
+//////////////////////////////////////////////////////////////////////////////
+static int put_byte(uint8_t b)
+{
+  for(uint8_t i = 0; i < 8; i++)
+  {
+    sda(b & 0x80);
+    b <<= 1;
+    _delay_loop_2(half);
+    scl(1);
+    _delay_loop_2(half);
+    scl(0);
+  }
+  sda(1);
+  _delay_loop_2(half);
+  scl(1);
+  int rtn = GPIO_read_pin(TWI_SOFT_SDA) ? -1 : 0;
+  _delay_loop_2(half);
+  scl(0);
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn TWI_init
+/// @brief Works out the bit time and releases SDA and SCL.
+/// @param[in] bps  SCL rate in bits per second, 0 for 100000.
+/// @return Zero:  any rate up to what the GPIO calls allow will do.
+//////////////////////////////////////////////////////////////////////////////
+int TWI_init(uint32_t bps)
+{
+  if(bps == 0)
+  {
+    bps = 100000;
+  }
+  uint32_t loops = F_CPU / (8 * bps);
+  half = (loops > 0) ? (uint16_t)loops : 1;
+  GPIO_write_pin(TWI_SOFT_SDA, 0);
+  GPIO_write_pin(TWI_SOFT_SCL, 0);
+  sda(1);
+  scl(1);
+  return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn TWI_write
+/// @brief Writes bytes to a slave in one transaction.
+/// @param[in] addr  7 bit slave address
+/// @param[in] buf   Bytes to send
+/// @param[in] len   Number of bytes
+/// @return Zero if every byte was acknowledged, -1 if not.
+//////////////////////////////////////////////////////////////////////////////
+int TWI_write(uint8_t addr, const uint8_t *buf, uint8_t len)
+{
+  // Start:  SDA falls with SCL high
+  sda(1);
+  scl(1);
+  _delay_loop_2(half);
+  sda(0);
+  _delay_loop_2(half);
+  scl(0);
+
+  int rtn = put_byte(addr << 1);
+  for(uint8_t i = 0; i < len && rtn == 0; i++)
+  {
+    rtn = put_byte(buf[i]);
+  }
+
+  // Stop:  SDA rises with SCL high
+  sda(0);
+  _delay_loop_2(half);
+  scl(1);
+  _delay_loop_2(half);
+  sda(1);
+  _delay_loop_2(half);
+  return rtn;
+}
+
+#else  // TWI_AVAILABLE
+
+int TWI_init(uint32_t bps)
+{
+  return -1;
+}
+
+int TWI_write(uint8_t addr, const uint8_t *buf, uint8_t len)
+{
+  return -1;
+}
+
+#endif  // TWI_AVAILABLE
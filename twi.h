@@ -0,0 +1,72 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file twi.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief I2C master writes on the TWI peripheral, or bit-banged on any
+///         two pins.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef TWI_H
+#define TWI_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <avr/io.h>
+#include "config.h"
+#include "gpio.h"
+
+#define TWI_VERSION_MAJOR     0
+#define TWI_VERSION_MINOR     1
+#define TWI_VERSION_BUILD     0
+#define TWI_VERSION_DATE      (20230624L)
+
+  // Defining TWI_SOFT_SDA and TWI_SOFT_SCL in config.h bit-bangs the
+  // bus on those pins.  Otherwise parts with a TWI peripheral use it.
+  // Parts with neither get TWI_AVAILABLE 0 and calls that fail.
+#if defined(TWI_SOFT_SDA) && defined(TWI_SOFT_SCL)
+#define TWI_AVAILABLE       1
+#define TWI_HARDWARE        0
+#elif defined(TWCR)
+#define TWI_AVAILABLE       1
+#define TWI_HARDWARE        1
+#else
+#define TWI_AVAILABLE       0
+#define TWI_HARDWARE        0
+#endif
+
+  // The peripheral's fastest clock and, with prescale 1, its slowest.
+#define TWI_MAX_BPS         400000
+#define TWI_MIN_BPS         (F_CPU / (16 + 2 * 255))
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn TWI_init
+/// @brief Sets the bus clock and releases SDA and SCL.
+/// @param[in] bps  SCL rate in bits per second, 0 for 100000.
+/// @remark The bit-banged bus only drives the pins low, so it needs the
+///         same pull-ups as the peripheral.
+/// @return Zero on success, -1 if bps is out of range or there is no bus.
+//////////////////////////////////////////////////////////////////////////////
+  int TWI_init(uint32_t bps);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn TWI_write
+/// @brief Writes bytes to a slave in one transaction:  start, address,
+///        data, stop.
+/// @param[in] addr  7 bit slave address
+/// @param[in] buf   Bytes to send
+/// @param[in] len   Number of bytes
+/// @return Zero if every byte was acknowledged, -1 if not.
+//////////////////////////////////////////////////////////////////////////////
+  int TWI_write(uint8_t addr, const uint8_t *buf, uint8_t len);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // #ifndef TWI_H
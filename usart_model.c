@@ -0,0 +1,163 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file usart_model.c
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Host side model of an AVR USART's buffering, timed in CPU
+///         cycles.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <string.h>
+#include "usart_model.h"
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn load_shift
+/// @brief STATIC Moves UDR into the shift register if it is free.
+//////////////////////////////////////////////////////////////////////////////
+static void load_shift(usart_model_t *m)
+{
+  if(m->udr_full && m->shift_free <= m->now)
+  {
+    m->udr_full = 0;
+    m->shift_free = m->now + m->frame;
+    if(m->sent == 0)
+    {
+      m->first_tx = m->now;
+    }
+    m->last_tx = m->now;
+    m->sent++;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_init
+/// @brief Starts a USART with both directions idle at cycle 0.
+/// @param[in] m      Model
+/// @param[in] frame  CPU cycles per frame
+//////////////////////////////////////////////////////////////////////////////
+void USART_MODEL_init(usart_model_t *m, uint16_t frame)
+{
+  memset(m, 0, sizeof(*m));
+  m->frame = frame;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_incoming
+/// @brief Sends the receiver frames back to back.
+/// @param[in] m  Model
+/// @param[in] n  Frames
+//////////////////////////////////////////////////////////////////////////////
+void USART_MODEL_incoming(usart_model_t *m, uint32_t n)
+{
+  if(m->incoming == 0)
+  {
+    m->next_rx = m->now + m->frame;
+  }
+  m->incoming += n;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_run
+/// @brief Lets time pass, moving frames in and out as it does.
+/// @param[in] m       Model
+/// @param[in] cycles  CPU cycles
+/// @remark Frames complete in time order:  a receive and a transmit due
+///   in the same cycle are both handled at it.
+//////////////////////////////////////////////////////////////////////////////
+void USART_MODEL_run(usart_model_t *m, uint32_t cycles)
+{
+  uint64_t end = m->now + cycles;
+  for(;;)
+  {
+    uint64_t t = end;
+    if(m->incoming != 0 && m->next_rx < t)
+    {
+      t = m->next_rx;
+    }
+    if(m->udr_full && m->shift_free < t)
+    {
+      t = m->shift_free;
+    }
+    m->now = t;
+    if(m->incoming != 0 && m->next_rx == t)
+    {
+      m->arrived++;
+      if(m->fifo_len < 2)
+      {
+        m->fifo[m->fifo_len++] = m->rx_byte;
+      }
+      else
+      {
+        m->overruns++;
+        m->dor = 1;
+      }
+      m->rx_byte++;
+      m->incoming--;
+      m->next_rx += m->frame;
+    }
+    load_shift(m);
+    if(t == end)
+    {
+      break;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_rxc
+/// @return Nonzero if a received byte is waiting.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t USART_MODEL_rxc(const usart_model_t *m)
+{
+  return m->fifo_len != 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_read
+/// @brief Takes the oldest received byte.
+/// @param[in]  m    Model
+/// @param[out] dor  Set nonzero if a frame after it was lost.
+/// @return The byte, 0 if there was none.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t USART_MODEL_read(usart_model_t *m, uint8_t *dor)
+{
+  uint8_t rtn = 0;
+  *dor = 0;
+  if(m->fifo_len != 0)
+  {
+    rtn = m->fifo[0];
+    m->fifo[0] = m->fifo[1];
+    m->fifo_len--;
+    *dor = m->dor;
+    m->dor = 0;
+  }
+  return rtn;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_udre
+/// @return Nonzero if UDR can take a byte.
+//////////////////////////////////////////////////////////////////////////////
+uint8_t USART_MODEL_udre(const usart_model_t *m)
+{
+  return !m->udr_full;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_write
+/// @brief Loads UDR, unless it is full.
+/// @param[in] m  Model
+/// @param[in] b  Byte
+//////////////////////////////////////////////////////////////////////////////
+void USART_MODEL_write(usart_model_t *m, uint8_t b)
+{
+  if(!m->udr_full)
+  {
+    m->udr = b;
+    m->udr_full = 1;
+    load_shift(m);
+  }
+}
@@ -0,0 +1,124 @@
+//////////////////////////////////////////////////////////////////////////////
+///
+///  \file usart_model.h
+///
+///  \copy copyright (c) 2023 William R Cooke
+///
+///  @brief Host side model of an AVR USART's buffering, timed in CPU
+///         cycles.
+///
+///  Builds with the host compiler, not avr-gcc.  A harness runs serial.c
+///  against it:  frames arrive one every frame cycles into the two byte
+///  receive FIFO, and a third that finds it full is lost and flags DOR
+///  like on the part.  UDR to the shift register on the transmit side
+///  works the same way, so a harness sees whether the driver keeps the
+///  line busy.  The harness lets time pass with USART_MODEL_run by what
+///  it reckons each step of the driver costs.
+///
+//////////////////////////////////////////////////////////////////////////////
+
+#ifndef USART_MODEL_H
+#define USART_MODEL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+#define USART_MODEL_VERSION_MAJOR     0
+#define USART_MODEL_VERSION_MINOR     1
+#define USART_MODEL_VERSION_BUILD     0
+#define USART_MODEL_VERSION_DATE      (20231019L)
+
+//////////////////////////////////////////////////////////////////////////////
+/// @struct usart_model
+/// @brief One USART.  Read the counters directly, leave the rest to the
+///        USART_MODEL_ calls.
+//////////////////////////////////////////////////////////////////////////////
+  typedef struct usart_model
+  {
+    // Counters
+    uint32_t  arrived;        // frames that reached the receiver
+    uint32_t  overruns;       // of those, lost to a full FIFO
+    uint32_t  sent;           // frames the transmitter started
+    uint64_t  first_tx;       // cycle the first of them started
+    uint64_t  last_tx;        // cycle the last of them started
+
+    // Line
+    uint16_t  frame;          // cycles per frame
+    uint64_t  now;            // cycles since USART_MODEL_init
+
+    // Receiver
+    uint32_t  incoming;       // frames still to arrive
+    uint64_t  next_rx;        // cycle the next one is complete
+    uint8_t   rx_byte;        // its value, counting up from 0
+    uint8_t   fifo[2];
+    uint8_t   fifo_len;
+    uint8_t   dor;            // a frame was lost behind fifo[0]
+
+    // Transmitter
+    uint8_t   udr_full;       // UDR holds a byte for the shift register
+    uint8_t   udr;
+    uint64_t  shift_free;     // cycle the shift register empties
+  } usart_model_t;
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_init
+/// @brief Starts a USART with both directions idle at cycle 0.
+/// @param[in] m      Model
+/// @param[in] frame  CPU cycles per frame, 160 for 8N1 at 1 Mbaud, 16 MHz
+//////////////////////////////////////////////////////////////////////////////
+  void USART_MODEL_init(usart_model_t *m, uint16_t frame);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_incoming
+/// @brief Sends the receiver frames back to back, the first complete one
+///        frame from now.  Their values count up from 0.
+/// @param[in] m  Model
+/// @param[in] n  Frames
+//////////////////////////////////////////////////////////////////////////////
+  void USART_MODEL_incoming(usart_model_t *m, uint32_t n);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_run
+/// @brief Lets time pass, moving frames in and out as it does.
+/// @param[in] m       Model
+/// @param[in] cycles  CPU cycles
+//////////////////////////////////////////////////////////////////////////////
+  void USART_MODEL_run(usart_model_t *m, uint32_t cycles);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_rxc
+/// @return Nonzero if a received byte is waiting, RXC.
+//////////////////////////////////////////////////////////////////////////////
+  uint8_t USART_MODEL_rxc(const usart_model_t *m);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_read
+/// @brief Takes the oldest received byte, as reading UDR does.
+/// @param[in]  m    Model
+/// @param[out] dor  Set nonzero if a frame after it was lost, DOR.
+/// @return The byte, 0 if there was none.
+//////////////////////////////////////////////////////////////////////////////
+  uint8_t USART_MODEL_read(usart_model_t *m, uint8_t *dor);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_udre
+/// @return Nonzero if UDR can take a byte, UDRE.
+//////////////////////////////////////////////////////////////////////////////
+  uint8_t USART_MODEL_udre(const usart_model_t *m);
+
+//////////////////////////////////////////////////////////////////////////////
+/// @fn USART_MODEL_write
+/// @brief Loads UDR.  Ignored, as on the part, unless UDRE.
+/// @param[in] m  Model
+/// @param[in] b  Byte
+//////////////////////////////////////////////////////////////////////////////
+  void USART_MODEL_write(usart_model_t *m, uint8_t b);
+
+#ifdef __cplusplus
+}
+#endif  // __cplusplus
+#endif  // #ifndef USART_MODEL_H